@@ -1,9 +1,12 @@
 #ifndef CNN_ALIGNED_MEM_POOL_H
 #define CNN_ALIGNED_MEM_POOL_H
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
 #ifdef WIN32
 #include <malloc.h>
@@ -80,95 +83,231 @@ inline void cnn_mm_free_host(void* mem) {
     //#endif
 }
 
-// this is used to manage CPU memory for function values and gradients
+// this is used to manage CPU memory for function values and gradients.
+// memory is handed out by bumping a pointer through a list of aligned chunks.
+// when the current chunk is full the pool moves on to the next one, adding a
+// chunk as large as everything allocated so far if there is none, so the pool
+// grows on demand instead of running out. after free(), a pool that has grown
+// is collapsed into a single chunk of the combined size, so that a workload
+// with a stable peak ends up allocating from one chunk.
 template <unsigned AlignedBits>
 class AlignedMemoryPool {
  private:
   bool mb_allocate_on_cpu_only; 
+  struct Chunk {
+    void* mem;
+    unsigned long capacity;
+    unsigned long used;
+  };
  public:
-  explicit AlignedMemoryPool(unsigned long cap, bool b_allocate_on_cpu_only = false) {
-      mem = nullptr;
-      mb_allocate_on_cpu_only = b_allocate_on_cpu_only;
-      sys_alloc(cap);
-      zero_all();
+  explicit AlignedMemoryPool(unsigned long cap, bool b_allocate_on_cpu_only = false) :
+    mb_allocate_on_cpu_only(b_allocate_on_cpu_only), initial_capacity(cap) {
+      reset_counters();
+      add_chunk(cap);
   }
   ~AlignedMemoryPool()
   {
-      if (mem)
-          cnn_mm_free(mem, mb_allocate_on_cpu_only); 
+      release_chunks();
   }
 
-  // returns nullptr if OOM
   void* allocate(unsigned long n) {
     auto rounded_n = round_up_align(n);
-    if (rounded_n + used > capacity)
-      return nullptr;
-    void * res = static_cast<char*>(mem)+used;
+    if (need_coalesce)
+      coalesce();
+    if (rounded_n + chunks[current].used > chunks[current].capacity)
+      next_chunk(rounded_n);
+    Chunk& c = chunks[current];
+    void * res = static_cast<char*>(c.mem) + c.used;
+    c.used += (unsigned long) rounded_n;
     used += (unsigned long) rounded_n;
+    if (used > high_water)
+      high_water = used;
     return res;
   }
   // free n byte from the current used memory
   void* dealocate(unsigned long n) {
       auto rounded_n = round_up_align(n);
-      if ((long)(used - rounded_n) < 0)
-          used = 0;
-      else
-          used = used - rounded_n;
-      void * res = static_cast<char*>(mem)+used;
+      Chunk* c = &chunks[current];
+      if (c->used < rounded_n) {
+          used -= c->used;
+          c->used = 0;
+      } else {
+          c->used -= (unsigned long) rounded_n;
+          used -= (unsigned long) rounded_n;
+      }
+      // the block may have been the first one of a chunk
+      while (c->used == 0 && current > 0)
+          c = &chunks[--current];
+      void * res = static_cast<char*>(c->mem) + c->used;
       return res;
   }
+  // the allocation state of the pool, to go back to with rewind()
+  struct Position {
+    unsigned chunk;
+    unsigned long chunk_used;
+    unsigned long used;
+  };
+  Position mark() const { return Position{ current, chunks[current].used, used }; }
+  // gives back everything allocated since p was marked. the pool must not
+  // have been freed in between
+  void rewind(const Position& p) {
+    for (unsigned k = p.chunk + 1; k <= current; ++k)
+      chunks[k].used = 0;
+    current = p.chunk;
+    chunks[current].used = p.chunk_used;
+    used = p.used;
+  }
   void free() {
     //std::cerr << "freeing " << used << " bytes\n";
+    for (unsigned k = 0; k <= current; ++k)
+      chunks[k].used = 0;
+    current = 0;
     used = 0;
+    // nodes are deleted one after another with a free() each, so the chunks
+    // can only be given back once the pool is used again
+    need_coalesce = (chunks.size() > 1);
   }
   void free_and_grow_capacity(unsigned long new_cap = 0) {
-    cnn_mm_free(mem, mb_allocate_on_cpu_only);
-    if (new_cap)
-      sys_alloc(new_cap);
-    else
-      sys_alloc(capacity * 1.5);
-    zero_all();
+    unsigned long cap = new_cap ? new_cap : (unsigned long)(capacity * 1.5);
+    release_chunks();
+    reset_counters();
+    add_chunk(cap);
+  }
+  // gives memory above the high-water mark back to the system. if nothing is
+  // allocated, the pool is shrunk to a single chunk of the high-water size
+  // (but not below its initial capacity); otherwise the chunks after the one
+  // in use are released. the high-water mark then restarts from the current use.
+  void trim() {
+    if (used == 0) {
+      unsigned long cap = std::max<unsigned long>(high_water, initial_capacity);
+      if (chunks.size() > 1 || chunks[0].capacity != round_up_align(cap)) {
+        release_chunks();
+        reset_counters();
+        add_chunk(cap);
+      }
+    } else {
+      while (chunks.size() > current + 1) {
+        capacity -= chunks.back().capacity;
+        cnn_mm_free(chunks.back().mem, mb_allocate_on_cpu_only);
+        chunks.pop_back();
+      }
+    }
+    need_coalesce = false;
+    high_water = used;
+  }
+  // bytes handed out since the last free()
+  unsigned long used_memory() const { return used; }
+  // bytes reserved from the system
+  unsigned long reserved_memory() const { return capacity; }
+  // the largest used_memory() since construction or the last trim()
+  unsigned long high_water_mark() const { return high_water; }
+
+  inline static size_t round_up_align(unsigned long n) {
+    if (AlignedBits < 2) return n;
+    auto c = (n & ((1 << (AlignedBits)) - 1)) > 0 ? 1 : 0;
+    return ((n >> (AlignedBits)) + c) << (AlignedBits);
   }
   // zeros out the amount of allocations
   void zero_allocated_memory() {
-    if (used == 0) return;
-    if (mb_allocate_on_cpu_only)
-        std::memset(mem, 0, used);
-    else{
+    for (unsigned k = 0; k <= current; ++k)
+      zero(chunks[k].mem, chunks[k].used);
 #if HAVE_CUDA
-        CUDA_CHECK(cudaMemsetAsync(mem, 0, used));
+    if (!mb_allocate_on_cpu_only && used > 0)
         CUDA_CHECK(cudaDeviceSynchronize());
-#else
-        std::memset(mem, 0, used);
 #endif
-    }
   }
  private:
-  void sys_alloc(unsigned long cap) {
-    capacity = round_up_align(cap);
-    mem = cnn_mm_malloc(capacity, 1 << AlignedBits, mb_allocate_on_cpu_only);
+  void add_chunk(unsigned long cap) {
+    Chunk c;
+    c.capacity = round_up_align(cap);
+    c.mem = cnn_mm_malloc(c.capacity, 1 << AlignedBits, mb_allocate_on_cpu_only);
+    c.used = 0;
+    chunks.push_back(c);
+    capacity += c.capacity;
+  }
+  // moves to the next chunk that can hold n bytes, the rest of the current one stays unused
+  void next_chunk(unsigned long n) {
+    while (current + 1 < chunks.size()) {
+      ++current;
+      chunks[current].used = 0;
+      if (chunks[current].capacity >= n)
+        return;
+    }
+    add_chunk(std::max<unsigned long>(n, capacity));
+    current = (unsigned)chunks.size() - 1;
+  }
+  void coalesce() {
+    unsigned long cap = capacity;
+    unsigned long hw = high_water;
+    release_chunks();
+    reset_counters();
+    add_chunk(cap);
+    high_water = hw;
+  }
+  void release_chunks() {
+    for (auto& c : chunks)
+      cnn_mm_free(c.mem, mb_allocate_on_cpu_only);
+    chunks.clear();
+  }
+  void reset_counters() {
+    capacity = 0;
     used = 0;
+    high_water = 0;
+    current = 0;
+    need_coalesce = false;
   }
-  void zero_all() {
+  void zero(void* mem, unsigned long n) {
+      if (n == 0) return;
       if (mb_allocate_on_cpu_only)
-          std::memset(mem, 0, capacity);
+          std::memset(mem, 0, n);
       else{
 #if HAVE_CUDA
-          CUDA_CHECK(cudaMemsetAsync(mem, 0, capacity));
-          CUDA_CHECK(cudaDeviceSynchronize());
+          CUDA_CHECK(cudaMemsetAsync(mem, 0, n));
 #else
-          std::memset(mem, 0, capacity);
+          std::memset(mem, 0, n);
 #endif
       }
   }
-  inline static size_t round_up_align(unsigned long n) {
-    if (AlignedBits < 2) return n;
-    auto c = (n & ((1 << (AlignedBits)) - 1)) > 0 ? 1 : 0;
-    return ((n >> (AlignedBits)) + c) << (AlignedBits);
-  }
-  unsigned long capacity;
+  std::vector<Chunk> chunks;
+  unsigned current;                // chunk that allocations are taken from
+  unsigned long initial_capacity;
+  unsigned long capacity;          // sum of the chunk capacities
   unsigned long used;
-  void* mem;
+  unsigned long high_water;
+  bool need_coalesce;
+};
+
+// hands out blocks from an AlignedMemoryPool and keeps the blocks given back with
+// release() in per-size free lists, so that a later request of the same (aligned)
+// size reuses them instead of growing the pool. the free lists only refer to memory
+// of the underlying pool, so reset() must be called whenever that pool is freed.
+template <unsigned AlignedBits>
+class RecyclingMemoryPool {
+ public:
+  RecyclingMemoryPool() : pool(nullptr) {}
+
+  void reset(AlignedMemoryPool<AlignedBits>* p) {
+    pool = p;
+    free_blocks.clear();
+  }
+  void* allocate(unsigned long n) {
+    auto rounded_n = AlignedMemoryPool<AlignedBits>::round_up_align(n);
+    auto it = free_blocks.find(rounded_n);
+    if (it != free_blocks.end() && !it->second.empty()) {
+      void* res = it->second.back();
+      it->second.pop_back();
+      return res;
+    }
+    return pool->allocate(rounded_n);
+  }
+  // n must be the size the block was allocated with
+  void release(void* mem, unsigned long n) {
+    free_blocks[AlignedMemoryPool<AlignedBits>::round_up_align(n)].push_back(mem);
+  }
+
+ private:
+  AlignedMemoryPool<AlignedBits>* pool;
+  std::unordered_map<size_t, std::vector<void*>> free_blocks;
 };
 
 } // namespace cnn
@@ -3,11 +3,17 @@
 #include <string>
 #include <cassert>
 #include <vector>
+#include <map>
 #include <iostream>
 #include <boost/lexical_cast.hpp>
 #include "cnn/nodes.h"
 #include "cnn/expr-xtra.h"
+#include "cnn/random.h"
 #include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <queue>
+#include <functional>
 
 using namespace std;
 using namespace cnn::expr;
@@ -73,18 +79,71 @@ namespace cnn {
         errors.resize(n);
     }
 
-    Expression ClsBasedBuilder::add_input_impl(const Expression &in, long target_wordid, unsigned uttid) {
-        int cls_id = word2cls[target_wordid];
-        Expression newin = reshape(in, { input_dim * dparallel });
-        Expression x = pickrange(newin, uttid * input_dim, (uttid + 1)*input_dim);
-        vector<Expression> param = param_vars[cls_id];
-        Expression i_r_t = param[X2CB] + param[X2C] * x;
-        Expression i_c_t = i_cls_bias + i_cls * x;
-        Expression i_err_cls = pick(log_softmax(i_c_t), cls_id);
-        Expression i_err_prb = pick(log_softmax(i_r_t), dict_wrd_id2within_class_id[target_wordid]);
-        errors[uttid].push_back(-(i_err_cls + i_err_prb));
+    vector<Expression> ClsBasedBuilder::add_input_impl(const Expression &in, const vector<long>& targetid) {
+        vector<Expression> err;
+        unsigned nutt = targetid.size();
+        vector<unsigned> utt;
+        for (unsigned u = 0; u < nutt; u++)
+            if (targetid[u] >= 0)
+                utt.push_back(u);
+        if (utt.empty())
+            return err;
+        if (errors.size() < nutt)
+            errors.resize(nutt);
 
-        return errors[uttid].back();
+        unsigned nt = utt.size();
+        Expression x = reshape(in, { input_dim, nutt });
+        if (nt < nutt)
+        {
+            vector<Expression> cols;
+            for (auto u : utt)
+                cols.push_back(columnslices(x, input_dim, u, u + 1));
+            x = concatenate_cols(cols);
+        }
+
+        /// one softmax over the classes for all utterances
+        vector<unsigned> cls_ids;
+        map<unsigned, vector<unsigned>> cls2cols; /// columns of x grouped by target class
+        for (unsigned j = 0; j < nt; j++)
+        {
+            unsigned cls_id = word2cls[targetid[utt[j]]];
+            cls_ids.push_back(cls_id);
+            cls2cols[cls_id].push_back(j);
+        }
+        Expression i_err_cls = pickneglogsoftmax(colwise_add(i_cls * x, i_cls_bias), cls_ids);
+
+        /// one softmax over the words of each class that has targets
+        vector<Expression> i_err_prb(nt);
+        vector<unsigned> pos_in_cls(nt);
+        for (auto& p : cls2cols)
+        {
+            const vector<unsigned>& cols = p.second;
+            Expression xc = x;
+            if (cols.size() < nt)
+            {
+                vector<Expression> xcols;
+                for (auto j : cols)
+                    xcols.push_back(columnslices(x, input_dim, j, j + 1));
+                xc = concatenate_cols(xcols);
+            }
+            vector<unsigned> word_ids;
+            for (unsigned k = 0; k < cols.size(); k++)
+            {
+                word_ids.push_back(dict_wrd_id2within_class_id[targetid[utt[cols[k]]]]);
+                pos_in_cls[cols[k]] = k;
+            }
+            const vector<Expression>& param = param_vars[p.first];
+            Expression i_err = pickneglogsoftmax(colwise_add(param[X2C] * xc, param[X2CB]), word_ids);
+            for (auto j : cols)
+                i_err_prb[j] = i_err;
+        }
+
+        for (unsigned j = 0; j < nt; j++)
+        {
+            errors[utt[j]].push_back(pick(i_err_cls, j) + pick(i_err_prb[j], pos_in_cls[j]));
+            err.push_back(errors[utt[j]].back());
+        }
+        return err;
     }
 
     vector<cnn::real> ClsBasedBuilder::respond(const Expression &in, ComputationGraph& cg) 
@@ -188,4 +247,366 @@ namespace cnn {
     }
 
 
+    AliasSampler::AliasSampler(const vector<cnn::real>& weights)
+    {
+        unsigned n = weights.size();
+        double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+        if (n == 0 || total <= 0)
+            throw std::invalid_argument("AliasSampler needs a positive total weight");
+
+        dist.resize(n);
+        keep.resize(n, 1);
+        alias.resize(n);
+        /// pair every bucket below the average with one above it
+        vector<double> scaled(n);
+        vector<unsigned> small, large;
+        for (unsigned i = 0; i < n; i++)
+        {
+            dist[i] = weights[i] / total;
+            scaled[i] = weights[i] * n / total;
+            alias[i] = i;
+            if (scaled[i] < 1)
+                small.push_back(i);
+            else
+                large.push_back(i);
+        }
+        while (!small.empty() && !large.empty())
+        {
+            unsigned s = small.back(); small.pop_back();
+            unsigned l = large.back();
+            keep[s] = scaled[s];
+            alias[s] = l;
+            scaled[l] -= 1 - scaled[s];
+            if (scaled[l] < 1)
+            {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        /// what is left is 1 up to rounding
+    }
+
+    unsigned AliasSampler::sample(std::mt19937& eng) const
+    {
+        std::uniform_int_distribution<unsigned> bucket(0, dist.size() - 1);
+        std::uniform_real_distribution<cnn::real> coin(0, 1);
+        unsigned b = bucket(eng);
+        return (coin(eng) < keep[b]) ? b : alias[b];
+    }
+
+    SampledSoftmaxBuilder::SampledSoftmaxBuilder(
+        const unsigned int input_dim,
+        const vector<cnn::real>& word_counts,
+        unsigned nsamples,
+        Model& model,
+        cnn::real iscale,
+        string name,
+        cnn::real power) : input_dim(input_dim), vocab_size(word_counts.size()), nsamples(nsamples), pcg(nullptr), dparallel(1)
+    {
+        vector<cnn::real> weights;
+        for (auto c : word_counts)
+            weights.push_back(pow(max<cnn::real>(c, 0), power));
+        noise = AliasSampler(weights);
+
+        /// words that are never drawn still need a finite correction as targets
+        for (unsigned i = 0; i < vocab_size; i++)
+            log_expected_count.push_back(log(max<cnn::real>(nsamples * noise.probability(i), 1e-20)));
+
+        p_R = model.add_lookup_parameters(vocab_size, { input_dim }, iscale, name + " output rows");
+        p_bias = model.add_lookup_parameters(vocab_size, { 1 }, iscale, name + " output bias");
+
+        all_words.resize(vocab_size);
+        std::iota(all_words.begin(), all_words.end(), 0);
+    }
+
+    void SampledSoftmaxBuilder::new_graph(ComputationGraph& cg)
+    {
+        pcg = &cg;
+        errors.clear();
+        set_data_in_parallel(1);
+    }
+
+    void SampledSoftmaxBuilder::set_data_in_parallel(int n)
+    {
+        dparallel = n;
+
+        errors.clear();
+        errors.resize(n);
+    }
+
+    vector<Expression> SampledSoftmaxBuilder::add_input(const Expression& x, const vector<long>& targetid)
+    {
+        vector<Expression> err;
+        unsigned nutt = targetid.size();
+        vector<unsigned> utt, tgt;
+        for (unsigned u = 0; u < nutt; u++)
+        {
+            if (targetid[u] >= 0)
+            {
+                utt.push_back(u);
+                tgt.push_back(targetid[u]);
+            }
+        }
+        if (tgt.empty())
+            return err;
+        if (errors.size() < nutt)
+            errors.resize(nutt);
+
+        ComputationGraph& cg = *pcg;
+        unsigned nt = tgt.size();
+        Expression xt = reshape(x, { input_dim, nutt });
+        if (nt < nutt)
+        {
+            vector<Expression> cols;
+            for (auto u : utt)
+                cols.push_back(columnslices(xt, input_dim, u, u + 1));
+            xt = concatenate_cols(cols);
+        }
+
+        /// the score of each utterance's own target
+        vector<cnn::real> tcorr;
+        for (auto w : tgt)
+            tcorr.push_back(log_expected_count[w]);
+        Expression w_t = lookup_cols(cg, p_R, tgt);
+        Expression b_t = reshape(lookup_cols(cg, p_bias, tgt), { nt });
+        Expression s_t = sum_cols(transpose(cwise_multiply(w_t, xt))) + b_t - input(cg, { nt }, tcorr);
+
+        /// the scores of the noise words, shared by all utterances
+        vector<unsigned> smp;
+        vector<cnn::real> scorr;
+        for (unsigned k = 0; k < nsamples; k++)
+        {
+            smp.push_back(noise.sample(*rndeng));
+            scorr.push_back(log_expected_count[smp.back()]);
+        }
+        Expression w_s = lookup_cols(cg, p_R, smp);
+        Expression b_s = reshape(lookup_cols(cg, p_bias, smp), { nsamples }) - input(cg, { nsamples }, scorr);
+        Expression s_s = colwise_add(transpose(w_s) * xt, b_s);
+
+        Expression scores = concatenate({ reshape(s_t, { 1, nt }), s_s });
+
+        /// a noise word that is the target of an utterance is not a negative for it
+        vector<cnn::real> mask((1 + nsamples) * nt, 0);
+        bool hit = false;
+        for (unsigned j = 0; j < nt; j++)
+        {
+            for (unsigned k = 0; k < nsamples; k++)
+            {
+                if (smp[k] == tgt[j])
+                {
+                    mask[j * (1 + nsamples) + 1 + k] = -1e10;
+                    hit = true;
+                }
+            }
+        }
+        if (hit)
+            scores = scores + input(cg, { 1 + nsamples, nt }, mask);
+
+        Expression losses = pickneglogsoftmax(scores, vector<unsigned>(nt, 0));
+        for (unsigned j = 0; j < nt; j++)
+        {
+            errors[utt[j]].push_back(pick(losses, j));
+            err.push_back(errors[utt[j]].back());
+        }
+        return err;
+    }
+
+    vector<cnn::real> SampledSoftmaxBuilder::respond(const Expression &in, ComputationGraph& cg)
+    {
+        /// inference only, the output table gets no gradient
+        Expression w = const_lookup_cols(cg, p_R, all_words);
+        Expression b = reshape(const_lookup_cols(cg, p_bias, all_words), { vocab_size });
+        return get_value(log_softmax(transpose(w) * in + b), cg);
+    }
+
+    void SampledSoftmaxBuilder::copy(const SampledSoftmaxBuilder& ref)
+    {
+        p_R->copy(*ref.p_R);
+        p_bias->copy(*ref.p_bias);
+    }
+
+    HuffmanSoftmaxBuilder::HuffmanSoftmaxBuilder(
+        const unsigned int input_dim,
+        const vector<cnn::real>& word_counts,
+        Model& model,
+        cnn::real iscale,
+        string name) : input_dim(input_dim), vocab_size(word_counts.size()), pcg(nullptr), dparallel(1)
+    {
+        if (vocab_size < 2)
+            throw std::invalid_argument("HuffmanSoftmaxBuilder needs at least two words");
+        build_tree(word_counts);
+        p_nodes = model.add_lookup_parameters(vocab_size - 1, { input_dim + 1 }, iscale, name + " tree nodes");
+    }
+
+    void HuffmanSoftmaxBuilder::build_tree(const vector<cnn::real>& word_counts)
+    {
+        /// merge the two least frequent subtrees until one is left
+        typedef pair<double, unsigned> subtree;
+        priority_queue<subtree, vector<subtree>, greater<subtree>> q;
+        for (unsigned i = 0; i < vocab_size; i++)
+            q.push(subtree(max<cnn::real>(word_counts[i], 0), i));
+        left.clear();
+        right.clear();
+        while (q.size() > 1)
+        {
+            subtree a = q.top(); q.pop();
+            subtree b = q.top(); q.pop();
+            left.push_back(a.second);
+            right.push_back(b.second);
+            q.push(subtree(a.first + b.first, vocab_size + left.size() - 1));
+        }
+
+        /// the root is the last inner node; walk down to every word
+        paths.assign(vocab_size, vector<unsigned>());
+        codes.assign(vocab_size, vector<cnn::real>());
+        vector<pair<unsigned, unsigned>> todo; /// (node id, parent's word to copy the path from)
+        vector<vector<unsigned>> node_path(vocab_size - 1);
+        vector<vector<cnn::real>> node_code(vocab_size - 1);
+        for (int i = (int)vocab_size - 2; i >= 0; i--)
+        {
+            /// parents are created after their children, so they are visited first
+            node_path[i].push_back(i);
+            unsigned child[2] = { left[i], right[i] };
+            for (unsigned k = 0; k < 2; k++)
+            {
+                vector<unsigned>& p = (child[k] < vocab_size) ? paths[child[k]] : node_path[child[k] - vocab_size];
+                vector<cnn::real>& c = (child[k] < vocab_size) ? codes[child[k]] : node_code[child[k] - vocab_size];
+                p = node_path[i];
+                c = node_code[i];
+                c.push_back(k == 0 ? -1 : 1);
+            }
+        }
+    }
+
+    void HuffmanSoftmaxBuilder::new_graph(ComputationGraph& cg)
+    {
+        pcg = &cg;
+        errors.clear();
+        set_data_in_parallel(1);
+    }
+
+    void HuffmanSoftmaxBuilder::set_data_in_parallel(int n)
+    {
+        dparallel = n;
+
+        errors.clear();
+        errors.resize(n);
+    }
+
+    vector<Expression> HuffmanSoftmaxBuilder::add_input(const Expression& x, const vector<long>& targetid)
+    {
+        vector<Expression> err;
+        unsigned nutt = targetid.size();
+        vector<unsigned> offsets(1, 0), nodes;
+        vector<cnn::real> signs;
+        for (auto w : targetid)
+        {
+            if (w >= (long)vocab_size)
+                throw std::invalid_argument("HuffmanSoftmaxBuilder::add_input: word id " + boost::lexical_cast<string>(w) + " is not in the vocabulary");
+            if (w >= 0)
+            {
+                nodes.insert(nodes.end(), paths[w].begin(), paths[w].end());
+                signs.insert(signs.end(), codes[w].begin(), codes[w].end());
+            }
+            offsets.push_back(nodes.size());
+        }
+        if (nodes.empty())
+            return err;
+        if (errors.size() < nutt)
+            errors.resize(nutt);
+
+        Expression i_x = reshape(x, { input_dim, nutt });
+        Expression i_nodes = lookup_cols(*pcg, p_nodes, nodes);
+        Expression losses = hierarchical_softmax_path(i_x, i_nodes, offsets, signs);
+        for (unsigned u = 0; u < nutt; u++)
+        {
+            if (targetid[u] >= 0)
+            {
+                errors[u].push_back(pick(losses, u));
+                err.push_back(errors[u].back());
+            }
+        }
+        return err;
+    }
+
+    cnn::real HuffmanSoftmaxBuilder::node_score(unsigned i, const vector<cnn::real>& x) const
+    {
+#if HAVE_CUDA
+        /// the rows may be in GPU memory
+        vector<cnn::real> row = as_vector(p_nodes->values[i]);
+        const cnn::real* w = row.data();
+#else
+        const cnn::real* w = p_nodes->values[i].v;
+#endif
+        cnn::real z = w[input_dim];
+        for (unsigned r = 0; r < input_dim; r++)
+            z += w[r] * x[r];
+        return z;
+    }
+
+    /// log sigmoid(t) without overflow
+    static cnn::real log_sigmoid(cnn::real t)
+    {
+        return -(max<cnn::real>(-t, 0) + log1p(exp(-fabs(t))));
+    }
+
+    vector<cnn::real> HuffmanSoftmaxBuilder::respond(const Expression &in, ComputationGraph& cg)
+    {
+        /// the scores of all inner nodes in one product, on whichever device holds the rows
+        vector<unsigned> all_nodes(vocab_size - 1);
+        std::iota(all_nodes.begin(), all_nodes.end(), 0);
+        Expression i_nodes = const_lookup_cols(cg, p_nodes, all_nodes);
+        Expression i_x = concatenate({ reshape(in, { input_dim }), input(cg, 1.0) });
+        vector<cnn::real> scores = get_value(transpose(i_nodes) * i_x, cg);
+
+        vector<cnn::real> dist(vocab_size);
+        vector<cnn::real> inner(vocab_size - 1, 0);
+        for (int i = (int)vocab_size - 2; i >= 0; i--)
+        {
+            cnn::real z = scores[i];
+            cnn::real lp[2] = { inner[i] + log_sigmoid(-z), inner[i] + log_sigmoid(z) };
+            unsigned child[2] = { left[i], right[i] };
+            for (unsigned k = 0; k < 2; k++)
+            {
+                if (child[k] < vocab_size)
+                    dist[child[k]] = lp[k];
+                else
+                    inner[child[k] - vocab_size] = lp[k];
+            }
+        }
+        return dist;
+    }
+
+    vector<pair<unsigned, cnn::real>> HuffmanSoftmaxBuilder::top_k(const vector<cnn::real>& x, unsigned k) const
+    {
+        vector<pair<unsigned, cnn::real>> best;
+        typedef pair<cnn::real, unsigned> open_node; /// (log probability, node id)
+        priority_queue<open_node> q;
+        q.push(open_node(0, vocab_size + vocab_size - 2));
+        while (!q.empty() && best.size() < k)
+        {
+            open_node n = q.top(); q.pop();
+            if (n.second < vocab_size)
+            {
+                best.push_back(make_pair(n.second, n.first));
+                continue;
+            }
+            unsigned i = n.second - vocab_size;
+            cnn::real z = node_score(i, x);
+            q.push(open_node(n.first + log_sigmoid(-z), left[i]));
+            q.push(open_node(n.first + log_sigmoid(z), right[i]));
+        }
+        return best;
+    }
+
+    vector<pair<unsigned, cnn::real>> HuffmanSoftmaxBuilder::top_k(const Expression &in, ComputationGraph& cg, unsigned k) const
+    {
+        return top_k(get_value(in, cg), k);
+    }
+
+    void HuffmanSoftmaxBuilder::copy(const HuffmanSoftmaxBuilder& ref)
+    {
+        p_nodes->copy(*ref.p_nodes);
+    }
+
 } // namespace cnn
@@ -4,10 +4,13 @@
 /**
 this is for approximating criterion.
 1) class-based objective
-To-do: NCE
+2) sampled softmax
+3) hierarchical softmax over a Huffman tree
 */
 #include <string>
 #include <vector>
+#include <random>
+#include <utility>
 #include "cnn/model.h"
 #include "cnn/cnn.h"
 #include "cnn/expr.h"
@@ -46,7 +49,7 @@ namespace cnn {
 
     protected:
         void new_graph_impl(ComputationGraph& cg);
-        virtual Expression add_input_impl(const Expression& x, long target_wordid, unsigned uttid);
+        virtual vector<Expression> add_input_impl(const Expression& x, const vector<long>& targetid);
 
     public:
         vector<Expression> back() const { return errors.back(); }
@@ -62,16 +65,10 @@ namespace cnn {
         // add another timestep by reading in the variable x
         // targetid is a vector of training target. for target dont want to have error signals, set the corresponding element to a negative value
         // return the errors
-        vector<Expression> add_input(const Expression& x, vector<long> targetid) {
-            vector<Expression> err; 
-            unsigned id = 0;
-            for (auto& p : targetid)
-            {
-                if (p >= 0)
-                    err.push_back(add_input_impl(x, p, id));
-                id++;
-            }
-            return err;
+        // the class layer is scored for all utterances at once, and the
+        // within-class layer once for each class that has targets
+        vector<Expression> add_input(const Expression& x, const vector<long>& targetid) {
+            return add_input_impl(x, targetid);
         }
 
         // call this to reset the builder when you are working with a newly
@@ -110,6 +107,164 @@ namespace cnn {
         vector<vector<Expression>> errors; /// [nutt][vector<error>] 
     };
 
+    /**
+    Walker's alias method: draws from a fixed discrete distribution in O(1)
+    after an O(n) setup
+    */
+    class AliasSampler {
+    public:
+        AliasSampler() {}
+        explicit AliasSampler(const vector<cnn::real>& weights);
+
+        unsigned sample(std::mt19937& eng) const;
+        /// the normalized probability of i
+        cnn::real probability(unsigned i) const { return dist[i]; }
+        unsigned size() const { return dist.size(); }
+
+    protected:
+        vector<cnn::real> keep;   /// probability of returning bucket i itself
+        vector<unsigned> alias;   /// what bucket i returns otherwise
+        vector<cnn::real> dist;
+    };
+
+    /**
+    sampled softmax (Jean et al., 2015)
+    each add_input scores only the targets and nsamples words drawn from the
+    unigram distribution raised to power, with the scores corrected by the log
+    of each word's expected count in the sample. the output layer is kept in
+    lookup parameters so that only the rows that were scored get gradients,
+    which makes the cost per token independent of the vocabulary size.
+    respond still computes the full distribution.
+    */
+    class SampledSoftmaxBuilder{
+    public:
+        SampledSoftmaxBuilder() : p_R(nullptr), p_bias(nullptr), nsamples(0), dparallel(1) {}
+        explicit SampledSoftmaxBuilder(
+            const unsigned int input_dim,
+            const vector<cnn::real>& word_counts, /// unigram counts indexed by word id
+            unsigned nsamples,
+            Model& model,
+            cnn::real iscale,
+            string name = "",
+            cnn::real power = 0.75);
+
+        ~SampledSoftmaxBuilder() {}
+
+    public:
+        vector<Expression> back() const { return errors.back(); }
+        void copy(const SampledSoftmaxBuilder& params);
+
+        void set_data_in_parallel(int n);
+        int data_in_parallel() const { return dparallel; }
+
+    public:
+        // x holds one column of input_dim per utterance, targetid one word
+        // per utterance; negative targets have no error signal
+        // return the errors of the utterances with a target
+        vector<Expression> add_input(const Expression& x, const vector<long>& targetid);
+
+        // call this to reset the builder when you are working with a newly
+        // created ComputationGraph object
+        void new_graph(ComputationGraph& cg);
+
+        void start_new_sequence() {
+        }
+
+        // log probabilities of all words given in
+        vector<cnn::real> respond(const Expression &in, ComputationGraph& cg);
+
+    protected:
+        LookupParameters* p_R;
+        LookupParameters* p_bias;
+        unsigned input_dim;
+        unsigned vocab_size;
+        unsigned nsamples;
+        AliasSampler noise;
+        vector<cnn::real> log_expected_count; /// log(nsamples * noise probability) per word
+        vector<unsigned> all_words;
+
+        ComputationGraph* pcg;
+        int dparallel;
+
+        vector<vector<Expression>> errors; /// [nutt][vector<error>]
+    };
+
+    /**
+    hierarchical softmax over a Huffman tree of the vocabulary (Morin and
+    Bengio, 2005; Mikolov et al., 2013)
+    a word's probability is the product of the binary decisions on its path
+    from the root, and frequent words get short paths, so a target costs
+    O(log V) dot products. the inner nodes are rows [w; b] of one lookup
+    table; the rows on the paths of a minibatch are gathered at once and
+    scored by a single HierarchicalSoftmaxPath node.
+    */
+    class HuffmanSoftmaxBuilder{
+    public:
+        HuffmanSoftmaxBuilder() : p_nodes(nullptr), pcg(nullptr), dparallel(1) {}
+        explicit HuffmanSoftmaxBuilder(
+            const unsigned int input_dim,
+            const vector<cnn::real>& word_counts, /// corpus counts indexed by the Dict word id
+            Model& model,
+            cnn::real iscale,
+            string name = "");
+
+        ~HuffmanSoftmaxBuilder() {}
+
+    public:
+        vector<Expression> back() const { return errors.back(); }
+        void copy(const HuffmanSoftmaxBuilder& params);
+
+        void set_data_in_parallel(int n);
+        int data_in_parallel() const { return dparallel; }
+
+    public:
+        // x holds one column of input_dim per utterance, targetid one word
+        // per utterance; negative targets have no error signal, targets not
+        // below vocab_size throw std::invalid_argument
+        // return the errors of the utterances with a target
+        vector<Expression> add_input(const Expression& x, const vector<long>& targetid);
+
+        // call this to reset the builder when you are working with a newly
+        // created ComputationGraph object
+        void new_graph(ComputationGraph& cg);
+
+        void start_new_sequence() {
+        }
+
+        // log probabilities of all words given in, O(V). the inner nodes are
+        // scored by the graph, the walk down the tree is on the host
+        vector<cnn::real> respond(const Expression &in, ComputationGraph& cg);
+
+        // the k most probable words given x with their log probabilities,
+        // best first. the descent expands the most probable open tree node
+        // first, and since probabilities only shrink down a path it stops
+        // after the k-th word without visiting the rest of the tree. the nodes
+        // are scored on the host, one row at a time
+        vector<pair<unsigned, cnn::real>> top_k(const vector<cnn::real>& x, unsigned k) const;
+        vector<pair<unsigned, cnn::real>> top_k(const Expression &in, ComputationGraph& cg, unsigned k) const;
+
+        unsigned path_length(unsigned word) const { return paths[word].size(); }
+
+    protected:
+        void build_tree(const vector<cnn::real>& word_counts);
+        /// the score of inner node i for x
+        cnn::real node_score(unsigned i, const vector<cnn::real>& x) const;
+
+        LookupParameters* p_nodes; /// one row [w; b] per inner node
+        unsigned input_dim;
+        unsigned vocab_size;
+        vector<vector<unsigned>> paths;  /// inner nodes from the root to each word
+        vector<vector<cnn::real>> codes; /// +1 where the path takes the right branch, -1 for the left
+        /// children of inner node i: words are ids below vocab_size, inner
+        /// node j is vocab_size + j
+        vector<unsigned> left, right;
+
+        ComputationGraph* pcg;
+        int dparallel;
+
+        vector<vector<Expression>> errors; /// [nutt][vector<error>]
+    };
+
 };
 
 #endif
@@ -5,6 +5,9 @@
 #include "cnn/aligned-mem-pool.h"
 #include "cnn/cnn-helper.h"
 #include "cnn/expr.h"
+#include "cnn/shape-cache.h"
+
+#include <algorithm>
 
 using namespace std;
 
@@ -13,7 +16,7 @@ namespace cnn {
 cnn::real* kSCALAR_MINUSONE;
 cnn::real* kSCALAR_ONE;
 cnn::real* kSCALAR_ZERO;
-int n_hgs = 0;
+thread_local int n_hgs = 0;  // graphs of the calling thread
 int device_id = CPUDEVICE;
 
 /// some constants 
@@ -63,10 +66,10 @@ void Node::backward(const std::vector<const Tensor*>& xs,
 }
 
 ComputationGraph::ComputationGraph() : 
-  ee(new SimpleExecutionEngine(*this)) {
+  direct_update_scale(0), ee(new SimpleExecutionEngine(*this)), shape(nullptr) {
   ++n_hgs;
   if (n_hgs > 1) {
-    cerr << "Memory allocator assumes only a single ComputationGraph at a time.\n";
+    cerr << "Memory allocator assumes only a single ComputationGraph at a time per thread.\n";
     throw std::runtime_error("Attempted to create >1 CG");
   }
 }
@@ -78,11 +81,40 @@ ComputationGraph::~ComputationGraph() {
 }
 
 void ComputationGraph::clear() {
+  if (shape != nullptr) {
+    shape->num_parameter_nodes = std::max(shape->num_parameter_nodes, (unsigned)parameter_nodes.size());
+    shape = nullptr;
+  }
   parameter_nodes.clear();
+  kept_nodes.clear();
   for (auto n : nodes) delete n;
   nodes.clear();
 }
 
+GraphCheckpoint ComputationGraph::checkpoint() const {
+  GraphCheckpoint c;
+  c.num_nodes = nodes.size();
+  c.num_parameter_nodes = parameter_nodes.size();
+  c.node_mark = mem_nodes->mark();
+  ee->checkpoint(c);
+  return c;
+}
+
+void ComputationGraph::rollback(const GraphCheckpoint& c) {
+  if (c.num_nodes > nodes.size() || c.num_parameter_nodes > parameter_nodes.size())
+    throw std::invalid_argument("ComputationGraph::rollback to a checkpoint the graph has been rolled back or cleared past");
+  ee->rollback(c);
+  // Node's operator delete frees all of mem_nodes, so only run the
+  // destructors and give the memory back by rewinding the pool
+  for (unsigned i = c.num_nodes; i < nodes.size(); ++i)
+    nodes[i]->~Node();
+  nodes.resize(c.num_nodes);
+  parameter_nodes.resize(c.num_parameter_nodes);
+  kept_nodes.erase(std::remove_if(kept_nodes.begin(), kept_nodes.end(),
+                                  [&](VariableIndex k) { return k >= c.num_nodes; }), kept_nodes.end());
+  mem_nodes->rewind(c.node_mark);
+}
+
 VariableIndex ComputationGraph::add_input(real s) {
   VariableIndex new_node_index(nodes.size());
   nodes.push_back(new ScalarInputNode(s));
@@ -204,10 +236,45 @@ VariableIndex ComputationGraph::add_const_lookup(LookupParameters* p, const std:
   set_dim_for_new_node(new_node_index);
   return new_node_index;
 }
+VariableIndex ComputationGraph::add_lookup_cols(LookupParameters* p, const std::vector<unsigned>* pindices) {
+  VariableIndex new_node_index(nodes.size());
+  LookupColumnsNode* new_node = new LookupColumnsNode(p, pindices);
+  nodes.push_back(new_node);
+  parameter_nodes.push_back(new_node_index);
+  set_dim_for_new_node(new_node_index);
+  return new_node_index;
+}
+
+VariableIndex ComputationGraph::add_lookup_cols(LookupParameters* p, const std::vector<unsigned>& indices) {
+  VariableIndex new_node_index(nodes.size());
+  LookupColumnsNode* new_node = new LookupColumnsNode(p, indices);
+  nodes.push_back(new_node);
+  parameter_nodes.push_back(new_node_index);
+  set_dim_for_new_node(new_node_index);
+  return new_node_index;
+}
+
+VariableIndex ComputationGraph::add_const_lookup_cols(LookupParameters* p, const std::vector<unsigned>* pindices) {
+  VariableIndex new_node_index(nodes.size());
+  LookupColumnsNode* new_node = new LookupColumnsNode(p, pindices);
+  nodes.push_back(new_node);
+  set_dim_for_new_node(new_node_index);
+  return new_node_index;
+}
+
+VariableIndex ComputationGraph::add_const_lookup_cols(LookupParameters* p, const std::vector<unsigned>& indices) {
+  VariableIndex new_node_index(nodes.size());
+  LookupColumnsNode* new_node = new LookupColumnsNode(p, indices);
+  nodes.push_back(new_node);
+  set_dim_for_new_node(new_node_index);
+  return new_node_index;
+}
+
 // factory function should call this right after creating a new node object
 // to set its dimensions properly
 void ComputationGraph::set_dim_for_new_node(const VariableIndex& i) {
   Node* node = nodes[i];
+  if (shape != nullptr && shape->replay(i, node)) return;
   vector<Dim> xds(node->arity());
   unsigned ai = 0;
   for (VariableIndex arg : node->args) {
@@ -215,6 +282,17 @@ void ComputationGraph::set_dim_for_new_node(const VariableIndex& i) {
     ++ai;
   }
   node->dim = node->dim_forward(xds);
+  if (shape != nullptr) shape->record(i, node);
+}
+
+void ComputationGraph::use_shape_cache(GraphShapeCache* cache, const std::vector<unsigned>& key) {
+  if (nodes.size() > 0) {
+    cerr << "use_shape_cache() must be called before nodes are added to the graph\n";
+    throw std::runtime_error("use_shape_cache() on a non-empty graph");
+  }
+  shape = cache->find(key);
+  nodes.reserve(shape->size());
+  parameter_nodes.reserve(shape->num_parameter_nodes);
 }
 
 void ComputationGraph::set_last_node_evaluated(VariableIndex idx){
@@ -230,6 +308,13 @@ const Tensor& ComputationGraph::get_error(VariableIndex i) { return ee->get_erro
 void ComputationGraph::invalidate() { ee->invalidate(); }
 void ComputationGraph::backward(cnn::real * kInitError){ ee->backward(kInitError); }
 void ComputationGraph::backward(VariableIndex i) { ee->backward(i); }
+void ComputationGraph::set_memory_reuse(t_memory_reuse m) { ee->set_memory_reuse(m); }
+void ComputationGraph::keep_value(VariableIndex i) { kept_nodes.push_back(i); }
+void ComputationGraph::keep_value(const expr::Expression& e) { keep_value(e.i); }
+void ComputationGraph::set_execution_engine(ExecutionEngine* e) {
+  delete ee;
+  ee = e;
+}
 
 void ComputationGraph::PrintGraphviz() const {
   cerr << "digraph G {\n  rankdir=LR;\n  nodesep=.05;\n";
@@ -12,6 +12,7 @@
 #include "cnn/aligned-mem-pool.h"
 #include "cnn/tensor.h"
 #include "cnn/model.h"
+#include "cnn/random.h"
 
 // Computation graph where nodes represent forward and backward intermediate
 // values, and edges represent functions of multiple values. To represent the
@@ -24,9 +25,27 @@
 
 namespace cnn {
 
-extern AlignedMemoryPool<ALIGN>* fxs;
-extern AlignedMemoryPool<ALIGN>* dEdfs;
-extern AlignedMemoryPool<ALIGN>* mem_nodes;
+// the pools that graphs are built and evaluated in belong to the thread using
+// them, as does rndeng, so that several threads can each work on a graph of
+// their own, see InitializeThread()
+extern thread_local AlignedMemoryPool<ALIGN>* fxs;
+extern thread_local AlignedMemoryPool<ALIGN>* dEdfs;
+extern thread_local AlignedMemoryPool<ALIGN>* mem_nodes;
+
+// the per-thread state of a thread, for helper threads that evaluate nodes on
+// its behalf, such as the workers of a ParallelExecutionEngine
+struct ThreadState {
+  AlignedMemoryPool<ALIGN>* fxs;
+  AlignedMemoryPool<ALIGN>* dEdfs;
+  AlignedMemoryPool<ALIGN>* mem_nodes;
+  std::mt19937* rndeng;
+
+  // the state of the calling thread
+  static ThreadState current();
+  // lets the calling thread use this state
+  void make_current() const;
+};
+
 extern cnn::real* kSCALAR_MINUSONE;
 extern cnn::real* kSCALAR_ONE;
 extern cnn::real* kSCALAR_ZERO;
@@ -36,7 +55,28 @@ extern int device_id;
 /// [1/2,1/3,1/3, ..., 1/N]
 extern std::vector<cnn::real*> kSCALAR_ONE_OVER_INT;
 
+/// how the execution engine recycles the buffers of nodes whose values are dead.
+/// reuse_gradients: in backward, a node's gradient buffer is handed to another node
+///   once the node has propagated it to its arguments; get_error() then only works
+///   for nodes that have not been recycled.
+/// reuse_values_and_gradients: in addition, a full forward pass recycles a value once
+///   its last consumer has been evaluated. only the requested node and nodes without
+///   consumers keep their values, so this is for graphs that are not differentiated.
+/// recompute_values: activation recomputation for graphs that are differentiated. forward
+///   recycles values as reuse_values_and_gradients, except for the nodes marked with
+///   ComputationGraph::keep_value() and for nodes that are not thread safe, such as those
+///   drawing random numbers, whose values could not be reproduced. backward
+///   splits the graph into segments that end at the kept nodes and, when it reaches a
+///   segment, evaluates the recycled values of the segment again, and the values they
+///   depend on, and gives them back once the segment is done. marking e.g. the states of
+///   an RNN at each step bounds the live values by about one step, at the cost of
+///   evaluating most nodes twice. the inputs of the graph must not change between forward
+///   and backward. gradients are recycled as with reuse_gradients.
+typedef enum { no_memory_reuse = 0, reuse_gradients = 1, reuse_values_and_gradients = 2, recompute_values = 3 } t_memory_reuse;
+
 class ExecutionEngine;
+class GraphShape;
+class GraphShapeCache;
 struct ParameterNodeBase;
 struct Node;
 namespace expr { struct Expression; }
@@ -48,6 +88,16 @@ inline void swap(VariableIndex& i1, VariableIndex& i2) {
   i2 = t;
 }
 
+// a state of a ComputationGraph to go back to, see ComputationGraph::checkpoint()
+struct GraphCheckpoint {
+  unsigned num_nodes;
+  unsigned num_parameter_nodes;
+  unsigned num_nodes_evaluated;
+  unsigned long fx_generation;               // number of times the engine had freed fxs
+  AlignedMemoryPool<ALIGN>::Position fx_mark;
+  AlignedMemoryPool<ALIGN>::Position node_mark;
+};
+
 struct ComputationGraph {
   ComputationGraph();
   ~ComputationGraph();
@@ -84,6 +134,11 @@ struct ComputationGraph {
   VariableIndex add_const_lookup(LookupParameters* p, unsigned index);
   VariableIndex add_const_lookup(LookupParameters* p, const std::vector<unsigned>* pindices);
   VariableIndex add_const_lookup(LookupParameters* p, const std::vector<unsigned>& indices);
+  // gather the embeddings of indices into the columns of one matrix
+  VariableIndex add_lookup_cols(LookupParameters* p, const std::vector<unsigned>* pindices);
+  VariableIndex add_lookup_cols(LookupParameters* p, const std::vector<unsigned>& indices);
+  VariableIndex add_const_lookup_cols(LookupParameters* p, const std::vector<unsigned>* pindices);
+  VariableIndex add_const_lookup_cols(LookupParameters* p, const std::vector<unsigned>& indices);
 
   // COMPUTATIONS
   template <class Function> inline VariableIndex add_function(const std::initializer_list<VariableIndex>& arguments);
@@ -95,6 +150,15 @@ struct ComputationGraph {
   // reset ComputationGraph to a newly created state
   void clear();
 
+  // remembers the current graph, so that the nodes added afterwards can be
+  // dropped again with rollback(), e.g. the expansions of a search branch.
+  // rollback() releases their memory in mem_nodes and, if the nodes before
+  // the checkpoint have not been re-evaluated by a full forward() since, in
+  // fxs. values computed before the checkpoint stay valid. a checkpoint is
+  // valid until the graph is rolled back past it or cleared.
+  GraphCheckpoint checkpoint() const;
+  void rollback(const GraphCheckpoint& c);
+
   // perform computations
 
   // run complete forward pass from first node to last existing one, ignoring all precomputed values.
@@ -121,17 +185,42 @@ struct ComputationGraph {
   // computes backward gradients from node i (assuming it already been evaluated).
   void backward(VariableIndex i);
 
+  // lets the execution engine recycle buffers of dead values, see t_memory_reuse
+  void set_memory_reuse(t_memory_reuse m);
+  // keeps the value of node i through forward and backward with recompute_values,
+  // which makes it the end of a segment that backward evaluates again
+  void keep_value(VariableIndex i);
+  void keep_value(const expr::Expression& e);
+
+  // with a nonzero scale, backward adds scale times the gradient of each parameter
+  // straight to its values instead of accumulating it for a Trainer, e.g. -eta for
+  // a plain sgd step. this is how the threads of a HogwildTrainer share a model
+  void set_direct_update(cnn::real scale) { direct_update_scale = scale; }
+
+  // replaces the execution engine, e.g. by a ParallelExecutionEngine. the graph
+  // takes ownership of the engine; call this before evaluating anything.
+  void set_execution_engine(ExecutionEngine* e);
+
+  // replays the node dimensions recorded for graphs with the same shape key
+  // instead of calling dim_forward, see GraphShapeCache. call this on an empty
+  // graph before building it; the recording ends with clear().
+  void use_shape_cache(GraphShapeCache* cache, const std::vector<unsigned>& key);
+
   // debugging
   void PrintGraphviz() const;
 
   // data
   std::vector<Node*> nodes;       // **stored in topological order**
   std::vector<VariableIndex> parameter_nodes; // nodes that contain parameters that can be updated (subset of nodes)
+  std::vector<VariableIndex> kept_nodes;      // nodes marked with keep_value()
+  cnn::real direct_update_scale;              // see set_direct_update(), 0 to accumulate gradients
 
   ExecutionEngine* ee;  // handles the execution
   void set_last_node_evaluated(VariableIndex idx);
  private:
   void set_dim_for_new_node(const VariableIndex& i);
+
+  GraphShape* shape;  // recording of the graph being built, or nullptr
 };
 
 // represents an SSA variable
@@ -170,6 +259,24 @@ struct Node {
   // if false, forward and backward will be called multiple times for each item.
   virtual bool supports_multibatch() const { return false; }
 
+  // whether forward may run at the same time as other nodes. nodes that touch
+  // shared state, e.g. the global random number generator, return false and are
+  // run one at a time by the multi-threaded execution engine.
+  virtual bool is_thread_safe() const { return true; }
+
+  // nodes whose value is a contiguous range of the value of their first argument,
+  // whose dimensions are x, return the offset of that range in elements, -1
+  // otherwise. the execution engines point the value of such a view into its
+  // argument instead of calling forward, and its consumers accumulate straight
+  // into the range of the argument's gradient instead of calling backward
+  virtual int view_offset(const Dim& x) const { return -1; }
+
+  // whether dim_forward depends on members of the node besides the dimensions
+  // of its arguments, e.g. reshape dimensions, ranges or picked indices. the
+  // dimensions of such nodes are always computed by dim_forward, never
+  // replayed from a GraphShapeCache
+  virtual bool has_side_info() const { return false; }
+
   // perform the forward/backward passes in one or multiple calls
   virtual void forward(const std::vector<const Tensor*>& xs,
                        Tensor& fx) const final;
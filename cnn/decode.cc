@@ -0,0 +1,138 @@
+#include "cnn/decode.h"
+
+#include <algorithm>
+#include <numeric>
+#include <functional>
+
+using namespace std;
+
+namespace cnn {
+
+vector<int> HypothesisTree::sequence(int node) const
+{
+    vector<int> words;
+    for (; node >= 0; node = nodes[node].parent)
+        words.push_back(nodes[node].word);
+    reverse(words.begin(), words.end());
+    return words;
+}
+
+BatchedBeamSearch::BatchedBeamSearch(unsigned beam_width, int sos, int eos, unsigned max_len, bool normalize_length, cnn::real margin)
+    : beam_width(beam_width), eos(eos), max_len(max_len), normalize_length(normalize_length), margin(margin), nsteps(0)
+{
+    if (beam_width == 0)
+        throw std::invalid_argument("BatchedBeamSearch needs a beam width of at least 1");
+    live.push_back(hyps.add(-1, sos, 0, -1, 0));
+    live_words.push_back(sos);
+}
+
+bool BatchedBeamSearch::done() const
+{
+    if (live.empty() || nsteps >= max_len)
+        return true;
+    if (margin >= 0)
+        return false;
+    if (complete.size() >= beam_width)
+        return true;
+    if (normalize_length || complete.empty())
+        return false;
+    /// costs only decrease, so no live hypothesis can beat the best complete one
+    cnn::real best_live = hyps.nodes[live[0]].cost;
+    return *max_element(complete_score.begin(), complete_score.end()) >= best_live;
+}
+
+vector<unsigned> BatchedBeamSearch::advance(const vector<cnn::real>& log_probs, unsigned vocab_size)
+{
+    return advance(log_probs, vocab_size, nullptr);
+}
+
+vector<unsigned> BatchedBeamSearch::advance(const vector<cnn::real>& log_probs, const vector<unsigned>& words)
+{
+    return advance(log_probs, words.size(), &words);
+}
+
+vector<unsigned> BatchedBeamSearch::advance(const vector<cnn::real>& log_probs, unsigned vocab_size, const vector<unsigned>* words)
+{
+    unsigned nlive = live.size();
+    if (log_probs.size() != vocab_size * nlive)
+        throw std::invalid_argument("BatchedBeamSearch::advance expects one column of log probabilities per live hypothesis");
+
+    /// the best beam_width words of each column
+    unsigned kword = min(beam_width, vocab_size);
+    word_idx.resize(vocab_size);
+    candidates.clear();
+    for (unsigned b = 0; b < nlive; b++)
+    {
+        const cnn::real* lp = &log_probs[b * vocab_size];
+        cnn::real cost = hyps.nodes[live[b]].cost;
+        iota(word_idx.begin(), word_idx.end(), 0);
+        partial_sort(word_idx.begin(), word_idx.begin() + kword, word_idx.end(),
+            [lp](unsigned i, unsigned j) { return lp[i] > lp[j]; });
+        for (unsigned j = 0; j < kword; j++)
+            candidates.push_back(make_pair(cost + lp[word_idx[j]], b * vocab_size + word_idx[j]));
+    }
+
+    /// the best beam_width extensions over the beam
+    unsigned k = min<unsigned>(beam_width, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(), greater<pair<cnn::real, unsigned>>());
+    /// and within margin of the best of them
+    while (margin >= 0 && k > 1 && candidates[k - 1].first < candidates[0].first - margin)
+        k--;
+
+    vector<int> next;
+    vector<unsigned> parent;
+    live_words.clear();
+    for (unsigned j = 0; j < k; j++)
+    {
+        unsigned b = candidates[j].second / vocab_size;
+        unsigned row = candidates[j].second % vocab_size;
+        int w = words ? (*words)[row] : row;
+        int node = hyps.add(live[b], w, candidates[j].first, nsteps, b);
+        if (w == eos)
+        {
+            complete.push_back(node);
+            complete_score.push_back(normalize_length ? candidates[j].first / (nsteps + 1) : candidates[j].first);
+        }
+        else
+        {
+            next.push_back(node);
+            parent.push_back(b);
+            live_words.push_back(w);
+        }
+    }
+    live.swap(next);
+    nsteps++;
+    return parent;
+}
+
+int BatchedBeamSearch::best_node() const
+{
+    if (!complete.empty())
+        return complete[max_element(complete_score.begin(), complete_score.end()) - complete_score.begin()];
+    /// live hypotheses are kept best first
+    return live.empty() ? 0 : live[0];
+}
+
+vector<int> BatchedBeamSearch::best() const
+{
+    vector<int> words = hyps.sequence(best_node());
+    if (complete.empty())
+        words.push_back(eos);
+    return words;
+}
+
+priority_queue<Hypothesis, vector<Hypothesis>, CompareHypothesis> BatchedBeamSearch::completed_list() const
+{
+    priority_queue<Hypothesis, vector<Hypothesis>, CompareHypothesis> q;
+    for (unsigned i = 0; i < complete.size(); i++)
+    {
+        vector<int> words = hyps.sequence(complete[i]);
+        Hypothesis h(RNNPointer(-1), words[0], complete_score[i], 0);
+        h.target = words;
+        h.t = words.size() - 1;
+        q.push(h);
+    }
+    return q;
+}
+
+} // namespace cnn
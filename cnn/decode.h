@@ -5,6 +5,7 @@
 #include <unordered_map>
 #include <string>
 #include <vector>
+#include <queue>
 #include <iostream>
 #include <stdexcept>
 
@@ -16,6 +17,8 @@
 #include <boost/serialization/string.hpp>
 #endif
 
+#include "cnn/rnn.h"
+
 namespace cnn {
 
 struct Hypothesis {
@@ -40,6 +43,100 @@ struct CompareHypothesis
     }
 };
 
+/// hypotheses of a beam search kept as a prefix tree. a node stores its
+/// last word and a back-pointer to the hypothesis it extends, so extending
+/// a hypothesis is O(1) and a shared prefix is stored once
+struct HypothesisTree {
+    struct Node {
+        int word;
+        int parent;      /// -1 for the root
+        cnn::real cost;  /// log probability of the words up to here
+        int step;        /// the decoder step that scored the word, -1 for the root
+        unsigned column; /// the column of the parent in that step
+    };
+    std::vector<Node> nodes;
+
+    int add(int parent, int word, cnn::real cost, int step, unsigned column) {
+        nodes.push_back(Node{ word, parent, cost, step, column });
+        return nodes.size() - 1;
+    }
+    /// the words from the root to node
+    std::vector<int> sequence(int node) const;
+    void clear() { nodes.clear(); }
+};
+
+/**
+beam search over a decoder that advances all live hypotheses in one batched
+step, one column per hypothesis:
+
+    BatchedBeamSearch beam(beam_width, sos, eos, max_len);
+    while (!beam.done()) {
+        // log probabilities [vocab_size x beam.size()] of the next word
+        // after each of beam.words()
+        vector<unsigned> parent = beam.advance(log_probs, vocab_size);
+        // column i of the next step continues column parent[i] of this one
+    }
+    vector<int> best = beam.best();
+
+each step keeps the beam_width best extensions over the whole beam: the
+best beam_width words of every column are found with a partial sort, and
+the beam_width best of those candidates with another. hypotheses that emit
+eos leave the beam and are scored by their average log probability per
+word when normalize_length is set.
+
+with a margin of zero or more, extensions that score more than margin
+below the best extension of the step are dropped as well, and the search
+goes on until no hypothesis is live or max_len is reached, however many
+have completed. this is the pruning of the unbatched beam_decode, in which the
+beam width is such a margin and max_number_of_hypothesis caps the beam.
+*/
+class BatchedBeamSearch {
+public:
+    BatchedBeamSearch(unsigned beam_width, int sos, int eos, unsigned max_len, bool normalize_length = true,
+        cnn::real margin = -1);
+
+    /// number of live hypotheses, i.e. columns of the next decoder step
+    unsigned size() const { return live.size(); }
+    /// the last word of each live hypothesis, the input to the next step
+    const std::vector<int>& words() const { return live_words; }
+    unsigned steps() const { return nsteps; }
+    bool done() const;
+
+    /// log_probs holds size() columns of vocab_size log probabilities
+    /// returns the column of this step each new live hypothesis extends
+    std::vector<unsigned> advance(const std::vector<cnn::real>& log_probs, unsigned vocab_size);
+    /// the same over a restricted vocabulary: row k of each column scores word words[k]
+    std::vector<unsigned> advance(const std::vector<cnn::real>& log_probs, const std::vector<unsigned>& words);
+
+    /// the best completed hypothesis, or the best live one followed by eos
+    /// when none has completed; includes sos
+    int best_node() const;
+    std::vector<int> best() const;
+    /// the completed hypotheses with their scores, best on top
+    std::priority_queue<Hypothesis, std::vector<Hypothesis>, CompareHypothesis> completed_list() const;
+
+    const HypothesisTree& tree() const { return hyps; }
+
+private:
+    std::vector<unsigned> advance(const std::vector<cnn::real>& log_probs, unsigned nrows, const std::vector<unsigned>* words);
+
+    unsigned beam_width;
+    int eos;
+    unsigned max_len;
+    bool normalize_length;
+    cnn::real margin;
+
+    HypothesisTree hyps;
+    std::vector<int> live;        /// tree nodes of the live hypotheses
+    std::vector<int> live_words;
+    std::vector<int> complete;    /// tree nodes ending with eos
+    std::vector<cnn::real> complete_score;
+    unsigned nsteps;
+
+    std::vector<unsigned> word_idx;                        /// reused by advance
+    std::vector<std::pair<cnn::real, unsigned>> candidates;
+};
+
 } // namespace cnn
 
 #endif
@@ -343,6 +343,95 @@ Expression DGLSTMBuilder::add_input_impl(int prev, const Expression& x) {
   return ht.back();
 }
 
+vector<Expression> DGLSTMBuilder::add_sequence_impl(int prev, const vector<Expression>& xs) {
+  const unsigned t0 = h.size();
+  const unsigned nutt = num_columns(xs[0]);
+  const unsigned ncols = nutt * xs.size();
+  h.resize(t0 + xs.size(), vector<Expression>(layers));
+  c.resize(t0 + xs.size(), vector<Expression>(layers));
+
+  vector<Expression> in = xs;
+  for (unsigned i = 0; i < layers; ++i) {
+    const vector<Expression>& vars = param_vars[i];
+    // projections of the stabilized input of all steps at once
+    Expression x = concatenate_cols(in);
+    Expression x_stb = cwise_multiply(concatenate_cols(vector<Expression>(ncols, biases[i][6])), x);
+    Expression pi = colwise_add(vars[X2I] * x_stb, vars[BI]);
+#ifdef USE_STANDARD_LSTM_DEFINE
+    Expression pf = colwise_add(vars[X2F] * x_stb, vars[BF]);
+#endif
+    Expression pc = colwise_add(vars[X2C] * x_stb, vars[BC]);
+    Expression po = colwise_add(vars[X2O] * x_stb, vars[BO]);
+    Expression pk = colwise_add(vars[X2K] * x_stb, vars[BK]);
+    Expression pk0;
+    if (i == 0)
+      pk0 = vars[X2K0] * x;
+
+    for (unsigned t = 0; t < xs.size(); ++t) {
+      int p = sequence_prev(prev, t0, t);
+      vector<Expression>& ht = h[t0 + t];
+      vector<Expression>& ct = c[t0 + t];
+      Expression i_h_tm1, i_c_tm1;
+      bool has_prev_state = (p >= 0 || has_initial_state);
+      if (p < 0) {
+        if (has_initial_state) {
+          i_h_tm1 = h0[i];
+          i_c_tm1 = c0[i];
+        }
+      } else {
+        i_h_tm1 = h[p][i];
+        i_c_tm1 = c[p][i];
+      }
+
+      Expression i_ait = sequence_step(pi, t, nutt);
+      if (has_prev_state)
+        i_ait = affine_transform({ i_ait, vars[H2I], i_h_tm1, vars[C2I], i_c_tm1 });
+      Expression i_it = logistic(i_ait);
+
+#ifdef USE_STANDARD_LSTM_DEFINE
+      Expression i_aft = sequence_step(pf, t, nutt);
+      if (has_prev_state)
+        i_aft = affine_transform({ i_aft, vars[H2F], i_h_tm1, vars[C2F], i_c_tm1 });
+      Expression i_ft = logistic(i_aft);
+#else
+      Expression i_ft = 1.0 - i_it;
+#endif
+
+      Expression i_awt = sequence_step(pc, t, nutt);
+      if (has_prev_state)
+        i_awt = affine_transform({ i_awt, vars[H2C], i_h_tm1 });
+      Expression i_wt = tanh(i_awt);
+
+      Expression i_before_add_with_lower_linearly;
+      if (has_prev_state) {
+        Expression i_nwt = cwise_multiply(i_it, i_wt);
+        Expression i_crt = cwise_multiply(i_ft, i_c_tm1);
+        i_before_add_with_lower_linearly = i_crt + i_nwt;
+      } else {
+        i_before_add_with_lower_linearly = cwise_multiply(i_it, i_wt);
+      }
+
+      /// add lower layer memory cell
+      Expression i_k = sequence_step(pk, t, nutt);
+      if (i > 0)
+        i_k = i_k + cwise_multiply(biases[i][4], c[t0 + t][i - 1]);
+      if (has_prev_state)
+        i_k = i_k + cwise_multiply(biases[i][5], i_c_tm1);
+      Expression i_k_t = logistic(i_k);
+      ct[i] = i_before_add_with_lower_linearly
+        + cwise_multiply(i_k_t, (i == 0) ? sequence_step(pk0, t, nutt) : c[t0 + t][i - 1]);
+
+      Expression i_aot = sequence_step(po, t, nutt);
+      if (has_prev_state)
+        i_aot = affine_transform({ i_aot, vars[H2O], i_h_tm1, vars[C2O], ct[i] });
+      Expression i_ot = logistic(i_aot);
+      Expression ph_t = tanh(ct[i]);
+      in[t] = ht[i] = cwise_multiply(i_ot, ph_t);
+    }
+  }
+  return in;
+}
+
 Expression DGLSTMBuilder::add_input_impl(int prev, const vector<Expression>& x) {
     h.push_back(vector<Expression>(layers));
     c.push_back(vector<Expression>(layers));
@@ -40,6 +40,7 @@ struct DGLSTMBuilder: public RNNBuilder {
   Expression add_input_impl(int prev, const Expression& x) override;
   Expression add_input_impl(int prev, const std::vector<Expression>& x) override;
   Expression add_input_impl(const std::vector<Expression>& prev_history, const Expression& x);
+  std::vector<Expression> add_sequence_impl(int prev, const std::vector<Expression>& xs) override;
 
  public:
   // first index is time, second is layer 
@@ -3,12 +3,38 @@
 #include "cnn/param-nodes.h"
 #include "cnn/expr-xtra.h"
 
+#include <map>
+#include <stdexcept>
+
 using namespace std;
 
 namespace cnn {
 
 ExecutionEngine::~ExecutionEngine() {}
 
+int ExecutionEngine::forward_view(VariableIndex i) const {
+  const Node* node = cg.nodes[i];
+  return node->arity() ? node->view_offset(cg.nodes[node->args[0]]->dim) : -1;
+}
+
+vector<int> ExecutionEngine::gradient_views(unsigned num_nodes, const vector<bool>& needs_derivative) const {
+  vector<int> grad_view(num_nodes, -1);
+  for (unsigned i = 0; i + 1 < num_nodes; ++i) {
+    int off = forward_view(VariableIndex(i));
+    if (off >= 0 && needs_derivative[cg.nodes[i]->args[0]])
+      grad_view[i] = off;
+  }
+  return grad_view;
+}
+
+void ExecutionEngine::update_parameters(VariableIndex i, const Tensor& g) const {
+  auto node = static_cast<ParameterNodeBase*>(cg.nodes[i]);
+  if (cg.direct_update_scale != 0)
+    node->update_values(g, cg.direct_update_scale);
+  else
+    node->accumulate_grad(g);
+}
+
 void SimpleExecutionEngine::invalidate() {
     num_nodes_evaluated = 0;
 }
@@ -37,6 +63,7 @@ const Tensor& SimpleExecutionEngine::get_value(VariableIndex i) {
     if (i >= num_nodes_evaluated) {
       incremental_forward();
     }
+    check_value_available(i);
     return nfxs[i];
 }
 
@@ -48,6 +75,11 @@ const Tensor& SimpleExecutionEngine::get_error(VariableIndex i)
         cerr << "need to run backward before calling this function" << endl;
         abort();
     }
+    if (ndEdfs[i].v == nullptr)
+    {
+        cerr << "gradient of node " << i << " has been recycled. use no_memory_reuse to keep gradients of intermediate nodes" << endl;
+        abort();
+    }
 
     return ndEdfs[i];
 }
@@ -66,10 +98,20 @@ const Tensor& SimpleExecutionEngine::incremental_forward(VariableIndex i) {
   assert(i < cg.nodes.size());
 
   // free any old memory if this is a new HG
-  if (num_nodes_evaluated == 0) fxs->free();
+  bool recycle_values = false;
+  if (num_nodes_evaluated == 0) {
+    fxs->free();
+    ++fx_generation;
+    fx_pool.reset(fxs);
+    fx_owner.clear();
+    values_recycled = false;
+    recycle_values = (memory_reuse == reuse_values_and_gradients || memory_reuse == recompute_values);
+  }
 
   if (i >= num_nodes_evaluated) {
     nfxs.resize(i + 1);
+    if (recycle_values)
+      plan_forward_reuse(num_nodes_evaluated, i);
 
     //vector<string> dummy(5, "x");
     vector<const Tensor*> xs(16);
@@ -78,15 +120,25 @@ const Tensor& SimpleExecutionEngine::incremental_forward(VariableIndex i) {
       xs.resize(node->arity());
       unsigned ai = 0;
       for (VariableIndex arg : node->args) {
+        check_value_available(arg);
         xs[ai] = &nfxs[arg];
         ++ai;
       }
       nfxs[num_nodes_evaluated].d = node->dim;
-      nfxs[num_nodes_evaluated].v = static_cast<cnn::real*>(fxs->allocate(node->dim.size() * sizeof(cnn::real)));
-      if (nfxs[num_nodes_evaluated].v == nullptr) {
-        cerr << "no more memory space for forward computation. requested " << node->dim.size() << endl;
-        cerr << "out of memory\n";
-        abort();
+      nfxs[num_nodes_evaluated].m_device_id = device_id;
+      void* buf = nullptr;
+      const int view = forward_view(num_nodes_evaluated);
+      if (view >= 0) {
+        // a view is not computed, it points into the value of its argument
+        nfxs[num_nodes_evaluated].v = nfxs[node->args[0]].v + view;
+      } else {
+        buf = fx_pool.allocate(node->dim.size() * sizeof(cnn::real));
+        nfxs[num_nodes_evaluated].v = static_cast<cnn::real*>(buf);
+        if (nfxs[num_nodes_evaluated].v == nullptr) {
+          cerr << "no more memory space for forward computation. requested " << node->dim.size() << endl;
+          cerr << "out of memory\n";
+          abort();
+        }
       }
       void* aux_mem = nullptr;
       size_t aux_size = node->aux_storage_size();
@@ -99,12 +151,96 @@ const Tensor& SimpleExecutionEngine::incremental_forward(VariableIndex i) {
         }
       }
       node->aux_mem = aux_mem;
-      node->forward(xs, nfxs[num_nodes_evaluated]);
+      if (view < 0)
+        node->forward(xs, nfxs[num_nodes_evaluated]);
+      if (recycle_values)
+        recycle_forward_buffers(num_nodes_evaluated, buf);
     }
   }
+  check_value_available(i);
   return nfxs[i];
 }
 
+void SimpleExecutionEngine::checkpoint(GraphCheckpoint& c) const {
+  c.num_nodes_evaluated = num_nodes_evaluated;
+  c.fx_generation = fx_generation;
+  c.fx_mark = fxs->mark();
+}
+
+void SimpleExecutionEngine::rollback(const GraphCheckpoint& c) {
+  if (!fx_owner.empty()) {
+    // kept values may have been recycled into buffers of dropped nodes
+    num_nodes_evaluated = 0;
+  } else if (c.fx_generation == fx_generation && num_nodes_evaluated >= c.num_nodes_evaluated) {
+    // everything allocated since the checkpoint belongs to nodes evaluated after it
+    fxs->rewind(c.fx_mark);
+    num_nodes_evaluated = c.num_nodes_evaluated;
+  } else if (num_nodes_evaluated > c.num_nodes) {
+    num_nodes_evaluated = c.num_nodes;
+  }
+  if (nfxs.size() > (unsigned)num_nodes_evaluated)
+    nfxs.resize(num_nodes_evaluated);
+}
+
+void SimpleExecutionEngine::plan_forward_reuse(VariableIndex from, VariableIndex to) {
+  fx_owner.resize(to + 1);
+  fx_last_use.assign(to + 1, -1);
+  // nodes are in topological order, so the last assignment is the last reader
+  for (unsigned j = from; j <= to; ++j)
+    for (VariableIndex arg : cg.nodes[j]->args)
+      if (arg >= from)
+        fx_last_use[arg] = j;
+  fx_last_use[to] = -1;
+  if (memory_reuse == recompute_values) {
+    for (VariableIndex k : cg.kept_nodes)
+      if (k >= from && k <= to)
+        fx_last_use[k] = -1;
+    // a node drawing random numbers would not give the same value again
+    for (unsigned j = from; j <= to; ++j)
+      if (!cg.nodes[j]->is_thread_safe())
+        fx_last_use[j] = -1;
+  }
+}
+
+void SimpleExecutionEngine::recycle_forward_buffers(VariableIndex i, void* buf) {
+  const unsigned long nbytes = cg.nodes[i]->dim.size() * sizeof(cnn::real);
+  fx_owner[i] = i;
+  if (nfxs[i].v != buf) {
+    // the node is a view (buf is null), points to the memory of an argument, or
+    // to memory owned elsewhere, e.g. parameters and inputs
+    if (buf != nullptr)
+      fx_pool.release(buf, nbytes);
+    int last_use = fx_last_use[i];
+    fx_last_use[i] = -1;
+    for (VariableIndex arg : cg.nodes[i]->args) {
+      if (buf == nullptr ? arg == cg.nodes[i]->args[0] : nfxs[arg].v == nfxs[i].v) {
+        VariableIndex owner = fx_owner[arg];
+        fx_owner[i] = owner;
+        if (owner < fx_last_use.size() && fx_last_use[owner] >= 0)
+          fx_last_use[owner] = (last_use < 0) ? -1 : max(fx_last_use[owner], last_use);
+        break;
+      }
+    }
+  }
+
+  for (VariableIndex arg : cg.nodes[i]->args) {
+    VariableIndex owner = fx_owner[arg];
+    if (owner < fx_last_use.size() && fx_last_use[owner] == (int)i) {
+      fx_pool.release(nfxs[owner].v, cg.nodes[owner]->dim.size() * sizeof(cnn::real));
+      nfxs[owner].v = nullptr;
+      fx_last_use[owner] = -1;
+      values_recycled = true;
+    }
+  }
+}
+
+void SimpleExecutionEngine::check_value_available(VariableIndex i) const {
+  if (i < fx_owner.size() && nfxs[fx_owner[i]].v == nullptr) {
+    cerr << "value of node " << i << " has been recycled after its last use. use no_memory_reuse or reuse_gradients if intermediate values are needed after forward" << endl;
+    abort();
+  }
+}
+
 void SimpleExecutionEngine::backward(cnn::real * kScalarInit) {
     assert(nfxs.size() == cg.nodes.size());
     backward((VariableIndex)(cg.nodes.size() - 1), kScalarInit);
@@ -119,21 +255,14 @@ void SimpleExecutionEngine::backward(VariableIndex from_where, cnn::real * kScal
     abort();
   }
 
+  if (values_recycled && memory_reuse != recompute_values) {
+    cerr << "backward() needs the forward values, which have been recycled. use reuse_gradients or recompute_values for graphs that are differentiated" << endl;
+    abort();
+  }
+
   const unsigned num_nodes = from_where+1;
   ndEdfs.resize(num_nodes);
   dEdfs->free();
-  for (unsigned i = 0; i < num_nodes; ++i) {
-    const auto dim = nfxs[i].d;
-    ndEdfs[i].d = dim;
-    ndEdfs[i].v = static_cast<cnn::real*>(dEdfs->allocate(dim.size() * sizeof(cnn::real)));
-    assert(ndEdfs[i].v);
-  }
-  dEdfs->zero_allocated_memory();
-  // initialize dE/dE = 1
-  if (kScalarInit == nullptr)
-      ndEdfs.back().v = kSCALAR_ONE;
-  else
-      ndEdfs.back().v = kScalarInit;
   // here we find constant paths to avoid doing extra work
   // by default, a node is constant unless
   //   1) it is a parameter node
@@ -151,9 +280,38 @@ void SimpleExecutionEngine::backward(VariableIndex from_where, cnn::real * kScal
     needs_derivative[ni] = nd;
   }
 
+  // the consumers of a view accumulate into the range of its argument's gradient,
+  // so the gradient of a view is that range and its own backward is skipped
+  const vector<int> grad_view = gradient_views(num_nodes, needs_derivative);
+
+  if (memory_reuse != no_memory_reuse) {
+    ndEdfs.back().d = nfxs[from_where].d;
+    ndEdfs.back().m_device_id = device_id;
+    ndEdfs.back().v = (kScalarInit == nullptr) ? kSCALAR_ONE : kScalarInit;
+    backward_with_reuse(num_nodes, needs_derivative, grad_view);
+    return;
+  }
+
+  for (unsigned i = 0; i < num_nodes; ++i) {
+    const auto dim = nfxs[i].d;
+    ndEdfs[i].d = dim;
+    if (grad_view[i] >= 0)
+      ndEdfs[i].v = ndEdfs[cg.nodes[i]->args[0]].v + grad_view[i];
+    else
+      ndEdfs[i].v = static_cast<cnn::real*>(dEdfs->allocate(dim.size() * sizeof(cnn::real)));
+    assert(ndEdfs[i].v);
+  }
+  dEdfs->zero_allocated_memory();
+  // initialize dE/dE = 1
+  if (kScalarInit == nullptr)
+      ndEdfs.back().v = kSCALAR_ONE;
+  else
+      ndEdfs.back().v = kScalarInit;
+
   // loop in reverse topological order
   vector<const Tensor*> xs;
   for (int i = num_nodes - 1; i >= 0; --i) {
+    if (grad_view[i] >= 0) continue;
     const Node* node = cg.nodes[i];
     xs.resize(node->arity());
     unsigned ai = 0;
@@ -175,7 +333,455 @@ void SimpleExecutionEngine::backward(VariableIndex from_where, cnn::real * kScal
   // since we assume parameters come into the graph as a "function"
   // that returns the current value of the parameters
   for (VariableIndex i : cg.parameter_nodes)
-    static_cast<ParameterNodeBase*>(cg.nodes[i])->accumulate_grad(ndEdfs[i]);
+    update_parameters(i, ndEdfs[i]);
+}
+
+// same as the reverse pass above, but a gradient buffer is only allocated when the
+// first (i.e. highest numbered) consumer of the node writes to it, and it is given
+// back as soon as the node has propagated it to its own arguments. nodes that no
+// consumer reached keep a null gradient and are skipped.
+void SimpleExecutionEngine::allocate_gradient(VariableIndex i, const vector<int>& grad_view) {
+  if (ndEdfs[i].v != nullptr) return;
+  if (grad_view[i] >= 0) {
+    VariableIndex arg = cg.nodes[i]->args[0];
+    allocate_gradient(arg, grad_view);
+    ndEdfs[i].v = ndEdfs[arg].v + grad_view[i];
+    return;
+  }
+  ndEdfs[i].v = static_cast<cnn::real*>(dEdf_pool.allocate(ndEdfs[i].d.size() * sizeof(cnn::real)));
+  if (ndEdfs[i].v == nullptr) {
+    cerr << "no more memory space for backward computation. requested " << ndEdfs[i].d.size() << endl;
+    abort();
+  }
+  TensorTools::Zero(ndEdfs[i]);
+}
+
+void SimpleExecutionEngine::backward_with_reuse(unsigned num_nodes, const vector<bool>& needs_derivative, const vector<int>& grad_view) {
+  dEdf_pool.reset(dEdfs);
+  for (unsigned i = 0; i + 1 < num_nodes; ++i) {
+    ndEdfs[i].d = nfxs[i].d;
+    ndEdfs[i].m_device_id = device_id;
+    ndEdfs[i].v = nullptr;
+  }
+
+  vector<bool> is_parameter_node(num_nodes, false);
+  for (VariableIndex i : cg.parameter_nodes)
+    if (i < num_nodes) is_parameter_node[i] = true;
+
+  // with recycled values, the nodes are visited segment by segment: segment_start[i]
+  // is the first node after the last kept node before i. the values recomputed for a
+  // segment are given back when the loop leaves it
+  const bool recompute = values_recycled;
+  vector<unsigned> segment_start;
+  int seg_first = num_nodes, seg_last = num_nodes - 1;
+  if (recompute) {
+    fx_live.resize(num_nodes);
+    for (unsigned j = 0; j < num_nodes; ++j)
+      fx_live[j] = (j >= fx_owner.size() || nfxs[fx_owner[j]].v != nullptr);
+    fx_recomputed.assign(num_nodes, false);
+    fx_recomputed_buf.assign(num_nodes, nullptr);
+    vector<bool> kept(num_nodes, false);
+    for (VariableIndex k : cg.kept_nodes)
+      if (k < num_nodes) kept[k] = true;
+    segment_start.resize(num_nodes);
+    unsigned first = 0;
+    for (unsigned j = 0; j < num_nodes; ++j) {
+      segment_start[j] = first;
+      if (kept[j]) first = j + 1;
+    }
+  }
+
+  vector<const Tensor*> xs;
+  for (int i = num_nodes - 1; i >= 0; --i) {
+    if (recompute && i < seg_first) {
+      release_recomputed(seg_first, seg_last);
+      seg_first = segment_start[i];
+      seg_last = i;
+    }
+    if (ndEdfs[i].v == nullptr) continue;
+    if (grad_view[i] >= 0) {
+      // already accumulated into the gradient of the argument, which stays allocated
+      ndEdfs[i].v = nullptr;
+      continue;
+    }
+    const Node* node = cg.nodes[i];
+    if (recompute) {
+      recompute_value(VariableIndex(i));
+      for (VariableIndex arg : node->args)
+        recompute_value(arg);
+    }
+    xs.resize(node->arity());
+    unsigned ai = 0;
+    for (VariableIndex arg : node->args) {
+      xs[ai] = &nfxs[arg];
+      ++ai;
+    }
+    ai = 0;
+    for (VariableIndex arg : node->args) {
+      if (needs_derivative[arg]) {
+        allocate_gradient(arg, grad_view);
+        node->backward(xs, nfxs[i], ndEdfs[i], ai, ndEdfs[arg]);
+      }
+      ++ai;
+    }
+
+    if (is_parameter_node[i]) {
+      // the value of a parameter node is the parameters themselves, which nodes
+      // before it may still read, so direct updates wait for the end of the pass
+      if (cg.direct_update_scale != 0) continue;
+      update_parameters(VariableIndex(i), ndEdfs[i]);
+    }
+
+    // the root gradient is the caller's scalar, not a pool buffer
+    if (i + 1 < (int)num_nodes) {
+      dEdf_pool.release(ndEdfs[i].v, ndEdfs[i].d.size() * sizeof(cnn::real));
+      ndEdfs[i].v = nullptr;
+    }
+  }
+  if (recompute)
+    release_recomputed(0, seg_last);
+  if (cg.direct_update_scale != 0) {
+    for (VariableIndex i : cg.parameter_nodes)
+      if (i < num_nodes && ndEdfs[i].v != nullptr)
+        update_parameters(i, ndEdfs[i]);
+  }
+}
+
+void SimpleExecutionEngine::recompute_value(VariableIndex i) {
+  if (fx_live[i]) return;
+  // depth first over the recycled arguments, without recursion as the chain of
+  // them may be as long as the graph
+  vector<VariableIndex> todo(1, i);
+  vector<const Tensor*> xs;
+  while (!todo.empty()) {
+    const VariableIndex j = todo.back();
+    if (fx_live[j]) {
+      todo.pop_back();
+      continue;
+    }
+    const Node* node = cg.nodes[j];
+    bool ready = true;
+    for (VariableIndex arg : node->args) {
+      if (!fx_live[arg]) {
+        todo.push_back(arg);
+        ready = false;
+      }
+    }
+    if (!ready) continue;
+    todo.pop_back();
+
+    xs.resize(node->arity());
+    unsigned ai = 0;
+    for (VariableIndex arg : node->args)
+      xs[ai++] = &nfxs[arg];
+    void* buf = nullptr;
+    const int view = forward_view(j);
+    if (view >= 0) {
+      nfxs[j].v = nfxs[node->args[0]].v + view;
+    } else {
+      // the auxiliary memory of the node is still there from the forward pass
+      buf = fx_pool.allocate(node->dim.size() * sizeof(cnn::real));
+      nfxs[j].v = static_cast<cnn::real*>(buf);
+      node->forward(xs, nfxs[j]);
+      if (nfxs[j].v != buf) {
+        fx_pool.release(buf, node->dim.size() * sizeof(cnn::real));
+        buf = nullptr;
+      }
+    }
+    fx_recomputed[j] = true;
+    fx_recomputed_buf[j] = buf;
+    fx_live[j] = true;
+  }
+}
+
+void SimpleExecutionEngine::release_recomputed(unsigned from, unsigned to) {
+  for (unsigned j = from; j <= to && j < fx_recomputed.size(); ++j) {
+    if (!fx_recomputed[j]) continue;
+    if (fx_recomputed_buf[j] != nullptr)
+      fx_pool.release(fx_recomputed_buf[j], cg.nodes[j]->dim.size() * sizeof(cnn::real));
+    nfxs[j].v = nullptr;
+    fx_recomputed[j] = false;
+    fx_recomputed_buf[j] = nullptr;
+    fx_live[j] = false;
+  }
+}
+
+// a new ComputationGraph is usually built for every minibatch, so keep the
+// threads alive instead of starting them again for every engine
+static map<unsigned, unique_ptr<WorkStealingThreadPool>> shared_pools;
+static mutex shared_pools_mutex;
+
+static WorkStealingThreadPool& shared_thread_pool(unsigned num_threads) {
+  lock_guard<mutex> lk(shared_pools_mutex);
+  auto& p = shared_pools[num_threads];
+  if (!p) p.reset(new WorkStealingThreadPool(num_threads));
+  return *p;
+}
+
+void FreeThreadPools() {
+  lock_guard<mutex> lk(shared_pools_mutex);
+  shared_pools.clear();  // the destructors join the workers
+}
+
+ParallelExecutionEngine::ParallelExecutionEngine(const ComputationGraph& cg, unsigned num_threads) :
+  ExecutionEngine(cg), min_parallel_nodes(64), num_nodes_evaluated(0), pool(shared_thread_pool(num_threads)), gradient_locks(256) {}
+
+void ParallelExecutionEngine::set_memory_reuse(t_memory_reuse m) {
+  if (m != no_memory_reuse)
+    throw std::invalid_argument("ParallelExecutionEngine does not recycle memory, use SimpleExecutionEngine for set_memory_reuse");
+}
+
+void ParallelExecutionEngine::invalidate() {
+  num_nodes_evaluated = 0;
+}
+
+const Tensor& ParallelExecutionEngine::forward() {
+  const VariableIndex node_max_index = (VariableIndex)(cg.nodes.size() - 1);
+  return forward(node_max_index);
+}
+
+const Tensor& ParallelExecutionEngine::forward(VariableIndex i) {
+  invalidate();
+  return incremental_forward(i);
+}
+
+void ParallelExecutionEngine::set_value(const Tensor& t, VariableIndex i) {
+  assert(i < cg.nodes.size());
+  if (i >= num_nodes_evaluated) {
+    cerr << " this is only for adapting parameters. need to precompute node using forward or incremental forward before calling this function" << endl;
+    abort();
+  }
+  nfxs[i] = t;
+}
+
+const Tensor& ParallelExecutionEngine::get_value(VariableIndex i) {
+  assert(i < cg.nodes.size());
+  if (i >= num_nodes_evaluated) {
+    incremental_forward();
+  }
+  return nfxs[i];
+}
+
+const Tensor& ParallelExecutionEngine::get_error(VariableIndex i) {
+  assert(i < cg.nodes.size());
+  if (ndEdfs.size() != cg.nodes.size()) {
+    cerr << "need to run backward before calling this function" << endl;
+    abort();
+  }
+  return ndEdfs[i];
+}
+
+void ParallelExecutionEngine::set_last_node_evaluated(VariableIndex idx) {
+  num_nodes_evaluated = idx;
+}
+
+const Tensor& ParallelExecutionEngine::incremental_forward() {
+  const VariableIndex node_max_index = (VariableIndex)(cg.nodes.size() - 1);
+  return incremental_forward(node_max_index);
+}
+
+void ParallelExecutionEngine::checkpoint(GraphCheckpoint& c) const {
+  c.num_nodes_evaluated = num_nodes_evaluated;
+  c.fx_generation = fx_generation;
+  c.fx_mark = fxs->mark();
+}
+
+void ParallelExecutionEngine::rollback(const GraphCheckpoint& c) {
+  if (c.fx_generation == fx_generation && num_nodes_evaluated >= c.num_nodes_evaluated) {
+    fxs->rewind(c.fx_mark);
+    num_nodes_evaluated = c.num_nodes_evaluated;
+  } else if (num_nodes_evaluated > c.num_nodes) {
+    num_nodes_evaluated = c.num_nodes;
+  }
+  if (nfxs.size() > (unsigned)num_nodes_evaluated)
+    nfxs.resize(num_nodes_evaluated);
+}
+
+void ParallelExecutionEngine::run_wavefront(unsigned from, unsigned to, bool reverse, const function<void(unsigned)>& task) {
+  const unsigned n = to - from;
+  if (n < min_parallel_nodes || pool.size() < 2) {
+    if (reverse) {
+      for (unsigned k = to; k-- > from; ) task(k);
+    } else {
+      for (unsigned k = from; k < to; ++k) task(k);
+    }
+    return;
+  }
+
+  // edges go from a node to the nodes that may run once it is done
+  vector<vector<unsigned>> successors(n);
+  unique_ptr<atomic<unsigned>[]> pending(new atomic<unsigned>[n]);
+  for (unsigned k = 0; k < n; ++k) pending[k] = 0;
+  for (unsigned k = from; k < to; ++k) {
+    for (VariableIndex arg : cg.nodes[k]->args) {
+      if (arg < from) continue;
+      if (reverse) {
+        successors[k - from].push_back(arg - from);
+        ++pending[arg - from];
+      } else {
+        successors[arg - from].push_back(k - from);
+        ++pending[k - from];
+      }
+    }
+  }
+  vector<unsigned> ready;
+  for (unsigned k = 0; k < n; ++k)
+    if (pending[k] == 0) ready.push_back(k);
+
+  // the workers use the pools and random number generator of the calling thread
+  const ThreadState caller = ThreadState::current();
+  pool.run(ready, n, [&](unsigned k, unsigned worker) {
+    if (worker != 0) caller.make_current();
+    task(from + k);
+    for (unsigned s : successors[k])
+      if (--pending[s] == 0)
+        pool.push(worker, s);
+  });
+}
+
+const Tensor& ParallelExecutionEngine::incremental_forward(VariableIndex i) {
+  assert(i < cg.nodes.size());
+
+  // free any old memory if this is a new HG
+  if (num_nodes_evaluated == 0) {
+    fxs->free();
+    ++fx_generation;
+  }
+
+  if (i >= num_nodes_evaluated) {
+    const unsigned from = num_nodes_evaluated;
+    nfxs.resize(i + 1);
+
+    // the memory pool is not thread safe, so allocate everything up front
+    // views get their value once their argument is done, as nodes such as
+    // parameters and inputs only set theirs in forward
+    vector<int> view(i + 1 - from);
+    for (unsigned k = from; k <= i; ++k) {
+      const Node* node = cg.nodes[k];
+      nfxs[k].d = node->dim;
+      nfxs[k].m_device_id = device_id;
+      view[k - from] = forward_view(VariableIndex(k));
+      if (view[k - from] >= 0)
+        continue;
+      nfxs[k].v = static_cast<cnn::real*>(fxs->allocate(node->dim.size() * sizeof(cnn::real)));
+      if (nfxs[k].v == nullptr) {
+        cerr << "no more memory space for forward computation. requested " << node->dim.size() << endl;
+        cerr << "out of memory\n";
+        abort();
+      }
+      void* aux_mem = nullptr;
+      size_t aux_size = node->aux_storage_size();
+      if (aux_size) {
+        aux_mem = fxs->allocate(aux_size);
+        if (!aux_mem) {
+          cerr << "no more memory space for auxiliary memory for forward computation. requested " << aux_size << endl;
+          cerr << "aux out of memory\n";
+          abort();
+        }
+      }
+      node->aux_mem = aux_mem;
+    }
+
+    run_wavefront(from, i + 1, false, [&](unsigned k) {
+      const Node* node = cg.nodes[k];
+      if (view[k - from] >= 0) {
+        nfxs[k].v = nfxs[node->args[0]].v + view[k - from];
+        return;
+      }
+      vector<const Tensor*> xs(node->arity());
+      unsigned ai = 0;
+      for (VariableIndex arg : node->args) {
+        xs[ai] = &nfxs[arg];
+        ++ai;
+      }
+      if (node->is_thread_safe()) {
+        node->forward(xs, nfxs[k]);
+      } else {
+        lock_guard<mutex> lk(serial_mutex);
+        node->forward(xs, nfxs[k]);
+      }
+    });
+    num_nodes_evaluated = i + 1;
+  }
+  return nfxs[i];
+}
+
+void ParallelExecutionEngine::backward(cnn::real * kScalarInit) {
+  assert(nfxs.size() == cg.nodes.size());
+  backward((VariableIndex)(cg.nodes.size() - 1), kScalarInit);
+}
+
+void ParallelExecutionEngine::backward(VariableIndex from_where, cnn::real * kScalarInit) {
+  assert(from_where+1 <= nfxs.size());
+  assert(from_where+1 <= cg.nodes.size());
+  if (nfxs[from_where].d.size() != 1) {
+    cerr << "backward() called on non-scalar node.\n";
+    abort();
+  }
+
+  const unsigned num_nodes = from_where+1;
+
+  // see SimpleExecutionEngine::backward
+  vector<bool> needs_derivative(num_nodes, false);
+  for (auto i : cg.parameter_nodes)
+    needs_derivative[i] = true;
+  for (unsigned ni = 0; ni < num_nodes; ++ni) {
+    bool nd = needs_derivative[ni];
+    for (auto arg : cg.nodes[ni]->args)
+      nd |= needs_derivative[arg];
+    needs_derivative[ni] = nd;
+  }
+  const vector<int> grad_view = gradient_views(num_nodes, needs_derivative);
+  // consumers of a view write to the gradient of the node it is a view of, and lock that
+  vector<VariableIndex> grad_owner(num_nodes);
+
+  ndEdfs.resize(num_nodes);
+  dEdfs->free();
+  for (unsigned i = 0; i < num_nodes; ++i) {
+    const auto dim = nfxs[i].d;
+    ndEdfs[i].d = dim;
+    ndEdfs[i].m_device_id = device_id;
+    grad_owner[i] = i;
+    if (grad_view[i] >= 0) {
+      VariableIndex arg = cg.nodes[i]->args[0];
+      ndEdfs[i].v = ndEdfs[arg].v + grad_view[i];
+      grad_owner[i] = grad_owner[arg];
+    } else {
+      ndEdfs[i].v = static_cast<cnn::real*>(dEdfs->allocate(dim.size() * sizeof(cnn::real)));
+    }
+    assert(ndEdfs[i].v);
+  }
+  dEdfs->zero_allocated_memory();
+  // initialize dE/dE = 1
+  if (kScalarInit == nullptr)
+    ndEdfs.back().v = kSCALAR_ONE;
+  else
+    ndEdfs.back().v = kScalarInit;
+
+  // a node runs after all of its consumers, so its gradient is complete; consumers
+  // that run at the same time accumulate into a shared argument under its lock
+  run_wavefront(0, num_nodes, true, [&](unsigned i) {
+    if (grad_view[i] >= 0) return;
+    const Node* node = cg.nodes[i];
+    vector<const Tensor*> xs(node->arity());
+    unsigned ai = 0;
+    for (VariableIndex arg : node->args) {
+      xs[ai] = &nfxs[arg];
+      ++ai;
+    }
+    ai = 0;
+    for (VariableIndex arg : node->args) {
+      if (needs_derivative[arg]) {
+        lock_guard<mutex> lk(gradient_locks[grad_owner[arg] % gradient_locks.size()]);
+        node->backward(xs, nfxs[i], ndEdfs[i], ai, ndEdfs[arg]);
+      }
+      ++ai;
+    }
+  });
+
+  // accumulate gradients into parameters
+  for (VariableIndex i : cg.parameter_nodes)
+    update_parameters(i, ndEdfs[i]);
 }
 
 } // namespace cnn
@@ -2,6 +2,9 @@
 #define CNN_EXEC_H
 
 #include "cnn/cnn.h"
+#include "cnn/thread-pool.h"
+
+#include <mutex>
 
 namespace cnn {
 
@@ -20,9 +23,27 @@ class ExecutionEngine {
   virtual const Tensor& get_error(VariableIndex i) = 0; 
   virtual void backward(cnn::real * kScalarInit = nullptr) = 0;
   virtual void backward(VariableIndex i, cnn::real * kScalarInit = nullptr) = 0;
+  virtual void set_memory_reuse(t_memory_reuse m) { memory_reuse = m; }
+  // records the evaluation state in c, see ComputationGraph::checkpoint()
+  virtual void checkpoint(GraphCheckpoint& c) const = 0;
+  // forgets the values of the nodes from c.num_nodes on and, if possible,
+  // gives their memory back to fxs
+  virtual void rollback(const GraphCheckpoint& c) = 0;
  protected:
-  explicit ExecutionEngine(const ComputationGraph& cg) : cg(cg) {}
+  explicit ExecutionEngine(const ComputationGraph& cg) : cg(cg), memory_reuse(no_memory_reuse), fx_generation(0) {}
+  // view_offset() of each node that is a view, -1 for the others
+  int forward_view(VariableIndex i) const;
+  // for each of the first num_nodes nodes, the offset of its gradient in the gradient
+  // of its first argument if it is a view whose gradient may alias that range, -1
+  // otherwise. this is the case if the argument needs a derivative and the view is
+  // not the root, whose gradient is given by the caller
+  std::vector<int> gradient_views(unsigned num_nodes, const std::vector<bool>& needs_derivative) const;
+  // hands the gradient g of parameter node i to its parameters, or applies it to their
+  // values right away, see ComputationGraph::set_direct_update
+  void update_parameters(VariableIndex i, const Tensor& g) const;
   const ComputationGraph& cg;
+  t_memory_reuse memory_reuse;
+  unsigned long fx_generation;  // incremented whenever fxs is freed for a new forward pass
 };
 
 class SimpleExecutionEngine : public ExecutionEngine {
@@ -44,12 +65,83 @@ public:
   /// settting this to nullptr, corresponding o use *kScalarInit = 1;
   void backward(cnn::real * kScalarInit = nullptr) override;
   void backward(VariableIndex i, cnn::real * kScalarInit = nullptr ) override;
+  void checkpoint(GraphCheckpoint& c) const override;
+  void rollback(const GraphCheckpoint& c) override;
+ private:
+  // computes, for every node in [from, to], the last node in that range reading its value
+  void plan_forward_reuse(VariableIndex from, VariableIndex to);
+  // called after node i has been evaluated into the buffer buf
+  void recycle_forward_buffers(VariableIndex i, void* buf);
+  void check_value_available(VariableIndex i) const;
+  void backward_with_reuse(unsigned num_nodes, const std::vector<bool>& needs_derivative, const std::vector<int>& grad_view);
+  // allocates the gradient of node i if it has none yet; the gradient of a view is
+  // the range of the gradient of its argument
+  void allocate_gradient(VariableIndex i, const std::vector<int>& grad_view);
+  // recompute_values: evaluates node i again, and the nodes it depends on, if their
+  // values have been recycled
+  void recompute_value(VariableIndex i);
+  // gives back the values recomputed for the nodes in [from, to]
+  void release_recomputed(unsigned from, unsigned to);
+
+  std::vector<Tensor> nfxs;
+  std::vector<Tensor> ndEdfs;
+  VariableIndex num_nodes_evaluated;
+
+  RecyclingMemoryPool<ALIGN> fx_pool;
+  RecyclingMemoryPool<ALIGN> dEdf_pool;
+  std::vector<VariableIndex> fx_owner;  // node whose buffer holds the value of each node
+  std::vector<int> fx_last_use;         // per buffer owner: last reader, -1 if the value is kept
+  bool values_recycled = false;
+  std::vector<bool> fx_live;            // in backward with recompute_values: whether each value is available
+  std::vector<bool> fx_recomputed;      // whether each value has been evaluated again in backward
+  std::vector<void*> fx_recomputed_buf; // the buffer it was evaluated into, nullptr for views
+};
+
+// evaluates independent nodes concurrently. a node is scheduled on a
+// WorkStealingThreadPool as soon as all of its arguments (for forward) or all of
+// its consumers (for backward) are done, so branches such as the per-utterance
+// attention or the two directions of a bidirectional encoder run in parallel.
+// memory for all values and gradients is allocated before the workers start,
+// and set_memory_reuse throws for anything but no_memory_reuse.
+class ParallelExecutionEngine : public ExecutionEngine {
+  friend class ComputationGraph;
+public:
+  ParallelExecutionEngine(const ComputationGraph& cg, unsigned num_threads);
+  void invalidate() override;
+  void set_memory_reuse(t_memory_reuse m) override;
+  const Tensor& forward() override;
+  const Tensor& forward(VariableIndex i) override;
+  const Tensor& incremental_forward() override;
+  const Tensor& incremental_forward(VariableIndex i) override;
+  void set_last_node_evaluated(VariableIndex i) override;
+  void  set_value(const Tensor& t, VariableIndex i) override;
+  const Tensor& get_value(VariableIndex i) override;
+  const Tensor& get_error(VariableIndex i) override;
+  void backward(cnn::real * kScalarInit = nullptr) override;
+  void backward(VariableIndex i, cnn::real * kScalarInit = nullptr) override;
+  void checkpoint(GraphCheckpoint& c) const override;
+  void rollback(const GraphCheckpoint& c) override;
+
+  /// graphs (or increments) with fewer nodes than this are evaluated on the calling thread
+  unsigned min_parallel_nodes;
+
  private:
+  // runs task(node) for every node in [from, to) once all of its arguments in that
+  // range are done, or, if reverse is set, once all of its consumers are done
+  void run_wavefront(unsigned from, unsigned to, bool reverse, const std::function<void(unsigned)>& task);
+
   std::vector<Tensor> nfxs;
   std::vector<Tensor> ndEdfs;
   VariableIndex num_nodes_evaluated;
+  WorkStealingThreadPool& pool;          // shared by all graphs using the same number of threads
+  std::mutex serial_mutex;                 // for nodes that are not thread safe
+  std::vector<std::mutex> gradient_locks;  // striped over the nodes whose gradients are accumulated
 };
 
+// joins the threads of the pools that ParallelExecutionEngines share; no such
+// engine may be in use. Free() calls it
+void FreeThreadPools();
+
 } // namespace cnn
 
 #endif
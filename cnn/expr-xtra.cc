@@ -83,15 +83,14 @@ vector<Expression> embedding(unsigned & slen, const vector<vector<int>>& source,
     Expression i_x_t;
 
     for (unsigned int t = 0; t < slen; ++t) {
-        vector<Expression> vm;
+        /// one gather per time step; finished utterances get zero columns
+        vector<unsigned> idx(nutt, LookupColumnsNode::NO_INDEX);
         for (size_t k = 0; k < nutt; k++)
         {
             if (source[k].size() > t)
-                vm.push_back(lookup(cg, p_cs, source[k][t]));
-            else
-                vm.push_back(input(cg, { feat_dim }, &zero));
+                idx[k] = source[k][t];
         }
-        i_x_t = concatenate_cols(vm);
+        i_x_t = lookup_cols(cg, p_cs, idx);
         source_embeddings.push_back(i_x_t);
     }
 
@@ -119,7 +118,7 @@ vector<Expression> embedding(unsigned & slen, const vector<vector<int>>& source,
         vector<unsigned> idx; 
         for (size_t k = 0; k < nutt; k++)
             idx.push_back(source[k][t]);
-        Expression i_x_t = lookup(cg, p_cs, idx);
+        Expression i_x_t = lookup_cols(cg, p_cs, idx);
         source_embeddings.push_back(i_x_t);
     }
 
@@ -140,11 +139,8 @@ vector<Expression> embedding_spkfirst(const vector<vector<int>>& source, Computa
 
     for (size_t k = 0; k < nutt; k++)
     {
-        vector<Expression> vm;
-        for (int t = 0; t < source[k].size(); ++t) {
-            vm.push_back(lookup(cg, p_cs, source[k][t]));
-        }
-        source_embeddings.push_back(concatenate_cols(vm));
+        vector<unsigned> idx(source[k].begin(), source[k].end());
+        source_embeddings.push_back(lookup_cols(cg, p_cs, idx));
     }
 
     return source_embeddings;
@@ -283,6 +279,9 @@ bool similar_length(const vector<vector<int>>& source)
 }
 
 /// compute attention weights
+/// on CPU the scores, the softmax and the context vector of each utterance are
+/// computed by one MLPAttention node, which takes its keys and its query as
+/// columns of src and of Wa * h_tm1 instead of copies of them
 vector<Expression> attention_to_source(vector<Expression> & v_src, const vector<unsigned>& v_slen,
     Expression& i_va, // to get attention weight
     Expression& i_Wa, // for target side transformation to alignment space
@@ -290,15 +289,11 @@ vector<Expression> attention_to_source(vector<Expression> & v_src, const vector<
     Expression& src, 
     unsigned a_dim, unsigned nutt, vector<Expression>& v_wgt, cnn::real fscale )
 {
-    Expression i_c_t;
-    Expression i_e_t;
-    int slen = 0;
-    vector<Expression> i_wah_rep;
-
-    for (auto p : v_slen)
-        slen += p;
-
     Expression i_wah = i_Wa * i_h_tm1;  /// [d nutt]
+
+    vector<Expression> v_input;
+#if HAVE_CUDA
+    vector<Expression> i_wah_rep;
     int stt = 0; 
     for (size_t k = 0; k < nutt; k++)
     {
@@ -307,7 +302,6 @@ vector<Expression> attention_to_source(vector<Expression> & v_src, const vector<
         stt ++;
     }
 
-    vector<Expression> v_input;
     int istt = 0;
     for (size_t k = 0; k < nutt; k++)
     {
@@ -323,6 +317,18 @@ vector<Expression> attention_to_source(vector<Expression> & v_src, const vector<
 
         istt += v_slen[k];
     }
+#else
+    unsigned istt = 0;
+    for (size_t k = 0; k < nutt; k++)
+    {
+        unsigned d = v_src[k].pg->nodes[v_src[k].i]->dim.rows();
+        Expression i_att = mlp_attention(src, i_wah, i_va, v_src[k], istt, v_slen[k], k, fscale);  /// [D + v_slen[k]]
+        v_wgt.push_back(pickrange(i_att, d, d + v_slen[k]));
+        v_input.push_back(pickrange(i_att, 0, d));
+
+        istt += v_slen[k];
+    }
+#endif
 
     return v_input;
 }
@@ -557,6 +563,16 @@ vector<Expression> convert_to_vector(Expression & in, unsigned dim, unsigned nut
     return v_d;
 }
 
+Expression select_cols(const Expression& x, const vector<unsigned>& cols)
+{
+    /// x times a one-hot selection matrix; a beam has few columns
+    unsigned ncols = x.pg->nodes[x.i]->dim.cols();
+    vector<cnn::real> sel(ncols * cols.size(), 0);
+    for (size_t k = 0; k < cols.size(); k++)
+        sel[IDX2C(cols[k], k, ncols)] = 1;
+    return x * input(*x.pg, { ncols, (unsigned)cols.size() }, sel);
+}
+
 /// use key to find value, return a vector with element for each utterance
 vector<Expression> attention_weight(const vector<unsigned>& v_slen, const Expression& src_key, Expression i_va, Expression i_Wa,
     Expression i_h_tm1, unsigned a_dim, unsigned nutt)
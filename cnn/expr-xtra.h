@@ -7,6 +7,7 @@
 #include "cnn/rnn.h"
 #include "cnn/dict.h"
 #include "cnn/expr.h"
+#include "cnn/param-nodes.h"
 #include <algorithm>
 #include <map>
 
@@ -98,15 +99,13 @@ std::vector<Expression> forward_directional(unsigned & slen, const std::vector<s
     Expression i_x_t;
 
     for (int t = 0; t < slen; ++t) {
-        vector<Expression> vm;
+        vector<unsigned> idx(nutt, LookupColumnsNode::NO_INDEX);
         for (size_t k = 0; k < nutt; k++)
         {
             if (source[k].size() > t)
-                vm.push_back(lookup(cg, p_cs, source[k][t]));
-            else
-                vm.push_back(input(cg, { feat_dim }, &zero));
+                idx[k] = source[k][t];
         }
-        i_x_t = concatenate_cols(vm);
+        i_x_t = lookup_cols(cg, p_cs, idx);
         src_fwd[t] = encoder_fwd.add_input(i_x_t);
     }
 
@@ -207,7 +206,6 @@ vector<Expression> backward_directional(unsigned & slen, const vector<vector<int
         vlen.push_back(p.size());
     }
 
-    Expression e_zero = input(cg, { feat_dim }, &zero);
     vector<Expression> v_h_tm1;
     std::vector<Expression> src_bwd(slen);
 
@@ -218,24 +216,19 @@ vector<Expression> backward_directional(unsigned & slen, const vector<vector<int
 
     for (int t = slen - 1; t >= 0; --t) {
 
-        vector<Expression> vm;
+        vector<unsigned> idx(nutt, LookupColumnsNode::NO_INDEX);
         vector<bool> vmask(nutt, true);
 
         for (size_t k = 0; k < nutt; k++)
         {
             int j = vlen[k] - t - 1;
             if (j >= 0)
-            {
-                vm.push_back(lookup(cg, p_cs, source[k][vlen[k] - 1 - j]));
-            }
+                idx[k] = source[k][vlen[k] - 1 - j];
             else
-            {
-                vm.push_back(e_zero);
                 vmask[k] = false;
-            }
         }
 
-        Expression i_x_t = concatenate_cols(vm);
+        Expression i_x_t = lookup_cols(cg, p_cs, idx);
 
 
         src_bwd[t] = encoder_bwd.add_input(v_h_tm1, i_x_t);
@@ -368,6 +361,10 @@ Expression bidirectional(unsigned & slen, const vector<vector<int>>& source, Com
 
 vector<Expression> convert_to_vector(Expression & in, unsigned dim, unsigned nutt);
 
+/// the columns cols of x, in that order and possibly repeated, e.g. to
+/// reorder the states of a beam by back-pointers
+Expression select_cols(const Expression& x, const vector<unsigned>& cols);
+
 /** attention 
 */
 vector<Expression> attention_to_source(vector<Expression> & v_src, const vector<unsigned>& v_slen,
@@ -4,6 +4,7 @@
 
 #include "cnn/nodes.h"
 #include "cnn/conv.h"
+#include "cnn/rnn-nodes.h"
 
 namespace cnn { namespace expr {
 
@@ -22,6 +23,10 @@ Expression const_lookup(ComputationGraph& g, LookupParameters* p, unsigned index
 Expression const_lookup(ComputationGraph& g, LookupParameters* p, const unsigned* pindex) { return Expression(&g, g.add_const_lookup(p, pindex)); }
 Expression const_lookup(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>& indices) { return Expression(&g, g.add_const_lookup(p, indices)); }
 Expression const_lookup(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>* pindices) { return Expression(&g, g.add_const_lookup(p, pindices)); }
+Expression lookup_cols(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>& indices) { return Expression(&g, g.add_lookup_cols(p, indices)); }
+Expression lookup_cols(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>* pindices) { return Expression(&g, g.add_lookup_cols(p, pindices)); }
+Expression const_lookup_cols(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>& indices) { return Expression(&g, g.add_const_lookup_cols(p, indices)); }
+Expression const_lookup_cols(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>* pindices) { return Expression(&g, g.add_const_lookup_cols(p, pindices)); }
 Expression zeroes(ComputationGraph& g, const Dim& d) { return Expression(&g, g.add_function<Zeroes>(d)); }
 
 Expression operator-(const Expression& x) { return Expression(x.pg, x.pg->add_function<Negate>({x.i})); }
@@ -88,9 +93,50 @@ Expression pick(const Expression& x, unsigned v) { return Expression(x.pg, x.pg-
 Expression pick(const Expression& x, unsigned* pv) { return Expression(x.pg, x.pg->add_function<PickElement>({x.i}, pv)); }
 Expression pickrange(const Expression& x, unsigned v, unsigned u) { return Expression(x.pg, x.pg->add_function<PickRange>({ x.i }, v, u)); }
 Expression columnslices(const Expression& x, unsigned row, unsigned start_column, unsigned exclusive_end_column) { return Expression(x.pg, x.pg->add_function<ColumnSlices>({ x.i }, row, start_column, exclusive_end_column)); }
-
-//Expression pickneglogsoftmax(const Expression& x, unsigned v) { return Expression(x.pg, x.pg->add_function<PickNegLogSoftmax>({x.i}, v)); }
-//Expression pickneglogsoftmax(const Expression& x, const std::vector<unsigned> & v) { return Expression(x.pg, x.pg->add_function<PickNegLogSoftmax>({x.i}, v)); }
+Expression select_rows(const Expression& x, const std::vector<unsigned>& rows) { return Expression(x.pg, x.pg->add_function<SelectRows>({ x.i }, rows)); }
+
+Expression pickneglogsoftmax(const Expression& x, unsigned v) { return Expression(x.pg, x.pg->add_function<PickNegLogSoftmax>({x.i}, v)); }
+Expression pickneglogsoftmax(const Expression& x, const std::vector<unsigned>& v) { return Expression(x.pg, x.pg->add_function<PickNegLogSoftmax>({x.i}, v)); }
+Expression pickneglogsoftmax(const Expression& x, const std::vector<unsigned>* pv) { return Expression(x.pg, x.pg->add_function<PickNegLogSoftmax>({x.i}, pv)); }
+Expression hierarchical_softmax_path(const Expression& x, const Expression& nodes, const std::vector<unsigned>& offsets, const std::vector<cnn::real>& signs) { return Expression(x.pg, x.pg->add_function<HierarchicalSoftmaxPath>({x.i, nodes.i}, offsets, signs)); }
+Expression mlp_attention(const Expression& keys, const Expression& queries, const Expression& va, const Expression& values,
+                         unsigned key_start, unsigned slen, unsigned query_col, cnn::real scale) {
+  unsigned a_dim = keys.pg->nodes[keys.i]->dim.rows();
+  return Expression(keys.pg, keys.pg->add_function<MLPAttention>({keys.i, queries.i, va.i, values.i}, a_dim, key_start, slen, query_col, scale));
+}
+
+Expression lstm_cell(const Expression& x, const Expression& h_tm1, const Expression& c_tm1,
+                     const Expression& w_x, const Expression& w_h, const Expression& b,
+                     const Expression& c2i, const Expression& c2o) {
+  return Expression(x.pg, x.pg->add_function<LSTMCell>(std::vector<VariableIndex>({ x.i, h_tm1.i, c_tm1.i, w_x.i, w_h.i, b.i, c2i.i, c2o.i })));
+}
+Expression lstm_cell(const Expression& x, const Expression& w_x, const Expression& b) {
+  return Expression(x.pg, x.pg->add_function<LSTMCell>(std::vector<VariableIndex>({ x.i, w_x.i, b.i })));
+}
+
+Expression gru_cell(const Expression& x, const Expression& h_tm1, const Expression& w_x,
+                    const Expression& w_h, const Expression& h2h, const Expression& b) {
+  return Expression(x.pg, x.pg->add_function<GRUCell>(std::vector<VariableIndex>({ x.i, h_tm1.i, w_x.i, w_h.i, h2h.i, b.i })));
+}
+Expression gru_cell(const Expression& x, const Expression& w_x, const Expression& b) {
+  return Expression(x.pg, x.pg->add_function<GRUCell>(std::vector<VariableIndex>({ x.i, w_x.i, b.i })));
+}
+
+Expression lstm_cell_projected(const Expression& px, const Expression& h_tm1, const Expression& c_tm1,
+                               const Expression& w_h, const Expression& c2i, const Expression& c2o) {
+  return Expression(px.pg, px.pg->add_function<LSTMCell>({ px.i, h_tm1.i, c_tm1.i, w_h.i, c2i.i, c2o.i }, true));
+}
+Expression lstm_cell_projected(const Expression& px) {
+  return Expression(px.pg, px.pg->add_function<LSTMCell>({ px.i }, true));
+}
+
+Expression gru_cell_projected(const Expression& px, const Expression& h_tm1, const Expression& w_h,
+                              const Expression& h2h) {
+  return Expression(px.pg, px.pg->add_function<GRUCell>({ px.i, h_tm1.i, w_h.i, h2h.i }, true));
+}
+Expression gru_cell_projected(const Expression& px) {
+  return Expression(px.pg, px.pg->add_function<GRUCell>({ px.i }, true));
+}
 
 Expression sum_cols(const Expression& x) { return Expression(x.pg, x.pg->add_function<SumColumns>({x.i})); }
 
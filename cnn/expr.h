@@ -29,6 +29,12 @@ Expression lookup(ComputationGraph& g, LookupParameters* p, const std::vector<un
 Expression lookup(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>* pindices);
 Expression const_lookup(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>& indices);
 Expression const_lookup(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>* pindices);
+// the embeddings of indices as the columns of one {dim, indices.size()} matrix.
+// LookupColumnsNode::NO_INDEX gives a zero column
+Expression lookup_cols(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>& indices);
+Expression lookup_cols(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>* pindices);
+Expression const_lookup_cols(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>& indices);
+Expression const_lookup_cols(ComputationGraph& g, LookupParameters* p, const std::vector<unsigned>* pindices);
 Expression zeroes(ComputationGraph& g, const Dim& d);
 
 Expression operator-(const Expression& x);
@@ -102,6 +108,25 @@ Expression fold_rows(const Expression& x, unsigned nrows=2);
 Expression sum_cols(const Expression& x);
 Expression kmh_ngram(const Expression& x, unsigned n);
 
+// fused recurrent steps, see rnn-nodes.h. the LSTM step stacks the new cell
+// and hidden states column-wise: [c h]
+Expression lstm_cell(const Expression& x, const Expression& h_tm1, const Expression& c_tm1,
+                     const Expression& w_x, const Expression& w_h, const Expression& b,
+                     const Expression& c2i, const Expression& c2o);
+Expression lstm_cell(const Expression& x, const Expression& w_x, const Expression& b);
+// the GRU step returns the new hidden state only
+Expression gru_cell(const Expression& x, const Expression& h_tm1, const Expression& w_x,
+                    const Expression& w_h, const Expression& h2h, const Expression& b);
+Expression gru_cell(const Expression& x, const Expression& w_x, const Expression& b);
+// the same steps on a precomputed input projection px = W_x x + b, e.g. one
+// slice of the projection of a whole sequence
+Expression lstm_cell_projected(const Expression& px, const Expression& h_tm1, const Expression& c_tm1,
+                               const Expression& w_h, const Expression& c2i, const Expression& c2o);
+Expression lstm_cell_projected(const Expression& px);
+Expression gru_cell_projected(const Expression& px, const Expression& h_tm1, const Expression& w_h,
+                              const Expression& h2h);
+Expression gru_cell_projected(const Expression& px);
+
 // Sum the results of multiple batches
 Expression sum_batches(const Expression& x);
 
@@ -110,8 +135,22 @@ Expression pick(const Expression& x, unsigned v);
 Expression pick(const Expression& x, unsigned* pv);
 Expression pickrange(const Expression& x, unsigned v, unsigned u);
 Expression columnslices(const Expression& x, unsigned row, unsigned start_column, unsigned exclusive_end_column);
-//Expression pickneglogsoftmax(const Expression& x, unsigned v);
-//Expression pickneglogsoftmax(const Expression& x, const std::vector<unsigned> & v);
+Expression select_rows(const Expression& x, const std::vector<unsigned>& rows);
+// -log_softmax(x) picked at v[j] in each column j of x, without building the
+// full log_softmax; columns with index PickNegLogSoftmax::NO_INDEX give zero.
+// the columns are the batch, so x must not carry minibatch elements
+Expression pickneglogsoftmax(const Expression& x, unsigned v);
+Expression pickneglogsoftmax(const Expression& x, const std::vector<unsigned>& v);
+// use this if you want to change the values after the graph is constructed
+Expression pickneglogsoftmax(const Expression& x, const std::vector<unsigned>* pv);
+// -log of the probability of a path through a binary tree, one path per
+// column of x; see HierarchicalSoftmaxPath
+Expression hierarchical_softmax_path(const Expression& x, const Expression& nodes, const std::vector<unsigned>& offsets, const std::vector<cnn::real>& signs);
+// MLP attention of column query_col of queries over columns [key_start,
+// key_start + slen) of keys, with values [D x slen]; the result stacks the
+// context vector [D] on top of the attention weights [slen]. see MLPAttention
+Expression mlp_attention(const Expression& keys, const Expression& queries, const Expression& va, const Expression& values,
+                         unsigned key_start, unsigned slen, unsigned query_col, cnn::real scale = 1.0);
 
 namespace detail {
   template <typename F, typename T>
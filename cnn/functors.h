@@ -9,6 +9,7 @@ using namespace std;
 #define CNN_DEVICE_MIN -1.175494351e-38f
 #else
 #include <boost/math/special_functions/digamma.hpp>
+#include "cnn/simd-math.h"
 #define CNN_DEVICE_FUNC
 #define CNN_DEVICE_MIN -1.175494351e-38f
 #endif
@@ -483,12 +484,9 @@ void logsoftmax(int row, int col, const ElemType* a, ElemType* v, const bool isC
             for (int i = 1; i < row; i++)
                 maxV = (maxV > a[IDX2C(i, j, row)]) ? maxV : a[IDX2C(i, j, row)];
 
-            ElemType sum = 0;
+            ElemType logz = maxV + log(cnn::simd::vsum_exp(row, a + IDX2C(0, j, row), maxV));
             for (int i = 0; i < row; i++)
-                sum += exp(v[IDX2C(i, j, row)] = a[IDX2C(i, j, row)] - maxV);
-            sum = log(sum);
-            for (int i = 0; i < row; i++)
-                v[IDX2C(i, j, row)] -= sum;
+                v[IDX2C(i, j, row)] = a[IDX2C(i, j, row)] - logz;
         }
     }
     else
@@ -511,15 +509,10 @@ void softmax(int row, int col, const ElemType* a, ElemType* v, const bool isColW
             for (int i = 1; i < row; i++)
                 maxV = (maxV > a[IDX2C(i, j, row)]) ? maxV : a[IDX2C(i, j, row)];
 
-            ElemType sum = 0;
-            for (int i = 0; i < row; i++)
-                sum += exp(v[IDX2C(i, j, row)] = a[IDX2C(i, j, row)] - maxV);
-            sum = log(sum);
+            ElemType sum = cnn::simd::vexp_sum(row, a + IDX2C(0, j, row), maxV, v + IDX2C(0, j, row));
+            ElemType scale = 1 / sum;
             for (int i = 0; i < row; i++)
-            {
-                ElemType tmp = v[IDX2C(i, j, row)] - sum;
-                v[IDX2C(i, j, row)] = exp(tmp);
-            }
+                v[IDX2C(i, j, row)] *= scale;
         }
     }
     else
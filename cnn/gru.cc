@@ -69,6 +69,7 @@ GRUBuilder::GRUBuilder(unsigned ilayers,
 
 void GRUBuilder::new_graph_impl(ComputationGraph& cg) {
   param_vars.clear();
+  fused_vars.clear();
   for (unsigned i = 0; i < layers; ++i) {
     auto& p = params[i];
 
@@ -89,6 +90,15 @@ void GRUBuilder::new_graph_impl(ComputationGraph& cg) {
 
     vector<Expression> vars = {x2z, h2z, bz, x2r, h2r, br, x2h, h2h, bh};
     param_vars.push_back(vars);
+
+    if (fused_cell) {
+      // stacked once per graph, so each step needs one product for the input
+      // and one for the recurrent projection of all gates
+      Expression i_x = concatenate({ x2z, x2r, x2h });
+      Expression i_h = concatenate({ h2z, h2r });
+      Expression i_b = concatenate({ bz, br, bh });
+      fused_vars.push_back({ i_x, i_h, i_b });
+    }
   }
   set_data_in_parallel(data_in_parallel());
 }
@@ -98,6 +108,9 @@ void GRUBuilder::set_data_in_parallel(int n)
     RNNBuilder::set_data_in_parallel(n);
 
     biases.clear();
+    /// GRUCell adds the biases to every column itself
+    if (fused_cell)
+        return;
     for (unsigned i = 0; i < layers; ++i) {
         const vector<Expression>& vars = param_vars[i];
         Expression bimb = concatenate_cols(vector<Expression>(data_in_parallel(), vars[BZ]));
@@ -132,6 +145,10 @@ Expression GRUBuilder::add_input_impl(int prev, const Expression& x) {
             h_tprev = (prev < 0) ? h0[i] : h[prev][i];
         }
         else { prev_zero = true; }
+        if (fused_cell) {
+            in = ht[i] = fused_step(i, in, prev_zero, h_tprev);
+            continue;
+        }
         // update gate
         Expression zt;
         if (prev_zero)
@@ -190,6 +207,13 @@ Expression GRUBuilder::add_input_impl(int prev, const vector<Expression>& x) {
             h_tprev = (prev < 0) ? h0[i] : h[prev][i];
         }
         else { prev_zero = true; }
+        if (fused_cell) {
+            Expression z = fused_step(i, in, prev_zero, h_tprev);
+            if (i > 0)
+                z = z + x[i];
+            in = ht[i] = z;
+            continue;
+        }
         // update gate
         Expression zt;
         if (prev_zero)
@@ -252,6 +276,13 @@ Expression GRUBuilder::add_input_impl(const std::vector<Expression> & prev_histo
         // prev_zero means that h_tprev should be treated as 0
         bool prev_zero = false;
 
+        if (fused_cell) {
+            if (prev_history.size() > 0)
+                h_tprev = prev_history[i];
+            in = ht[i] = fused_step(i, in, prev_history.size() == 0, h_tprev);
+            continue;
+        }
+
         // update gate
         Expression zt;
         if (prev_history.size() > 0)
@@ -299,6 +330,75 @@ Expression GRUBuilder::add_input_impl(const std::vector<Expression> & prev_histo
     return ht.back();
 }
 
+vector<Expression> GRUBuilder::add_sequence_impl(int prev, const vector<Expression>& xs) {
+    const bool has_initial_state = (h0.size() > 0);
+    const unsigned t0 = h.size();
+    const unsigned nutt = num_columns(xs[0]);
+    h.resize(t0 + xs.size(), vector<Expression>(layers));
+
+    vector<Expression> in = xs;
+    for (unsigned i = 0; i < layers; ++i) {
+        const vector<Expression>& vars = param_vars[i];
+        // input projections of all steps at once
+        Expression x = concatenate_cols(in);
+        Expression pz, pr, ph, pall;
+        if (fused_cell) {
+            pall = colwise_add(fused_vars[i][0] * x, fused_vars[i][2]);
+        } else {
+            pz = colwise_add(vars[X2Z] * x, vars[BZ]);
+            pr = colwise_add(vars[X2R] * x, vars[BR]);
+            ph = colwise_add(vars[X2H] * x, vars[BH]);
+        }
+
+        for (unsigned t = 0; t < xs.size(); ++t) {
+            int p = sequence_prev(prev, t0, t);
+            vector<Expression>& ht = h[t0 + t];
+            Expression h_tprev;
+            bool prev_zero = false;
+            if (p >= 0 || has_initial_state)
+                h_tprev = (p < 0) ? h0[i] : h[p][i];
+            else
+                prev_zero = true;
+
+            if (fused_cell) {
+                Expression px = sequence_step(pall, t, nutt);
+                if (prev_zero)
+                    in[t] = ht[i] = gru_cell_projected(px);
+                else
+                    in[t] = ht[i] = gru_cell_projected(px, h_tprev, fused_vars[i][1], vars[H2H]);
+                continue;
+            }
+
+            Expression zt = sequence_step(pz, t, nutt);
+            if (!prev_zero)
+                zt = affine_transform({ zt, vars[H2Z], h_tprev });
+            zt = logistic(zt);
+
+            Expression ct = sequence_step(ph, t, nutt);
+            if (prev_zero) {
+                ct = tanh(ct);
+                in[t] = ht[i] = cwise_multiply(zt, ct);
+            } else {
+                Expression rt = logistic(affine_transform({ sequence_step(pr, t, nutt), vars[H2R], h_tprev }));
+                Expression ght = cwise_multiply(rt, h_tprev);
+                ct = tanh(affine_transform({ ct, vars[H2H], ght }));
+                Expression nwt = cwise_multiply(zt, ct);
+                Expression crt = cwise_multiply(1.f - zt, h_tprev);
+                in[t] = ht[i] = crt + nwt;
+            }
+        }
+    }
+    return in;
+}
+
+Expression GRUBuilder::fused_step(unsigned i, const Expression& in, bool prev_zero, const Expression& h_tprev) {
+    const vector<Expression>& vars = param_vars[i];
+    const vector<Expression>& fvars = fused_vars[i];
+    if (prev_zero)
+        return gru_cell(in, fvars[0], fvars[2]);
+    return gru_cell(in, h_tprev, fvars[0], fvars[1], vars[H2H], fvars[2]);
+}
+
 void GRUBuilder::copy(const RNNBuilder & rnn) {
   const GRUBuilder & rnn_gru = (const GRUBuilder&)rnn;
   assert(params.size() == rnn_gru.params.size());
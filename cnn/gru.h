@@ -18,7 +18,7 @@ struct GRUBuilder : public RNNBuilder {
                       cnn::real iscale = 1.0,
                       string name = "");
   GRUBuilder(const GRUBuilder& ref):
-      RNNBuilder(ref)
+      RNNBuilder(ref), fused_cell(ref.fused_cell)
   {}
 
   void set_data_in_parallel(int n);
@@ -35,6 +35,10 @@ struct GRUBuilder : public RNNBuilder {
   Expression add_input_impl(int prev, const Expression& x) override;
   Expression add_input_impl(int prev, const std::vector<Expression>& x) override;
   Expression add_input_impl(const std::vector<Expression>& prev, const Expression& x) override;
+  std::vector<Expression> add_sequence_impl(int prev, const std::vector<Expression>& xs) override;
+
+  // one layer of one step through GRUCell
+  Expression fused_step(unsigned layer, const Expression& in, bool prev_zero, const Expression& h_tprev);
 
   // first index is time, second is layer
   std::vector<std::vector<Expression>> h;
@@ -43,9 +47,16 @@ struct GRUBuilder : public RNNBuilder {
   // - default to zero matrix input
   std::vector<Expression> h0;
 
+  // stacked [z; r; h] input weights, [z; r] recurrent weights and biases per layer
+  std::vector<std::vector<Expression>> fused_vars;
+
 public:
   unsigned hidden_dim;
   std::vector<std::vector<Expression>> biases;
+
+  // compute each step with one GRUCell node (see rnn-nodes.h). the parameters
+  // are unchanged. set this before new_graph
+  bool fused_cell = false;
 };
 
 } // namespace cnn
@@ -0,0 +1,60 @@
+#include "cnn/hogwild.h"
+#include "cnn/exec.h"
+#include "cnn/init.h"
+
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace cnn {
+
+cnn::real HogwildTrainer::train(unsigned num_examples, const GraphBuilder& build) {
+  if (num_threads == 0)
+    throw std::invalid_argument("HogwildTrainer needs at least one thread");
+#if HAVE_CUDA
+  throw cuda_not_implemented("HogwildTrainer::train");
+#endif
+  const unsigned seed = random_seed ? random_seed : (unsigned)(*rndeng)();
+  const cnn::real step = -eta;
+
+  vector<double> losses(num_threads, 0);
+  exception_ptr error;
+  mutex error_mutex;
+  auto work = [&](unsigned t) {
+    const unsigned first = (unsigned)((unsigned long)num_examples * t / num_threads);
+    const unsigned last = (unsigned)((unsigned long)num_examples * (t + 1) / num_threads);
+    try {
+      InitializeThread(seed + t, pool_size);
+      ComputationGraph cg;
+      cg.set_direct_update(step);
+      for (unsigned i = first; i < last; ++i) {
+        cg.clear();
+        build(cg, i, t);
+        if (dynamic_cast<ParallelExecutionEngine*>(cg.ee))
+          throw std::invalid_argument("HogwildTrainer cannot run graphs on a ParallelExecutionEngine, whose thread pool is shared");
+        losses[t] += as_scalar(cg.forward());
+        cg.backward();
+      }
+    } catch (...) {
+      lock_guard<mutex> lk(error_mutex);
+      if (!error) error = current_exception();
+    }
+    FreeThread();
+  };
+
+  vector<thread> threads;
+  for (unsigned t = 0; t < num_threads; ++t)
+    threads.push_back(thread(work, t));
+  for (auto& th : threads) th.join();
+  if (error) rethrow_exception(error);
+
+  double loss = 0;
+  for (double l : losses) loss += l;
+  return (cnn::real)loss;
+}
+
+} // namespace cnn
@@ -0,0 +1,53 @@
+#ifndef CNN_HOGWILD_H_
+#define CNN_HOGWILD_H_
+
+#include <functional>
+#include "cnn/cnn.h"
+
+namespace cnn {
+
+// trains one model with several threads at once and without locks, as in
+// Hogwild! (Niu et al., 2011). every thread has memory pools and a random number
+// generator of its own, builds the graph of one example of its shard at a time,
+// and its backward pass takes a plain sgd step by adding -eta times the gradient
+// of each parameter straight to the shared values (see
+// ComputationGraph::set_direct_update). steps of different threads may overwrite
+// each other, which is rare when they are sparse, e.g. rows of lookup parameters.
+// there is no weight decay or gradient clipping, and the model's gradients are
+// not used. CPU only, and the graphs must keep the default execution engine:
+// a ParallelExecutionEngine shares one thread pool among all graphs with the
+// same number of threads, which is not reentrant, so train rejects it
+class HogwildTrainer {
+ public:
+  // build(cg, example, thread) builds the graph of an example on cg, the last node
+  // of which is the loss. thread is in [0, num_threads); the builders of each
+  // thread must be its own, e.g. copies of an RNNBuilder, which share its parameters
+  typedef std::function<void(ComputationGraph& cg, unsigned example, unsigned thread)> GraphBuilder;
+
+  explicit HogwildTrainer(unsigned num_threads, cnn::real e0 = 0.1) :
+    eta0(e0), eta(e0), eta_decay(), epoch(), num_threads(num_threads), random_seed(0),
+    pool_size(64UL * (1UL << 20)) {}
+
+  // one pass over the examples [0, num_examples), split into a contiguous shard per
+  // thread, so any shuffling is up to build. returns the sum of the losses
+  cnn::real train(unsigned num_examples, const GraphBuilder& build);
+
+  void update_epoch(cnn::real r = 1) {
+    epoch += r;
+    eta = eta0 / (1 + epoch * eta_decay);
+  }
+
+  // learning rates
+  cnn::real eta0;
+  cnn::real eta;
+  cnn::real eta_decay;
+  cnn::real epoch;
+
+  unsigned num_threads;
+  unsigned random_seed;     // thread t seeds its generator with random_seed + t, 0 to draw it from rndeng
+  unsigned long pool_size;  // initial size of the memory pools of each thread
+};
+
+} // namespace cnn
+
+#endif
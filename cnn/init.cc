@@ -1,10 +1,12 @@
 #include "cnn/init.h"
 #include "cnn/aligned-mem-pool.h"
 #include "cnn/cnn.h"
+#include "cnn/exec.h"
 #include "cnn/model.h"
 #include <iostream>
 #include <random>
 #include <cmath>
+#include <stdexcept>
 
 #if HAVE_CUDA
 #include "cnn/cuda.h"
@@ -15,12 +17,12 @@ using namespace std;
 
 namespace cnn {
     
-    AlignedMemoryPool<ALIGN>* fxs = nullptr;
-    AlignedMemoryPool<ALIGN>* dEdfs = nullptr;
-    AlignedMemoryPool<ALIGN>* mem_nodes= nullptr;   /// for nodes allocation/delocation. operation of new/delete of each node has been overwritten to use this memory pool for speed-up
+    thread_local AlignedMemoryPool<ALIGN>* fxs = nullptr;
+    thread_local AlignedMemoryPool<ALIGN>* dEdfs = nullptr;
+    thread_local AlignedMemoryPool<ALIGN>* mem_nodes= nullptr;   /// for nodes allocation/delocation. operation of new/delete of each node has been overwritten to use this memory pool for speed-up
     AlignedMemoryPool<ALIGN>* glb_temp_working_mem = nullptr;
     AlignedMemoryPool<ALIGN>* glb_temp_lookup_gradient_value_mem = nullptr; /// this saves gradient on those sparse lookup table parameters that have non-zero gradiens. these values and gradients are temporary
-    mt19937* rndeng = nullptr;
+    thread_local mt19937* rndeng = nullptr;
     cnn::real* glb_gpu_accessible_host_mem = nullptr;
 
     char* getCmdOption(char ** begin, char ** end, const std::string & option)
@@ -78,8 +80,8 @@ namespace cnn {
         rndeng = new mt19937(random_seed);
 
         cerr << "Allocating memory...\n";
-		unsigned long num_mb = 512UL;
-        mem_nodes = new AlignedMemoryPool<ALIGN>(512UL * (1UL << 20), true);
+        /// all pools grow in chunks on demand, so these are only the initial reservations
+        mem_nodes = new AlignedMemoryPool<ALIGN>(64UL * (1UL << 20), true);
         glb_temp_working_mem = new AlignedMemoryPool<ALIGN>(1UL << 12); /// save gradient norms
         glb_temp_lookup_gradient_value_mem = new AlignedMemoryPool<ALIGN>(1UL << 25);
 #ifdef HAVE_CUDA
@@ -89,17 +91,17 @@ namespace cnn {
 
         if (demo)
         {
-            fxs = new AlignedMemoryPool<ALIGN>(512UL * (1UL << 20));
-            dEdfs = new AlignedMemoryPool<ALIGN>(512UL * (1UL << 20));
+            fxs = new AlignedMemoryPool<ALIGN>(64UL * (1UL << 20));
+            dEdfs = new AlignedMemoryPool<ALIGN>(64UL * (1UL << 20));
         }
         else
         {
 #ifdef SMALL_GPU
-            fxs = new AlignedMemoryPool<ALIGN>(512UL * (1UL << 20));
-            dEdfs = new AlignedMemoryPool<ALIGN>(512UL * (1UL << 20));
+            fxs = new AlignedMemoryPool<ALIGN>(128UL * (1UL << 20));
+            dEdfs = new AlignedMemoryPool<ALIGN>(128UL * (1UL << 20));
 #else
-            fxs = new AlignedMemoryPool<ALIGN>(512 * (1UL << 22)); /// 2G memory
-            dEdfs = new AlignedMemoryPool<ALIGN>(512 * (1UL << 22)); /// 2G memory
+            fxs = new AlignedMemoryPool<ALIGN>(256UL * (1UL << 20));
+            dEdfs = new AlignedMemoryPool<ALIGN>(256UL * (1UL << 20));
 #endif
         }
         cerr << "Done.\n";
@@ -108,6 +110,7 @@ namespace cnn {
   void Free() 
   {
         cerr << "Freeing memory ...\n";
+        FreeThreadPools();
         cnn_mm_free(kSCALAR_MINUSONE);
         cnn_mm_free(kSCALAR_ONE);
         cnn_mm_free(kSCALAR_ZERO);
@@ -127,4 +130,46 @@ namespace cnn {
         cerr << "Done.\n";
   }
 
+  void InitializeThread(unsigned random_seed, unsigned long pool_size)
+  {
+      if (fxs != nullptr)
+          throw std::runtime_error("InitializeThread: the memory pools of this thread already exist");
+      rndeng = new mt19937(random_seed);
+      mem_nodes = new AlignedMemoryPool<ALIGN>(pool_size, true);
+      fxs = new AlignedMemoryPool<ALIGN>(pool_size);
+      dEdfs = new AlignedMemoryPool<ALIGN>(pool_size);
+  }
+
+  void FreeThread()
+  {
+      delete (rndeng);
+      delete (fxs);
+      delete (dEdfs);
+      delete (mem_nodes);
+      rndeng = nullptr;
+      fxs = dEdfs = mem_nodes = nullptr;
+  }
+
+  unsigned long TrimMemoryPools()
+  {
+      unsigned long peak = fxs->high_water_mark() + dEdfs->high_water_mark() + mem_nodes->high_water_mark();
+      fxs->trim();
+      dEdfs->trim();
+      mem_nodes->trim();
+      return peak;
+  }
+
+  ThreadState ThreadState::current()
+  {
+      return ThreadState{ cnn::fxs, cnn::dEdfs, cnn::mem_nodes, cnn::rndeng };
+  }
+
+  void ThreadState::make_current() const
+  {
+      cnn::fxs = fxs;
+      cnn::dEdfs = dEdfs;
+      cnn::mem_nodes = mem_nodes;
+      cnn::rndeng = rndeng;
+  }
+
 } // namespace cnn
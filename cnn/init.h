@@ -8,6 +8,18 @@ namespace cnn {
         unsigned random_seed = 0, bool demo = false);
 
     void Free();
+
+    /// sets up the memory pools and the random number generator of a thread other than
+    /// the one that called Initialize, so that it can build and evaluate graphs of its own.
+    /// the parameters stay shared. call FreeThread before the thread ends
+    void InitializeThread(unsigned random_seed, unsigned long pool_size = 64UL * (1UL << 20));
+
+    void FreeThread();
+
+    /// gives the memory of the calling thread's pools above their peak use since
+    /// the last call back to the system, e.g. after an epoch that had a few
+    /// unusually large graphs. returns that peak in bytes
+    unsigned long TrimMemoryPools();
 } // namespace cnn
 
 #endif
@@ -84,6 +84,7 @@ LSTMBuilder::LSTMBuilder(unsigned ilayers,
 
 void LSTMBuilder::new_graph_impl(ComputationGraph& cg){
   param_vars.clear();
+  fused_vars.clear();
 
   for (unsigned i = 0; i < layers; ++i){
     auto& p = params[i];
@@ -106,6 +107,13 @@ void LSTMBuilder::new_graph_impl(ComputationGraph& cg){
     vector<Expression> vars = {i_x2i, i_h2i, i_c2i, i_bi, i_x2o, i_h2o, i_c2o, i_bo, i_x2c, i_h2c, i_bc};
     param_vars.push_back(vars);
 
+    if (fused_cell) {
+      // stacked once per graph, so each step needs one product for all gates
+      Expression i_x = concatenate({ i_x2i, i_x2c, i_x2o });
+      Expression i_h = concatenate({ i_h2i, i_h2c, i_h2o });
+      Expression i_b = concatenate({ i_bi, i_bc, i_bo });
+      fused_vars.push_back({ i_x, i_h, i_b });
+    }
   }
   set_data_in_parallel(data_in_parallel());
 }
@@ -136,6 +144,9 @@ void LSTMBuilder::set_data_in_parallel(int n)
     RNNBuilder::set_data_in_parallel(n);
 
     biases.clear();
+    /// LSTMCell adds the biases to every column itself
+    if (fused_cell)
+        return;
     for (unsigned i = 0; i < layers; ++i) {
         const vector<Expression>& vars = param_vars[i];
         Expression bimb = concatenate_cols(vector<Expression>(data_in_parallel(), vars[BI]));
@@ -153,12 +164,24 @@ Expression LSTMBuilder::add_input_impl(const vector<Expression>& prev_history, c
     vector<Expression>& ht = h.back();
     vector<Expression>& ct = c.back();
     Expression in = x;
+    // an empty history starts from zero states, like the first step of a sequence
+    if (prev_history.size() > 0 && prev_history.size() != 2 * layers)
+        throw std::invalid_argument("LSTMBuilder::add_input needs c and h of every layer in prev_history");
 
     for (unsigned i = 0; i < layers; ++i) {
         const vector<Expression>& vars = param_vars[i];
         Expression i_h_tm1, i_c_tm1;
-        i_h_tm1 = prev_history[i+layers];
-        i_c_tm1 = prev_history[i];
+        if (prev_history.size() > 0)
+        {
+            i_h_tm1 = prev_history[i + layers];
+            i_c_tm1 = prev_history[i];
+        }
+
+        if (fused_cell)
+        {
+            in = ht[i] = fused_step(i, in, prev_history.size() > 0, i_h_tm1, i_c_tm1, ct[i]);
+            continue;
+        }
 
         // input
         Expression i_ait;
@@ -194,9 +217,9 @@ Expression LSTMBuilder::add_input_impl(const vector<Expression>& prev_history, c
         Expression i_aot;
         Expression bomb = biases[i][2];
         if (prev_history.size() > 0)
-            i_aot = affine_transform({ bomb, vars[X2O], in, vars[C2O], ct[i] });
-        else
             i_aot = affine_transform({ bomb, vars[X2O], in, vars[H2O], i_h_tm1, vars[C2O], ct[i] });
+        else
+            i_aot = affine_transform({ bomb, vars[X2O], in });
 
         Expression i_ot = logistic(i_aot);
         Expression ph_t = tanh(ct[i]);
@@ -229,6 +252,11 @@ Expression LSTMBuilder::add_input_impl(int prev, const Expression& x)
       i_c_tm1 = c[prev][i];
     }
 
+    if (fused_cell) {
+      in = ht[i] = fused_step(i, in, has_prev_state, i_h_tm1, i_c_tm1, ct[i]);
+      continue;
+    }
+
     // input
     Expression i_ait;
     Expression bimb = biases[i][0]; 
@@ -302,6 +330,14 @@ Expression LSTMBuilder::add_input_impl(int prev, const vector<Expression>& x)
             i_c_tm1 = c[prev][i];
         }
 
+        if (fused_cell) {
+            Expression z = fused_step(i, in, has_prev_state, i_h_tm1, i_c_tm1, ct[i]);
+            if (i > 0)
+                z = z + x[i];
+            in = ht[i] = z;
+            continue;
+        }
+
         // input
         Expression i_ait;
         Expression bimb = biases[i][0];
@@ -352,6 +388,103 @@ Expression LSTMBuilder::add_input_impl(int prev, const vector<Expression>& x)
     }
     return ht.back();
 }
+vector<Expression> LSTMBuilder::add_sequence_impl(int prev, const vector<Expression>& xs)
+{
+    const unsigned t0 = h.size();
+    const unsigned nutt = num_columns(xs[0]);
+    h.resize(t0 + xs.size(), vector<Expression>(layers));
+    c.resize(t0 + xs.size(), vector<Expression>(layers));
+
+    vector<Expression> in = xs;
+    for (unsigned i = 0; i < layers; ++i) {
+        const vector<Expression>& vars = param_vars[i];
+        // input projections of all steps at once; only the recurrent
+        // products are left for the steps
+        Expression x = concatenate_cols(in);
+        Expression pi, pc, po, pall;
+        if (fused_cell) {
+            pall = colwise_add(fused_vars[i][0] * x, fused_vars[i][2]);
+        } else {
+            pi = colwise_add(vars[X2I] * x, vars[BI]);
+            pc = colwise_add(vars[X2C] * x, vars[BC]);
+            po = colwise_add(vars[X2O] * x, vars[BO]);
+        }
+
+        for (unsigned t = 0; t < xs.size(); ++t) {
+            int p = sequence_prev(prev, t0, t);
+            vector<Expression>& ht = h[t0 + t];
+            vector<Expression>& ct = c[t0 + t];
+            Expression i_h_tm1, i_c_tm1;
+            bool has_prev_state = (p >= 0 || has_initial_state);
+            if (p < 0) {
+                if (has_initial_state) {
+                    i_h_tm1 = h0[i];
+                    i_c_tm1 = c0[i];
+                }
+            } else {
+                i_h_tm1 = h[p][i];
+                i_c_tm1 = c[p][i];
+            }
+
+            if (fused_cell) {
+                Expression px = sequence_step(pall, t, nutt);
+                Expression cell;
+                if (has_prev_state)
+                    cell = lstm_cell_projected(px, i_h_tm1, i_c_tm1, fused_vars[i][1], vars[C2I], vars[C2O]);
+                else
+                    cell = lstm_cell_projected(px);
+                unsigned hidden_dim = in[t].pg->nodes[cell.i]->dim.rows();
+                ct[i] = columnslices(cell, hidden_dim, 0, nutt);
+                in[t] = ht[i] = columnslices(cell, hidden_dim, nutt, 2 * nutt);
+                continue;
+            }
+
+            Expression i_ait = sequence_step(pi, t, nutt);
+            if (has_prev_state)
+                i_ait = affine_transform({ i_ait, vars[H2I], i_h_tm1, vars[C2I], i_c_tm1 });
+            Expression i_it = logistic(i_ait);
+            Expression i_ft = 1.f - i_it;
+
+            Expression i_awt = sequence_step(pc, t, nutt);
+            if (has_prev_state)
+                i_awt = affine_transform({ i_awt, vars[H2C], i_h_tm1 });
+            Expression i_wt = tanh(i_awt);
+            if (has_prev_state) {
+                Expression i_nwt = cwise_multiply(i_it, i_wt);
+                Expression i_crt = cwise_multiply(i_ft, i_c_tm1);
+                ct[i] = i_crt + i_nwt;
+            } else {
+                ct[i] = cwise_multiply(i_it, i_wt);
+            }
+
+            Expression i_aot = sequence_step(po, t, nutt);
+            if (has_prev_state)
+                i_aot = affine_transform({ i_aot, vars[H2O], i_h_tm1, vars[C2O], ct[i] });
+            Expression i_ot = logistic(i_aot);
+            Expression ph_t = tanh(ct[i]);
+            in[t] = ht[i] = cwise_multiply(i_ot, ph_t);
+        }
+    }
+    return in;
+}
+
+Expression LSTMBuilder::fused_step(unsigned i, const Expression& in, bool has_prev_state,
+                                   const Expression& i_h_tm1, const Expression& i_c_tm1, Expression& ct)
+{
+    const vector<Expression>& vars = param_vars[i];
+    const vector<Expression>& fvars = fused_vars[i];
+    Expression cell;
+    if (has_prev_state)
+        cell = lstm_cell(in, i_h_tm1, i_c_tm1, fvars[0], fvars[1], fvars[2], vars[C2I], vars[C2O]);
+    else
+        cell = lstm_cell(in, fvars[0], fvars[2]);
+    const Dim& d = in.pg->nodes[cell.i]->dim;
+    unsigned hidden_dim = d.rows();
+    unsigned nutt = d.cols() / 2;
+    ct = columnslices(cell, hidden_dim, 0, nutt);
+    return columnslices(cell, hidden_dim, nutt, 2 * nutt);
+}
+
 void LSTMBuilder::copy(const RNNBuilder & rnn) {
   const LSTMBuilder & rnn_lstm = (const LSTMBuilder&)rnn;
   assert(params.size() == rnn_lstm.params.size());
@@ -19,7 +19,7 @@ struct LSTMBuilder : public RNNBuilder {
                        cnn::real iscale = 1.0,
                        string name = "");
   LSTMBuilder(const LSTMBuilder& ref)
-      : RNNBuilder(ref)
+      : RNNBuilder(ref), fused_cell(ref.fused_cell)
   {}
 
   Expression back() const { return h.back().back(); }
@@ -35,12 +35,26 @@ struct LSTMBuilder : public RNNBuilder {
   void set_data_in_parallel(int n) ;
   std::vector<std::vector<Expression>> biases;
 
+  // compute each step with one LSTMCell node (see rnn-nodes.h) instead of about
+  // twenty small nodes. the parameters are unchanged, so models trained either
+  // way can be loaded by the other. set this before new_graph.
+  bool fused_cell = false;
+
 protected:
   void new_graph_impl(ComputationGraph& cg) override;
   void start_new_sequence_impl(const std::vector<Expression>& h0) override;
   Expression add_input_impl(int prev, const Expression& x) override;
   Expression add_input_impl(int prev, const std::vector<Expression>& x) override;
   Expression add_input_impl(const std::vector<Expression>& prv_history, const Expression& x) override;
+  std::vector<Expression> add_sequence_impl(int prev, const std::vector<Expression>& xs) override;
+
+private:
+  // one layer of one step through LSTMCell; sets c_t and returns h_t
+  Expression fused_step(unsigned layer, const Expression& in, bool has_prev_state,
+                        const Expression& h_tm1, const Expression& c_tm1, Expression& c_t);
+
+  // stacked [i; c; o] input weights, recurrent weights and biases per layer
+  std::vector<std::vector<Expression>> fused_vars;
 
 public:
 
@@ -16,7 +16,7 @@ using namespace std;
 
 namespace cnn {
 
-    extern mt19937* rndeng;
+    extern thread_local mt19937* rndeng;
 
     boost::mt19937 boost_rand_gen;
 
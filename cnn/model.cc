@@ -31,7 +31,7 @@ namespace cnn {
 
     ParametersBase::~ParametersBase() {}
 
-    Parameters::Parameters(const Dim& d, cnn::real scale, std::string nodename) : dim(d), name(nodename) {
+    Parameters::Parameters(const Dim& d, cnn::real scale, std::string nodename) : dim(d), name(nodename), in_arena(false) {
         values.d = g.d = d;
         values.v = (cnn::real*)cnn_mm_malloc(d.size() * sizeof(cnn::real), CNN_ALIGN);
         values.m_device_id = device_id;
@@ -113,20 +113,25 @@ void Parameters::accumulate_grad(const Tensor& d) {
 #endif
 }
 
+void Parameters::update_values(const Tensor& d, cnn::real a) {
+#if HAVE_CUDA
+  throw cuda_not_implemented("Parameters::update_values");
+#else
+  *values += a * *d;
+#endif
+}
+
 void Parameters::clear() {
   TensorTools::Zero(g);
 }
 
 LookupParameters::~LookupParameters()
 {
-    for (unsigned i = 0; i < values.size(); ++i) {
-        auto& v = values[i];
 #ifdef USE_CPU_FOR_LOOKUP_PARAM
-        cnn_mm_free_host(v.v);
+    cnn_mm_free_host(all_values.v);
 #else
-        cnn_mm_free(v.v);
+    cnn_mm_free(all_values.v);
 #endif
-    }
 
     clear();
 }
@@ -142,22 +147,22 @@ void LookupParameters::clear()
 }
 
 LookupParameters::LookupParameters(unsigned n, const Dim& d, cnn::real scale, std::string nodename) : dim(d), values(n), grads(n), name(nodename) {
+  /// the table is a single allocation; the rows are views into it
+  const unsigned row_size = d.size();
+  all_values.d = Dim({ row_size, n });
 #ifdef USE_CPU_FOR_LOOKUP_PARAM
-  bool b_cpu = true;
+  all_values.v = (cnn::real*)cnn_mm_malloc_host(all_values.d.size() * sizeof(cnn::real), CNN_ALIGN);
+  all_values.m_device_id = CPUDEVICE; /// for cpu
 #else
-  bool b_cpu = false; 
+  all_values.v = (cnn::real*)cnn_mm_malloc(all_values.d.size() * sizeof(cnn::real), CNN_ALIGN);
+  all_values.m_device_id = device_id;
 #endif
 
   for (unsigned i = 0; i < n; ++i) {
     auto& v = values[i];
     v.d = d;
-#ifdef USE_CPU_FOR_LOOKUP_PARAM
-    v.v = (cnn::real*)cnn_mm_malloc_host(d.size() * sizeof(cnn::real), CNN_ALIGN);
-    v.m_device_id= CPUDEVICE; /// for cpu
-#else
-    v.v = (cnn::real*)cnn_mm_malloc(d.size() * sizeof(cnn::real), CNN_ALIGN);
-    v.m_device_id = device_id;
-#endif
+    v.v = all_values.v + i * row_size;
+    v.m_device_id = all_values.m_device_id;
 	if (scale == 1.0)
 		/// fix scale to sqrt(6) / sqrt(d.d.sum_dims())
 		TensorTools::Randomize(v);
@@ -167,8 +172,7 @@ LookupParameters::LookupParameters(unsigned n, const Dim& d, cnn::real scale, st
 }
 
 void LookupParameters::scale_parameters(cnn::real a) {
-  for (auto& p : values)
-    (*p) *= a;
+  all_values.vec() *= a;
 }
 
 void LookupParameters::Initialize(unsigned index, const vector<cnn::real>& val) {
@@ -203,9 +207,7 @@ void LookupParameters::g_squared_l2norm(cnn::real* sqnorm) const {
 }
 
 void LookupParameters::squared_l2norm(cnn::real* sqnorm) const {
-    cnn::real a = 0;
-    for (unsigned i = 0; i < values.size(); ++i)
-        a += (*values[i]).squaredNorm();
+    cnn::real a = all_values.vec().squaredNorm();
 #if HAVE_CUDA
     CUDA_CHECK(cudaMemcpy(sqnorm, &a, sizeof(cnn::real), cudaMemcpyHostToDevice));
 #else
@@ -252,8 +254,8 @@ void LookupParameters::g_simple_clipping(cnn::real thr)  {
 
 void LookupParameters::copy(const LookupParameters & param) {
     assert(dim == param.dim);
-    for (size_t i = 0; i < param.values.size(); ++i)
-        TensorTools::CopyElements(values[i], param.values[i]);
+    assert(values.size() == param.values.size());
+    TensorTools::CopyElements(all_values, param.all_values);
     this->name = param.name;
 }
 
@@ -287,14 +289,86 @@ void LookupParameters::accumulate_grad(unsigned index, const Tensor& d) {
 #endif
 }
 
+void LookupParameters::update_values(unsigned index, const Tensor& d, cnn::real a) {
+#if HAVE_CUDA
+  throw cuda_not_implemented("LookupParameters::update_values");
+#else
+  *values[index] += a * *d;
+#endif
+}
+
+/// the arenas are swept in blocks of this many elements, one block per thread at a time
+static const long kArenaBlock = 1 << 14;
+
+/// parameters start at multiples of this many elements in the arenas
+static const unsigned kArenaAlign = CNN_ALIGN / sizeof(cnn::real);
+
+static cnn::real arena_squared_norm(const Tensor& t) {
+  const long n = t.d.size();
+  double s = 0;
+#pragma omp parallel for reduction(+:s)
+  for (long k = 0; k < n; k += kArenaBlock) {
+    Eigen::Map<const Eigen::Matrix<cnn::real, Eigen::Dynamic, 1>> x(t.v + k, std::min(kArenaBlock, n - k));
+    s += x.squaredNorm();
+  }
+  return (cnn::real)s;
+}
+
+static void arena_zero(Tensor& t) {
+  const long n = t.d.size();
+#pragma omp parallel for
+  for (long k = 0; k < n; k += kArenaBlock)
+    memset(t.v + k, 0, std::min(kArenaBlock, n - k) * sizeof(cnn::real));
+}
+
 Model::~Model() {
   for (auto p : all_params) delete p;
+  if (num_packed > 0) {
+    cnn_mm_free(arena_values.v);
+    cnn_mm_free(arena_g.v);
+  }
   if (gradient_norm_scratch)
       cnn_mm_free(gradient_norm_scratch); 
   if (gscale)
       cnn_mm_free_host(gscale);
 }
 
+void Model::pack_parameters() {
+  vector<size_t> offset(params.size());
+  size_t n = 0;
+  for (unsigned i = 0; i < params.size(); ++i) {
+    offset[i] = n;
+    n += (params[i]->dim.size() + kArenaAlign - 1) / kArenaAlign * kArenaAlign;
+  }
+  if (n == 0) return;
+
+  Tensor values(Dim({ (unsigned)n }), (cnn::real*)cnn_mm_malloc(n * sizeof(cnn::real), CNN_ALIGN), device_id);
+  Tensor g(Dim({ (unsigned)n }), (cnn::real*)cnn_mm_malloc(n * sizeof(cnn::real), CNN_ALIGN), device_id);
+  TensorTools::Zero(values);
+  TensorTools::Zero(g);
+  for (unsigned i = 0; i < params.size(); ++i) {
+    Parameters* p = params[i];
+    Tensor v(p->dim, values.v + offset[i], device_id);
+    Tensor pg(p->dim, g.v + offset[i], device_id);
+    TensorTools::CopyElements(v, p->values);
+    TensorTools::CopyElements(pg, p->g);
+    if (!p->in_arena) {
+      cnn_mm_free(p->values.v);
+      cnn_mm_free(p->g.v);
+    }
+    p->values.v = v.v;
+    p->g.v = pg.v;
+    p->in_arena = true;
+  }
+  if (num_packed > 0) {
+    cnn_mm_free(arena_values.v);
+    cnn_mm_free(arena_g.v);
+  }
+  arena_values = values;
+  arena_g = g;
+  num_packed = params.size();
+}
+
 void Model::project_weights(cnn::real radius) {
   static cnn::real* project_scratch = 0;
   if (!project_scratch)
@@ -311,6 +385,21 @@ void Model::project_weights(cnn::real radius) {
 }
 
 cnn::real Model::gradient_l2_norm() const {
+#if !HAVE_CUDA
+  if (num_packed > 0) {
+    cnn::real gg = arena_squared_norm(arena_g);
+    cnn::real a;
+    for (unsigned i = num_packed; i < params.size(); ++i) {
+      params[i]->g_squared_l2norm(&a);
+      gg += a;
+    }
+    for (auto p : lookup_params) {
+      p->g_squared_l2norm(&a);
+      gg += a;
+    }
+    return sqrt(gg);
+  }
+#endif
   if (!gradient_norm_scratch)
   {
       gradient_norm_scratch = (cnn::real*)cnn_mm_malloc(all_params.size() * sizeof(cnn::real), CNN_ALIGN);
@@ -342,9 +431,14 @@ cnn::real Model::gradient_l2_norm() const {
 #endif
 }
 
+
 void Model::simple_gradient_clipping(cnn::real threshold)  {
-    for (auto p : all_params) {
-        p->g_simple_clipping(threshold);
+    /// the threshold depends on the size of each parameter, so this stays a loop over them
+#if !HAVE_CUDA
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < (int)all_params.size(); ++i) {
+        all_params[i]->g_simple_clipping(threshold);
     }
 }
 
@@ -364,7 +458,14 @@ LookupParameters* Model::add_lookup_parameters(unsigned n, const Dim& d, cnn::re
 }
 
 void Model::reset_gradient() {
-  for (auto p : params) { p->clear(); }
+  if (num_packed > 0) {
+#if HAVE_CUDA
+    TensorTools::Zero(arena_g);
+#else
+    arena_zero(arena_g);
+#endif
+  }
+  for (unsigned i = num_packed; i < params.size(); ++i) { params[i]->clear(); }
   for (auto p : lookup_params) { p->clear(); }
 }
 
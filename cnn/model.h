@@ -5,9 +5,12 @@
 #include <string>
 #include <map>
 #include <unordered_map>
+#include <sstream>
+#include <stdexcept>
 
 #include <boost/serialization/split_member.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 
 #include "cnn/tensor.h"
 #include "cnn/cuda.h"
@@ -45,6 +48,8 @@ struct Parameters : public ParametersBase {
 
   void copy(const Parameters & val);
   void accumulate_grad(const Tensor& g);
+  // values += a * d, for updates that bypass g, see ComputationGraph::set_direct_update
+  void update_values(const Tensor& d, cnn::real a);
   void clear();
 
   Dim dim;
@@ -52,18 +57,42 @@ struct Parameters : public ParametersBase {
   Tensor g;
   std::string name;
 private:
-  Parameters() {}
+  Parameters() : in_arena(false) {}
   ~Parameters() {
+      if (in_arena) return;
       cnn_mm_free(values.v);
       cnn_mm_free(g.v); 
   }
   explicit Parameters(const Dim& d, cnn::real minmax, std::string nodename = ""); // initialize with ~U(-minmax,+minmax)
                                  // or Glorot initialization if minmax = 0
+  bool in_arena;  // values and g are views into the arenas of the model, see Model::pack_parameters
+
   friend class boost::serialization::access;
-  template<class Archive> void serialize(Archive& ar, const unsigned int version) {
+  template<class Archive> void save(Archive& ar, const unsigned int) const {
       ar & dim;
       ar & values;
   }
+  /// the values are read into the existing memory, which may be a view into an arena,
+  /// so the archived dimensions must be the ones the parameters were created with
+  template<class Archive> void load(Archive& ar, const unsigned int) {
+      Dim d;
+      ar & d;
+      if (d != dim) {
+          std::ostringstream s; s << "Parameters::load: archived dimensions " << d << " do not match " << dim;
+          throw std::invalid_argument(s.str());
+      }
+      Tensor t;
+      t.m_device_id = values.m_device_id;
+      ar & t;
+      if (t.d.size() != values.d.size()) {
+          cnn_mm_free(t.v, t.m_device_id < 0);
+          std::ostringstream s; s << "Parameters::load: archived values " << t.d << " do not match " << values.d;
+          throw std::invalid_argument(s.str());
+      }
+      TensorTools::CopyElements(values, t);
+      cnn_mm_free(t.v, t.m_device_id < 0);
+  }
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
 
 // represents a matrix/vector embedding of a discrete set
@@ -79,10 +108,15 @@ struct LookupParameters : public ParametersBase {
   void copy(const LookupParameters & val);
   void copy(const std::map<int, std::vector<cnn::real>> & vWordEmbedding);
   void accumulate_grad(unsigned index, const Tensor& g);
+  // values[index] += a * d, without going through grads
+  void update_values(unsigned index, const Tensor& d, cnn::real a);
   void clear();
 
   Dim dim;
+  // one row per entry; the rows are views into all_values
   std::vector<Tensor> values;
+  // the whole table as one {dim.size(), n} matrix, row i in column i
+  Tensor all_values;
 
   // working memory for those values and gradient that are actively used, they can be in GPU, where
   // main memory is in CPU
@@ -100,29 +134,52 @@ private:
   void free_working_copies();
 
   friend class boost::serialization::access;
+  /// version 0 stored each row as a tensor, version 1 stores the whole table at once
   template<class Archive>
   void save(Archive& ar, const unsigned int) const {
     ar & dim;
     int nv = (int) values.size();
     ar & nv;
-    for (unsigned i = 0; i < values.size(); ++i)
-    {
-        ar & values[i];
+#if HAVE_CUDA
+    if (all_values.m_device_id >= 0) {
+      std::vector<cnn::real> vc(all_values.d.size());
+      CUDA_CHECK(cudaMemcpy(vc.data(), all_values.v, vc.size() * sizeof(cnn::real), cudaMemcpyDeviceToHost));
+      ar & boost::serialization::make_array(vc.data(), vc.size());
+      return;
     }
+#endif
+    ar & boost::serialization::make_array(all_values.v, all_values.d.size());
   }
   template<class Archive>
-  void load(Archive& ar, const unsigned int) {
+  void load(Archive& ar, const unsigned int version) {
     int nv; 
-    ar & dim;
+    Dim d;
+    ar & d;
     ar & nv;
-    assert(nv == (int)values.size());
-    for (unsigned i = 0; i < values.size(); ++i)
-    {
-#ifdef USE_CPU_FOR_LOOKUP_PARAM
-        values[i].m_device_id = CPUDEVICE;
-#endif
-        ar & values[i];
+    if (d != dim || nv != (int)values.size()) {
+      std::ostringstream s; s << "LookupParameters::load: archived table of " << nv << " x " << d << " does not match " << values.size() << " x " << dim;
+      throw std::invalid_argument(s.str());
     }
+    if (version == 0) {
+      for (unsigned i = 0; i < values.size(); ++i)
+      {
+        Tensor t;
+        t.m_device_id = all_values.m_device_id;
+        ar & t;
+        TensorTools::CopyElements(values[i], t);
+        cnn_mm_free(t.v, t.m_device_id < 0);
+      }
+      return;
+    }
+#if HAVE_CUDA
+    if (all_values.m_device_id >= 0) {
+      std::vector<cnn::real> vc(all_values.d.size());
+      ar & boost::serialization::make_array(vc.data(), vc.size());
+      CUDA_CHECK(cudaMemcpy(all_values.v, vc.data(), vc.size() * sizeof(cnn::real), cudaMemcpyHostToDevice));
+      return;
+    }
+#endif
+    ar & boost::serialization::make_array(all_values.v, all_values.d.size());
   }
   BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
@@ -136,11 +193,24 @@ private:
     mutable cnn::real *gscale; /// gradient scale, memory to be allocated by GPU if HAVE_CUDA
     /// for speed-up, this memory is called from cudaMallocHost if HAVE_CUDA
  public:
-    Model() : gradient_norm_scratch() { 
+    Model() : gradient_norm_scratch(), num_packed(0) { 
         gscale = nullptr; 
     }
     ~Model();
 
+    /// moves the values and the gradients of all dense parameters into two contiguous
+    /// arenas, of which each Parameters is then a view. gradient_l2_norm, reset_gradient
+    /// and the updates of the trainers that support it then sweep the arenas once instead
+    /// of looping over the parameters. call this after the model is built; parameters
+    /// added later get memory of their own until the next call
+    void pack_parameters();
+    /// the first num_packed_parameters() of parameters_list() are in the arenas
+    unsigned num_packed_parameters() const { return num_packed; }
+    /// the arenas as vectors; each parameter starts at an aligned offset and the
+    /// padding in between is kept at zero
+    const Tensor& packed_values() const { return arena_values; }
+    const Tensor& packed_gradients() const { return arena_g; }
+
     /// for gradient clipping
     cnn::real gradient_l2_norm() const;
     /// clip gradients if their values are larger than the threshold
@@ -191,6 +261,10 @@ private:
     std::vector<Parameters*> params;
     std::vector<LookupParameters*> lookup_params;
     mutable cnn::real* gradient_norm_scratch;
+
+    unsigned num_packed;
+    Tensor arena_values;
+    Tensor arena_g;
 };
 void save_cnn_model(std::string filename, Model* model);
 void load_cnn_model(std::string filename, Model* model);
@@ -198,3 +272,5 @@ void load_cnn_model(std::string filename, Model* model);
 
 } // namespace cnn
 
+BOOST_CLASS_VERSION(cnn::LookupParameters, 1)
+
@@ -536,29 +536,59 @@ Dim SoftSign::dim_forward(const vector<Dim>& xs) const {
   return xs[0];
 }
 
-/*
 string PickNegLogSoftmax::as_string(const vector<string>& arg_names) const {
   ostringstream s;
-  if(pval) {
-    s << "log_softmax(" << arg_names[0] << ")_{" << *pval << '}';
-  } else {
-    s << "log_softmax(" << arg_names[0] << ")_{";
-    string sep = "";
-    for(auto v : *pvals) { s << sep << v; sep = ","; }
-    s << '}';
-  }
+  s << "pick_neg_log_softmax(" << arg_names[0] << ")_{";
+  string sep = "";
+  for (auto v : *pvals) { s << sep << v; sep = ","; }
+  s << '}';
   return s.str();
 }
 
 Dim PickNegLogSoftmax::dim_forward(const vector<Dim>& xs) const {
   assert(xs.size() == 1);
-  if (!LooksLikeVector(xs[0])) {
-    ostringstream s; s << "Bad input dimensions in PickNegLogSoftmax: " << xs;
+  // the columns are the batch here, the picks carry no minibatch index
+  if (xs[0].ndims() > 2 || xs[0].bd != 1 || xs[0].cols() != pvals->size()) {
+    ostringstream s; s << "Bad input dimensions in PickNegLogSoftmax: " << xs << " with " << pvals->size() << " indices";
     throw std::invalid_argument(s.str());
   }
-  return Dim({1}, xs[0].bd);
+  return Dim({ xs[0].cols() });
+}
+
+string HierarchicalSoftmaxPath::as_string(const vector<string>& arg_names) const {
+  ostringstream s;
+  s << "hierarchical_softmax_path(" << arg_names[0] << ", " << arg_names[1] << ')';
+  return s.str();
+}
+
+Dim HierarchicalSoftmaxPath::dim_forward(const vector<Dim>& xs) const {
+  assert(xs.size() == 2);
+  const unsigned cols = offsets.size() - 1;
+  if (offsets.empty() || xs[0].ndims() > 2 || xs[0].cols() != cols || xs[1].rows() != xs[0].rows() + 1 ||
+      xs[1].cols() != offsets.back() || signs.size() != offsets.back()) {
+    ostringstream s; s << "Bad input dimensions in HierarchicalSoftmaxPath: " << xs;
+    throw std::invalid_argument(s.str());
+  }
+  return Dim({ cols });
+}
+
+string MLPAttention::as_string(const vector<string>& arg_names) const {
+  ostringstream s;
+  s << "mlp_attention(" << arg_names[0] << '[' << key_start << ':' << key_start + slen << "], " << arg_names[1] << '[' << query_col << "], " << arg_names[2] << ", " << arg_names[3] << ')';
+  return s.str();
+}
+
+Dim MLPAttention::dim_forward(const vector<Dim>& xs) const {
+  assert(xs.size() == 4);
+  if (slen == 0 || xs[0].ndims() > 2 || xs[0].rows() != a_dim || key_start + slen > xs[0].cols() ||
+      xs[1].ndims() > 2 || xs[1].rows() != a_dim || query_col >= xs[1].cols() ||
+      !LooksLikeVector(xs[2]) || xs[2].rows() != a_dim ||
+      xs[3].ndims() > 2 || xs[3].cols() != slen) {
+    ostringstream s; s << "Bad input dimensions in MLPAttention: " << xs;
+    throw std::invalid_argument(s.str());
+  }
+  return Dim({ xs[3].rows() + slen });
 }
-*/
 
 string LogSoftmax::as_string(const vector<string>& arg_names) const {
   ostringstream s;
@@ -642,6 +672,25 @@ Dim ColumnSlices::dim_forward(const vector<Dim>& xs) const {
     return Dim({ rows, ncolumns}, xs[0].bd);
 }
 
+string SelectRows::as_string(const vector<string>& arg_names) const {
+    ostringstream s;
+    s << "select_rows(" << arg_names[0] << ", {" << rows.size() << " rows})";
+    return s.str();
+}
+
+Dim SelectRows::dim_forward(const vector<Dim>& xs) const {
+    if (xs.size() != 1 || xs[0].ndims() > 2 || rows.empty()) {
+        ostringstream s; s << "Bad input dimensions in SelectRows: " << xs;
+        throw std::invalid_argument(s.str());
+    }
+    for (auto r : rows)
+        if (r >= xs[0].rows())
+            throw std::invalid_argument("SelectRows: row index out of range");
+    if (xs[0].ndims() == 1)
+        return Dim({ (unsigned)rows.size() }, xs[0].bd);
+    return Dim({ (unsigned)rows.size(), xs[0].cols() }, xs[0].bd);
+}
+
 string MatrixMultiply::as_string(const vector<string>& arg_names) const {
   ostringstream s;
   s << arg_names[0] << " * " << arg_names[1];
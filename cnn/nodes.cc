@@ -5,6 +5,7 @@
 #include <stdexcept>
 #include "cnn/macros.h"
 #include "cnn/simd-functors.h"
+#include "cnn/simd-math.h"
 #include "cnn/functors.h"
 #if HAVE_CUDA
 #include <thrust/host_vector.h>
@@ -808,8 +809,7 @@ void Tanh::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
 #if HAVE_CUDA
   gpu::vtanh(fx.d.size(), xs[0]->v, fx.v);
 #else
-  auto x = **xs[0];
-  (*fx).array() = x.array().tanh();
+  simd::vtanh(fx.d.size(), xs[0]->v, fx.v);
 #endif
 }
 
@@ -877,8 +877,7 @@ void Exp::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
 #if HAVE_CUDA
     gpu::vexp(xs[0]->d.size(), xs[0]->v, fx.v); 
 #else
-    auto x = **xs[0];
-    *fx = x.array().exp();
+    simd::vexp(fx.d.size(), xs[0]->v, fx.v);
 #endif
 }
 
@@ -924,8 +923,7 @@ void Log::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
 #if HAVE_CUDA
   gpu::vlog(fx.d.size(), xs[0]->v, fx.v);
 #else
-    auto x = **xs[0];
-    *fx = x.array().log();
+    simd::vlog(fx.d.size(), xs[0]->v, fx.v);
 #endif
 }
 
@@ -1242,92 +1240,193 @@ void Softmax::backward_impl(const vector<const Tensor*>& xs,
 #endif
 }
 
-/*
-void PickNegLogSoftmax::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
-  if (xs[0]->d.cols() == 1) {
-    logz = (cnn::real*)fxs->allocate(sizeof(cnn::real)*fx.d.batch_elems());
+size_t HierarchicalSoftmaxPath::aux_storage_size() const {
+  /// d loss / d score at each step
+  return signs.size() * sizeof(cnn::real);
+}
+
+void HierarchicalSoftmaxPath::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
 #if HAVE_CUDA
-    if(pval) {
-      gpu::pnlsoftmax(xs[0]->d.size(), *pval, xs[0]->v, fx.v, logz);
-    } else {
-      // TODO: It'd be nice to have a kernel that did all batches at once
-      assert(pvals);
-      assert(pvals->size() == fx.d.batch_elems());
-      for(unsigned b = 0; b < pvals->size(); ++b)
-        gpu::pnlsoftmax(xs[0]->d.batch_size(), (*pvals)[b], xs[0]->batch_ptr(b), fx.v+b, logz+b);
-    }
+  throw std::runtime_error("HierarchicalSoftmaxPath not yet implemented for CUDA");
 #else
-    if(pval) {
-      auto x = **xs[0];
-      *logz = logsumexp(x);
-      fx.v[0] = *logz - x(*pval);
-    } else {
-      assert(pvals);
-      assert(pvals->size() == fx.d.batch_elems());
-      for(unsigned b = 0; b < pvals->size(); ++b) {
-        auto x = xs[0]->batch_matrix(b);
-        logz[b] = logsumexp(x);
-        fx.v[b] = logz[b] - x((*pvals)[b]);
-      }
+  const unsigned d = xs[0]->d.rows();
+  const unsigned cols = xs[0]->d.cols();
+  auto x = **xs[0];
+  auto w = **xs[1];
+  cnn::real* dz = static_cast<cnn::real*>(aux_mem);
+#pragma omp parallel for
+  for (int j = 0; j < (int)cols; ++j) {
+    cnn::real loss = 0;
+    for (unsigned p = offsets[j]; p < offsets[j + 1]; ++p) {
+      // -log sigmoid(t) = softplus(-t), computed without overflow
+      cnn::real t = signs[p] * (w.col(p).head(d).dot(x.col(j)) + w(d, p));
+      loss += std::max<cnn::real>(-t, 0) + std::log1p(std::exp(-std::fabs(t)));
+      dz[p] = -signs[p] / (1 + std::exp(t));
     }
+    fx.v[j] = loss;
+  }
+  fx.m_device_id = xs[0]->m_device_id;
 #endif
+}
+
+void HierarchicalSoftmaxPath::backward_impl(const vector<const Tensor*>& xs,
+                            const Tensor& fx,
+                            const Tensor& dEdf,
+                            unsigned i,
+                            Tensor& dEdxi) const {
+#if HAVE_CUDA
+  throw std::runtime_error("HierarchicalSoftmaxPath not yet implemented for CUDA");
+#else
+  const unsigned d = xs[0]->d.rows();
+  const unsigned cols = xs[0]->d.cols();
+  const cnn::real* dz = static_cast<const cnn::real*>(aux_mem);
+  auto dx = *dEdxi;
+  if (i == 0) {
+    auto w = **xs[1];
+#pragma omp parallel for
+    for (int j = 0; j < (int)cols; ++j)
+      for (unsigned p = offsets[j]; p < offsets[j + 1]; ++p)
+        dx.col(j) += (dEdf.v[j] * dz[p]) * w.col(p).head(d);
   } else {
-    throw std::runtime_error("PickNegLogSoftmax::forward not yet implemented for multiple columns");
+    auto x = **xs[0];
+#pragma omp parallel for
+    for (int j = 0; j < (int)cols; ++j) {
+      for (unsigned p = offsets[j]; p < offsets[j + 1]; ++p) {
+        cnn::real g = dEdf.v[j] * dz[p];
+        dx.col(p).head(d) += g * x.col(j);
+        dx(d, p) += g;
+      }
+    }
   }
+#endif
 }
 
-there is probably a bug in using batch implementation
-when runing on rnnlm2_cls, using pickenglogsoftmax actually get 0 PPL at epoch 4 and then crash, and that is impossible. 
-when switching back to logsoftmax and do pick operation later, the results look reasonable with training PPL decreased to 40~50 at epoch 9. 
-*/
-/** comment the following out
-void PickNegLogSoftmax::backward_impl(const vector<const Tensor*>& xs,
+size_t MLPAttention::aux_storage_size() const {
+  /// tanh(K + q 1^T)
+  return a_dim * slen * sizeof(cnn::real);
+}
+
+void MLPAttention::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
+#if HAVE_CUDA
+  throw std::runtime_error("MLPAttention not yet implemented for CUDA");
+#else
+  const unsigned d = xs[3]->d.rows();
+  auto k = (**xs[0]).block(0, key_start, a_dim, slen);
+  auto q = (**xs[1]).col(query_col);
+  auto v = (**xs[2]).col(0);
+  Tensor tt(Dim({ a_dim, slen }), static_cast<cnn::real*>(aux_mem), xs[0]->m_device_id);
+  auto t = *tt;
+  t = (k.colwise() + q).array().tanh().matrix();
+  auto y = *fx;
+  auto w = y.block(d, 0, slen, 1);
+  w.noalias() = scale * (t.transpose() * v);
+  cnn::real m = w.maxCoeff();
+  w = (w.array() - m).exp().matrix();
+  w /= w.sum();
+  y.block(0, 0, d, 1).noalias() = (**xs[3]) * w;
+  fx.m_device_id = xs[0]->m_device_id;
+#endif
+}
+
+// with g the gradient of the weights, both through c and directly,
+// de = w .* (g - w^T g) is the gradient of the scores and
+// dZ = scale * (v de^T) .* (1 - t .* t) the gradient of K + q 1^T
+void MLPAttention::backward_impl(const vector<const Tensor*>& xs,
                             const Tensor& fx,
                             const Tensor& dEdf,
                             unsigned i,
                             Tensor& dEdxi) const {
-  if (xs[0]->d.cols() == 1) {
 #if HAVE_CUDA
-    if(pval) {
-      const auto elem = *pval;
-      gpu::pnlsoftmax_backward(dEdxi.d.size(), elem, xs[0]->v, dEdf.v, logz, dEdxi.v);
-    } else {
-      assert(pvals);
-      assert(pvals->size() == fx.d.batch_elems()); 
-      // TODO: Again, it would be nice to do this with a single kernel
-      for(unsigned b = 0; b < pvals->size(); ++b) {
-        const auto elem = (*pvals)[b];
-        gpu::pnlsoftmax_backward(dEdxi.d.batch_size(), elem, xs[0]->batch_ptr(b), dEdf.v+b, logz+b, dEdxi.batch_ptr(b));
-      }
+  throw std::runtime_error("MLPAttention not yet implemented for CUDA");
+#else
+  const unsigned d = xs[3]->d.rows();
+  auto y = *fx;
+  auto dy = *dEdf;
+  auto w = y.block(d, 0, slen, 1);
+  auto dc = dy.block(0, 0, d, 1);
+  if (i == 3) {
+    (*dEdxi).noalias() += dc * w.transpose();
+    return;
+  }
+  Eigen::Matrix<cnn::real, Eigen::Dynamic, 1> g = (**xs[3]).transpose() * dc + dy.block(d, 0, slen, 1);
+  Eigen::Matrix<cnn::real, Eigen::Dynamic, 1> de = (w.array() * (g.array() - w.col(0).dot(g))).matrix();
+  const Tensor tt(Dim({ a_dim, slen }), static_cast<cnn::real*>(aux_mem), xs[0]->m_device_id);
+  auto t = *tt;
+  if (i == 2) {
+    (*dEdxi).col(0).noalias() += scale * (t * de);
+    return;
+  }
+  auto v = (**xs[2]).col(0);
+  Eigen::Matrix<cnn::real, Eigen::Dynamic, Eigen::Dynamic> dz = (scale * (v * de.transpose())).array() * (1 - t.array().square());
+  if (i == 0)
+    (*dEdxi).block(0, key_start, a_dim, slen) += dz;
+  else
+    (*dEdxi).col(query_col) += dz.rowwise().sum();
+#endif
+}
+
+size_t PickNegLogSoftmax::aux_storage_size() const {
+  /// the log partition of each column
+  return dim.size() * sizeof(cnn::real);
+}
+
+void PickNegLogSoftmax::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
+  const vector<unsigned>& v = *pvals;
+  const unsigned rows = xs[0]->d.rows();
+  const unsigned cols = xs[0]->d.cols();
+  for (unsigned c = 0; c < cols; ++c) {
+    if (v[c] != NO_INDEX && v[c] >= rows) {
+      ostringstream s; s << "PickNegLogSoftmax index " << v[c] << " out of range for " << xs[0]->d;
+      throw std::invalid_argument(s.str());
     }
+  }
+  cnn::real* logz = static_cast<cnn::real*>(aux_mem);
+#if HAVE_CUDA
+  TensorTools::Zero(fx);
+  for (unsigned c = 0; c < cols; ++c)
+    if (v[c] != NO_INDEX)
+      gpu::pnlsoftmax(rows, v[c], xs[0]->v + c * rows, fx.v + c, logz + c);
 #else
-    if(pval) {
-      const auto elem = *pval;
-      const cnn::real err = dEdf.v[0];
-      auto x = **xs[0];
-      // logz is computed in the forward pass and cached
-      *dEdxi += x.unaryExpr(FNegLogSoftmaxBackward(*logz, err));
-      //*dEdxi += x.unaryExpr(scalar_nlsoftmax_backward_op<cnn::real>(*logz, err));
-      (*dEdxi)(elem) -= err;
-    } else {
-      assert(pvals);
-      assert(pvals->size() == fx.d.batch_elems()); 
-      for(unsigned b = 0; b < pvals->size(); ++b) {
-        const auto elem = (*pvals)[b];
-        const cnn::real err = dEdf.v[b];
-        auto x = xs[0]->batch_matrix(b);
-        auto dEdxi_mat = dEdxi.batch_matrix(b);
-        dEdxi_mat += x.unaryExpr(FNegLogSoftmaxBackward(logz[b], err));
-        //dEdxi_mat += x.unaryExpr(scalar_nlsoftmax_backward_op<cnn::real>(logz[b], err));
-        dEdxi_mat(elem) -= err;
-      }
+  auto x = **xs[0];
+#pragma omp parallel for
+  for (int c = 0; c < (int)cols; ++c) {
+    if (v[c] == NO_INDEX) {
+      logz[c] = 0;
+      fx.v[c] = 0;
+      continue;
     }
+    cnn::real m = x.col(c).maxCoeff();
+    logz[c] = m + std::log(simd::vsum_exp(rows, xs[0]->v + c * rows, m));
+    fx.v[c] = logz[c] - x(v[c], c);
+  }
 #endif
-  } else {
-    throw std::runtime_error("PickNegLogSoftmax::backward not yet implemented for multiple columns");
+  fx.m_device_id = xs[0]->m_device_id;
+}
+
+void PickNegLogSoftmax::backward_impl(const vector<const Tensor*>& xs,
+                            const Tensor& fx,
+                            const Tensor& dEdf,
+                            unsigned i,
+                            Tensor& dEdxi) const {
+  const vector<unsigned>& v = *pvals;
+  const unsigned rows = xs[0]->d.rows();
+  const unsigned cols = xs[0]->d.cols();
+  const cnn::real* logz = static_cast<const cnn::real*>(aux_mem);
+#if HAVE_CUDA
+  for (unsigned c = 0; c < cols; ++c)
+    if (v[c] != NO_INDEX)
+      gpu::pnlsoftmax_backward(rows, v[c], xs[0]->v + c * rows, dEdf.v + c, logz + c, dEdxi.v + c * rows);
+#else
+#pragma omp parallel for
+  for (int c = 0; c < (int)cols; ++c) {
+    if (v[c] == NO_INDEX) continue;
+    const cnn::real err = dEdf.v[c];
+    // softmax times the error, minus the error at the picked element
+    simd::vaxpy_exp(rows, err, xs[0]->v + c * rows, logz[c], dEdxi.v + c * rows);
+    dEdxi.v[c * rows + v[c]] -= err;
   }
+#endif
 }
-*/
 
 size_t LogSoftmax::aux_storage_size() const {
     /// save space for softmax and a vector of nutt 
@@ -1364,7 +1463,7 @@ void LogSoftmax::backward_impl(const vector<const Tensor*>& xs,
     Tensor softmax(fx.d, static_cast<cnn::real*>(aux_mem)+cols, device_id);
     cnn::real* off_diag_sum = static_cast<cnn::real*>(aux_mem);
 
-    (*softmax).array() = (*fx).array().exp();
+    simd::vexp(fx.d.size(), fx.v, softmax.v);
 
 #pragma omp parallel for
     for (int k = 0; k < cols; k++)
@@ -1539,6 +1638,40 @@ void ColumnSlices::backward_impl(const vector<const Tensor*>& xs,
 #endif
 }
 
+// x_1 is a matrix
+// y = the rows of x_1 listed in rows
+void SelectRows::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
+#if HAVE_CUDA
+    throw std::runtime_error("SelectRows not yet implemented for CUDA");
+#else
+    auto x = **xs[0];
+    auto y = *fx;
+    const unsigned n = rows.size();
+    for (unsigned j = 0; j < y.cols(); ++j)
+        for (unsigned k = 0; k < n; ++k)
+            y(k, j) = x(rows[k], j);
+#endif
+}
+
+// the gradient of a row is scattered back to the row it was taken from
+void SelectRows::backward_impl(const vector<const Tensor*>& xs,
+    const Tensor& fx,
+    const Tensor& dEdf,
+    unsigned i,
+    Tensor& dEdxi) const {
+    assert(i == 0);
+#if HAVE_CUDA
+    throw std::runtime_error("SelectRows not yet implemented for CUDA");
+#else
+    auto d = *dEdf;
+    auto dx = *dEdxi;
+    const unsigned n = rows.size();
+    for (unsigned j = 0; j < d.cols(); ++j)
+        for (unsigned k = 0; k < n; ++k)
+            dx(rows[k], j) += d(k, j);
+#endif
+}
+
 #if HAVE_CUDA
 inline void CUDAMatrixMultiply(const Tensor& l, const Tensor& r, Tensor& y, const cnn::real* acc_scalar) {
   // if (r.d.ndims() == 1 || r.d.cols() == 1) {
@@ -1981,8 +2114,7 @@ void LogisticSigmoid::forward_impl(const vector<const Tensor*>& xs, Tensor& fx)
 #if HAVE_CUDA
   gpu::vlogistic(fx.d.size(), xs[0]->v, fx.v);
 #else
-  auto x = **xs[0];
-  *fx = x.unaryExpr(scalar_logistic_sigmoid_op<cnn::real>());
+  simd::vsigmoid(fx.d.size(), xs[0]->v, fx.v);
 #endif
   fx.m_device_id = xs[0]->m_device_id;
 }
@@ -108,6 +108,8 @@ struct Reshape : public Node {
   explicit Reshape(const std::initializer_list<VariableIndex>& a, const Dim& to) : Node(a), to(to) {}
   std::string as_string(const std::vector<std::string>& arg_names) const override;
   Dim dim_forward(const std::vector<Dim>& xs) const override;
+  bool has_side_info() const override { return true; }
+  int view_offset(const Dim& x) const override { return 0; }
   void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
   void backward_impl(const std::vector<const Tensor*>& xs,
                   const Tensor& fx,
@@ -137,6 +139,7 @@ struct KMHNGram : public Node {
   explicit KMHNGram(const std::initializer_list<VariableIndex>& a, unsigned n) : Node(a), n(n) {}
   std::string as_string(const std::vector<std::string>& arg_names) const override;
   Dim dim_forward(const std::vector<Dim>& xs) const override;
+  bool has_side_info() const override { return true; }
   void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
   void backward_impl(const std::vector<const Tensor*>& xs,
                   const Tensor& fx,
@@ -172,6 +175,7 @@ struct GaussianNoise : public Node {
   std::string as_string(const std::vector<std::string>& arg_names) const override;
   Dim dim_forward(const std::vector<Dim>& xs) const override;
   size_t aux_storage_size() const override;
+  bool is_thread_safe() const override { return false; }
   void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
   void backward_impl(const std::vector<const Tensor*>& xs,
                   const Tensor& fx,
@@ -187,6 +191,7 @@ struct Dropout : public Node {
   std::string as_string(const std::vector<std::string>& arg_names) const override;
   Dim dim_forward(const std::vector<Dim>& xs) const override;
   size_t aux_storage_size() const override;
+  bool is_thread_safe() const override { return false; }
   virtual bool supports_multibatch() const override { return true; }
   void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
   void backward_impl(const std::vector<const Tensor*>& xs,
@@ -203,6 +208,7 @@ struct BlockDropout : public Node {
   std::string as_string(const std::vector<std::string>& arg_names) const override;
   Dim dim_forward(const std::vector<Dim>& xs) const override;
   size_t aux_storage_size() const override;
+  bool is_thread_safe() const override { return false; }
   void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
   void backward_impl(const std::vector<const Tensor*>& xs,
                 const Tensor& fx,
@@ -750,38 +756,79 @@ struct LogSoftmax : public Node {
                     Tensor& dEdxi) const override;
 };
 
-/**
-there is probably a bug in using batch implementation
-when runing on rnnlm2_cls, using pickenglogsoftmax actually get 0 PPL at epoch 4 and then crash, and that is impossible.
-when switching back to logsoftmax and do pick operation later, the results look reasonable with training PPL decreased to 40~50 at epoch 9.
-*/
-/** comment the following out
-// z = \sum_j \exp (x_i)_j
-// y = (x_1)_element - \log z
-/*
+// x_1 holds one input column per utterance, x_2 one column [w; b] per step of
+// a path through a binary tree, with the steps of column j of x_1 in
+// [offsets[j], offsets[j+1]) and signs +1 or -1 for the branch taken
+// y_j = -\sum_p \log \sigma(sign_p (w_p . x_j + b_p))
+// the whole path is one node; its derivative at each step is kept for the
+// backward pass
+struct HierarchicalSoftmaxPath : public Node {
+  explicit HierarchicalSoftmaxPath(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>& offsets, const std::vector<cnn::real>& signs) : Node(a), offsets(offsets), signs(signs) {}
+  std::string as_string(const std::vector<std::string>& arg_names) const override;
+  Dim dim_forward(const std::vector<Dim>& xs) const override;
+  bool has_side_info() const override { return true; }
+  size_t aux_storage_size() const override;
+  void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
+  void backward_impl(const std::vector<const Tensor*>& xs,
+                    const Tensor& fx,
+                    const Tensor& dEdf,
+                    unsigned i,
+                    Tensor& dEdxi) const override;
+  std::vector<unsigned> offsets;
+  std::vector<cnn::real> signs;
+};
+
+// MLP attention of one utterance over its source, with
+// x_1 the source keys in the alignment space [a x N], of which this utterance
+// uses the slen columns from key_start on, x_2 the queries [a x nutt], of
+// which column query_col is used, x_3 the attention vector v [a] and x_4 the
+// source values [D x slen]
+// w = softmax(scale * v^T tanh(K + q 1^T)), c = x_4 w
+// y = [c; w], of size D + slen. the whole computation is one node; tanh(K + q 1^T)
+// is kept for the backward pass
+struct MLPAttention : public Node {
+  explicit MLPAttention(const std::initializer_list<VariableIndex>& a, unsigned a_dim, unsigned key_start, unsigned slen, unsigned query_col, cnn::real scale) :
+    Node(a), a_dim(a_dim), key_start(key_start), slen(slen), query_col(query_col), scale(scale) {}
+  std::string as_string(const std::vector<std::string>& arg_names) const override;
+  Dim dim_forward(const std::vector<Dim>& xs) const override;
+  bool has_side_info() const override { return true; }
+  size_t aux_storage_size() const override;
+  void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
+  void backward_impl(const std::vector<const Tensor*>& xs,
+                    const Tensor& fx,
+                    const Tensor& dEdf,
+                    unsigned i,
+                    Tensor& dEdxi) const override;
+  unsigned a_dim;
+  unsigned key_start;
+  unsigned slen;
+  unsigned query_col;
+  cnn::real scale;
+};
+
+// x_1 is a matrix of scores with one column per utterance
+// y_j = \log \sum_r \exp (x_1)_{r,j} - (x_1)_{v_j,j}
+// only the log partition of each column is kept for the backward pass,
+// columns with index NO_INDEX have zero loss and no gradient
 struct PickNegLogSoftmax : public Node {
-  explicit PickNegLogSoftmax(const std::initializer_list<VariableIndex>& a, unsigned v) : Node(a), val(v), pval(&val), vals(), pvals() {}
-  // use this constructor if you want to change the value after the graph is constructed
-  explicit PickNegLogSoftmax(const std::initializer_list<VariableIndex>& a, const unsigned* pv) : Node(a), val(), pval(pv), vals(), pvals() {}
-  explicit PickNegLogSoftmax(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>& v) : Node(a), val(), pval(), vals(v), pvals(&vals) {}
-  // use this constructor if you want to change the value after the graph is constructed
-  explicit PickNegLogSoftmax(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>* pv) : Node(a), val(), pval(), vals(), pvals(pv) {}
+  enum : unsigned { NO_INDEX = ~0u };
+  explicit PickNegLogSoftmax(const std::initializer_list<VariableIndex>& a, unsigned v) : Node(a), vals(1, v), pvals(&vals) {}
+  explicit PickNegLogSoftmax(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>& v) : Node(a), vals(v), pvals(&vals) {}
+  // use this constructor if you want to change the values after the graph is constructed
+  explicit PickNegLogSoftmax(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>* pv) : Node(a), vals(), pvals(pv) {}
   std::string as_string(const std::vector<std::string>& arg_names) const override;
   Dim dim_forward(const std::vector<Dim>& xs) const override;
-  virtual bool supports_multibatch() const override { return true; }
+  bool has_side_info() const override { return true; }
+  size_t aux_storage_size() const override;
   void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
   void backward_impl(const std::vector<const Tensor*>& xs,
                     const Tensor& fx,
                     const Tensor& dEdf,
                     unsigned i,
                     Tensor& dEdxi) const override;
-  mutable cnn::real* logz;
-  unsigned val;
-  const unsigned* pval;
   std::vector<unsigned> vals;
   const std::vector<unsigned>* pvals;
 };
-*/
 
 // z = \sum_{j \in denom} \exp (x_i)_j
 // y_i = (x_1)_i - \log z
@@ -807,6 +854,7 @@ struct PickElement : public Node {
   explicit PickElement(const std::initializer_list<VariableIndex>& a, const unsigned* pv) : Node(a), val(), pval(pv) {}
   std::string as_string(const std::vector<std::string>& arg_names) const override;
   Dim dim_forward(const std::vector<Dim>& xs) const override;
+  bool has_side_info() const override { return true; }
   void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
   void backward_impl(const std::vector<const Tensor*>& xs,
                     const Tensor& fx,
@@ -820,10 +868,13 @@ struct PickElement : public Node {
 // x_1 is a vector
 // y = x_1[start:end]
 // (start inclusive, end exclusive)
+// y is a view of x_1 unless x_1 is batched, see Node::view_offset
 struct PickRange : public Node {
   explicit PickRange(const std::initializer_list<VariableIndex>& a, unsigned start, unsigned end) : Node(a), start(start), end(end) {}
   std::string as_string(const std::vector<std::string>& arg_names) const override;
   Dim dim_forward(const std::vector<Dim>& xs) const override;
+  bool has_side_info() const override { return true; }
+  int view_offset(const Dim& x) const override { return (x.cols() == 1 && x.bd == 1) ? (int)start : -1; }
   void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
   void backward_impl(const std::vector<const Tensor*>& xs,
                     const Tensor& fx,
@@ -839,10 +890,14 @@ struct PickRange : public Node {
 // x_1 is a matrix
 // y = x_1[start_column: start_column + rows * (end_column - start_column)]
 // (start_column inclusive, end_column exclusive)
+// y is a view of x_1 unless x_1 is batched, see Node::view_offset
 struct ColumnSlices : public Node {
     explicit ColumnSlices(const std::initializer_list<VariableIndex>& a, unsigned rows, unsigned start_column, unsigned end_column) : Node(a), start_column(start_column), rows(rows), end_column(end_column) {}
     std::string as_string(const std::vector<std::string>& arg_names) const override;
     Dim dim_forward(const std::vector<Dim>& xs) const override;
+    bool has_side_info() const override { return true; }
+    // only whole columns are contiguous in x
+    int view_offset(const Dim& x) const override { return (x.bd == 1 && rows == x.rows()) ? (int)(rows * start_column) : -1; }
     void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
     void backward_impl(const std::vector<const Tensor*>& xs,
         const Tensor& fx,
@@ -854,6 +909,23 @@ struct ColumnSlices : public Node {
     unsigned end_column;
 };
 
+// x_1 is a matrix
+// y = the rows of x_1 listed in rows, in that order; rows may repeat
+// e.g. the output embeddings of a candidate vocabulary
+struct SelectRows : public Node {
+    explicit SelectRows(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>& rows) : Node(a), rows(rows) {}
+    std::string as_string(const std::vector<std::string>& arg_names) const override;
+    Dim dim_forward(const std::vector<Dim>& xs) const override;
+    bool has_side_info() const override { return true; }
+    void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
+    void backward_impl(const std::vector<const Tensor*>& xs,
+        const Tensor& fx,
+        const Tensor& dEdf,
+        unsigned i,
+        Tensor& dEdxi) const override;
+    std::vector<unsigned> rows;
+};
+
 // represents a simple vector of 0s
 struct Zeroes : public Node {
   explicit Zeroes(const Dim& d) : dim(d) {}
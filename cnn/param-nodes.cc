@@ -2,6 +2,7 @@
 #include "cnn/tensor.h"
 
 #include <sstream>
+#include <cstring>
 
 using namespace std;
 
@@ -65,6 +66,10 @@ void ParameterNode::accumulate_grad(const Tensor& g) {
   params->accumulate_grad(g);
 }
 
+void ParameterNode::update_values(const Tensor& g, cnn::real a) {
+  params->update_values(g, a);
+}
+
 string InputNode::as_string(const vector<string>& arg_names) const {
   ostringstream s;
   s << "constant(" << dim << ')';
@@ -199,7 +204,6 @@ void LookupNode::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const
 #endif
   }
   else {
-    std::runtime_error("not supported, should be removed"); 
     assert (pindices);
     assert (fx.d.batch_elems() == pindices->size());
 #ifdef HAVE_CUDA
@@ -245,4 +249,87 @@ void LookupNode::accumulate_grad(const Tensor& g) {
   }
 }
 
+void LookupNode::update_values(const Tensor& g, cnn::real a) {
+  if(pindex) {
+    params->update_values(*pindex, g, a);
+  } else {
+    assert (pindices);
+    const vector<Tensor>& gb = g.batch_elems();
+    for (unsigned b = 0; b < pindices->size(); ++b) {
+      unsigned i = pindices->at(b);
+      assert (i < params->values.size());
+      params->update_values(i, gb[b], a);
+    }
+  }
+}
+
+string LookupColumnsNode::as_string(const vector<string>& arg_names) const {
+  ostringstream s;
+  s << "lookup_cols(|x|=" << params->values.size() << " --> " << dim << " x " << pindices->size() << ')';
+  return s.str();
+}
+
+Dim LookupColumnsNode::dim_forward(const vector<Dim>& xs) const {
+  if (dim.ndims() != 1 || pindices->empty()) {
+    ostringstream s; s << "LookupColumnsNode needs vector embeddings and at least one index, got " << dim << " x " << pindices->size();
+    throw std::invalid_argument(s.str());
+  }
+  return Dim({ dim.rows(), (unsigned)pindices->size() });
+}
+
+void LookupColumnsNode::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
+  assert(xs.size() == 0);
+  const unsigned rows = dim.rows();
+  fx.m_device_id = device_id;
+  for (unsigned k = 0; k < pindices->size(); ++k) {
+    const unsigned i = (*pindices)[k];
+    cnn::real* v = fx.v + k * rows;
+    if (i == NO_INDEX) {
+#if HAVE_CUDA
+      CUDA_CHECK(cudaMemsetAsync(v, 0, rows * sizeof(cnn::real)));
+#else
+      memset(v, 0, rows * sizeof(cnn::real));
+#endif
+      continue;
+    }
+    assert(i < params->values.size());
+#if HAVE_CUDA
+    cudaMemcpyAsync(v, params->values[i].v, rows * sizeof(cnn::real),
+                    (params->values[i].m_device_id < 0) ? cudaMemcpyHostToDevice : cudaMemcpyDeviceToDevice);
+    params->values_for_non_zero_grads[i] = Tensor(dim, v, fx.m_device_id);
+#else
+    memcpy(v, params->values[i].v, rows * sizeof(cnn::real));
+#endif
+  }
+}
+
+void LookupColumnsNode::backward_impl(const vector<const Tensor*>& xs,
+                            const Tensor& fx,
+                            const Tensor& dEdf,
+                            unsigned i,
+                            Tensor& dEdxi) const {
+  cerr << "called backward() on arity 0 node\n";
+  abort();
+}
+
+void LookupColumnsNode::accumulate_grad(const Tensor& g) {
+  const unsigned rows = dim.rows();
+  for (unsigned k = 0; k < pindices->size(); ++k) {
+    const unsigned i = (*pindices)[k];
+    if (i == NO_INDEX) continue;
+    assert(i < params->values.size());
+    params->accumulate_grad(i, Tensor(dim, g.v + k * rows, g.m_device_id));
+  }
+}
+
+void LookupColumnsNode::update_values(const Tensor& g, cnn::real a) {
+  const unsigned rows = dim.rows();
+  for (unsigned k = 0; k < pindices->size(); ++k) {
+    const unsigned i = (*pindices)[k];
+    if (i == NO_INDEX) continue;
+    assert(i < params->values.size());
+    params->update_values(i, Tensor(dim, g.v + k * rows, g.m_device_id), a);
+  }
+}
+
 } // namespace cnn
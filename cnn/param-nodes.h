@@ -8,6 +8,8 @@ namespace cnn {
 
 struct ParameterNodeBase : public Node {
   virtual void accumulate_grad(const Tensor& g) = 0;
+  // adds a * g to the values of the parameters used, see ComputationGraph::set_direct_update
+  virtual void update_values(const Tensor& g, cnn::real a) = 0;
 };
 
 // represents optimizable parameters
@@ -22,6 +24,7 @@ struct ParameterNode : public ParameterNodeBase {
                   unsigned i,
                   Tensor& dEdxi) const override;
   void accumulate_grad(const Tensor& g) override;
+  void update_values(const Tensor& g, cnn::real a) override;
   Dim dim;
   Parameters* params;
 };
@@ -105,6 +108,8 @@ struct LookupNode : public ParameterNodeBase {
   std::string as_string(const std::vector<std::string>& arg_names) const override;
   Dim dim_forward(const std::vector<Dim>& xs) const override;
   virtual bool supports_multibatch() const override { return true; }  
+  // forward records the row in params->values_for_non_zero_grads when running on GPU
+  bool is_thread_safe() const override { return false; }
   void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
   void backward_impl(const std::vector<const Tensor*>& xs,
                   const Tensor& fx,
@@ -112,6 +117,7 @@ struct LookupNode : public ParameterNodeBase {
                   unsigned i,
                   Tensor& dEdxi) const override;
   void accumulate_grad(const Tensor& g) override;
+  void update_values(const Tensor& g, cnn::real a) override;
   Dim dim;
   unsigned index;
   const unsigned* pindex;
@@ -120,6 +126,33 @@ struct LookupNode : public ParameterNodeBase {
   LookupParameters* params;
 };
 
+// gathers one embedding per index into the columns of a {dim, n} matrix, so
+// the embeddings of a whole minibatch time step are one node. the
+// gradient is scattered back into params->grads column by column. a
+// column whose index is NO_INDEX is zero and gets no gradient, e.g. for
+// padding utterances of different lengths
+struct LookupColumnsNode : public ParameterNodeBase {
+  enum : unsigned { NO_INDEX = ~0u };
+  LookupColumnsNode(LookupParameters* p, const std::vector<unsigned>& indices) : dim(p->dim), indices(indices), pindices(&this->indices), params(p) {}
+  LookupColumnsNode(LookupParameters* p, const std::vector<unsigned>* pindices) : dim(p->dim), indices(), pindices(pindices), params(p) {}
+  std::string as_string(const std::vector<std::string>& arg_names) const override;
+  Dim dim_forward(const std::vector<Dim>& xs) const override;
+  // forward records the rows in params->values_for_non_zero_grads when running on GPU
+  bool is_thread_safe() const override { return false; }
+  void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
+  void backward_impl(const std::vector<const Tensor*>& xs,
+                  const Tensor& fx,
+                  const Tensor& dEdf,
+                  unsigned i,
+                  Tensor& dEdxi) const override;
+  void accumulate_grad(const Tensor& g) override;
+  void update_values(const Tensor& g, cnn::real a) override;
+  Dim dim;  // of one embedding
+  std::vector<unsigned> indices;
+  const std::vector<unsigned>* pindices;
+  LookupParameters* params;
+};
+
 } // namespace cnn
 
 #endif
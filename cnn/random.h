@@ -5,7 +5,8 @@
 
 namespace cnn {
 
-extern std::mt19937* rndeng;
+// one generator per thread, see InitializeThread()
+extern thread_local std::mt19937* rndeng;
 
 } // namespace cnn
 
@@ -0,0 +1,379 @@
+#include "cnn/rnn-nodes.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include "cnn/simd-functors.h"
+
+using namespace std;
+
+namespace cnn {
+
+typedef Eigen::Map<EMatrix, Eigen::Unaligned> EMap;
+
+// fills pos and role from the arguments in order, returns false if the
+// number of arguments does not match
+template <unsigned N>
+static bool assign_positions(const vector<unsigned>& roles, unsigned arity, int* pos, unsigned* role) {
+  for (unsigned r = 0; r < N; ++r) pos[r] = -1;
+  if (roles.size() != arity) return false;
+  for (unsigned k = 0; k < roles.size(); ++k) {
+    pos[roles[k]] = k;
+    role[k] = roles[k];
+  }
+  return true;
+}
+
+// whether the gate gradients of a cell must be computed for a backward call
+// of argument i, see LSTMCell::gate_gradients
+static bool new_backward_pass(unsigned& served, const cnn::real*& served_dEdf, const Tensor& dEdf, unsigned i) {
+  const bool fresh = served_dEdf != dEdf.v || (served & (1u << i));
+  if (fresh) {
+    served = 0;
+    served_dEdf = dEdf.v;
+  }
+  served |= 1u << i;
+  return fresh;
+}
+
+static string cell_as_string(const char* name, const vector<string>& arg_names) {
+  ostringstream s;
+  s << name << '(' << arg_names[0];
+  for (unsigned i = 1; i < arg_names.size(); ++i) s << ',' << arg_names[i];
+  s << ')';
+  return s.str();
+}
+
+void LSTMCell::set_arg_positions() {
+  has_prev = arity() == (projected_input ? 6u : 8u);
+  vector<unsigned> roles;
+  if (projected_input)
+    roles = has_prev ? vector<unsigned>{ X, H, C, WH, C2I, C2O } : vector<unsigned>{ X };
+  else
+    roles = has_prev ? vector<unsigned>{ X, H, C, WX, WH, B, C2I, C2O } : vector<unsigned>{ X, WX, B };
+  if (!assign_positions<NUM_ARGS>(roles, arity(), pos, role))
+    pos[X] = -1;  // reported by dim_forward
+}
+
+string LSTMCell::as_string(const vector<string>& arg_names) const {
+  return cell_as_string("lstm_cell", arg_names);
+}
+
+Dim LSTMCell::dim_forward(const vector<Dim>& xs) const {
+  if (pos[X] < 0) {
+    ostringstream s; s << "Bad number of arguments in LSTMCell: " << xs.size();
+    throw std::invalid_argument(s.str());
+  }
+  const Dim& x = xs[pos[X]];
+  const unsigned hidden = (projected_input ? x.rows() : xs[pos[WX]].rows()) / 3;
+  const unsigned n = x.cols();
+  bool ok = x.bd == 1 && hidden > 0;
+  if (projected_input)
+    ok = ok && x.rows() == 3 * hidden;
+  else
+    ok = ok && xs[pos[WX]] == Dim({ 3 * hidden, x.rows() }) && xs[pos[B]].rows() == 3 * hidden && xs[pos[B]].cols() == 1;
+  if (has_prev) {
+    ok = ok && xs[pos[H]].rows() == hidden && xs[pos[H]].cols() == n && xs[pos[C]].rows() == hidden && xs[pos[C]].cols() == n
+      && xs[pos[WH]] == Dim({ 3 * hidden, hidden })
+      && xs[pos[C2I]] == Dim({ hidden, hidden }) && xs[pos[C2O]] == Dim({ hidden, hidden });
+  }
+  if (!ok) {
+    ostringstream s; s << "Bad input dimensions in LSTMCell: " << xs;
+    throw std::invalid_argument(s.str());
+  }
+  return Dim({ hidden, 2 * n });
+}
+
+// gates and tanh(c) from forward, gate and cell gradients from backward
+size_t LSTMCell::aux_storage_size() const {
+  return 8 * dim.rows() * (dim.cols() / 2) * sizeof(cnn::real);
+}
+
+void LSTMCell::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
+#if HAVE_CUDA
+  throw std::runtime_error("LSTMCell not yet implemented for CUDA");
+#else
+  const unsigned hidden = fx.d.rows();
+  const unsigned n = fx.d.cols() / 2;
+  cnn::real* aux = static_cast<cnn::real*>(aux_mem);
+  EMap gates(aux, 3 * hidden, n);  // i, w, o after their nonlinearities
+  EMap tanh_c(aux + 3 * hidden * n, hidden, n);
+  EMap c(fx.v, hidden, n);
+  EMap h(fx.v + hidden * n, hidden, n);
+  EMap x(xs[pos[X]]->v, xs[pos[X]]->d.rows(), n);
+
+  if (projected_input) {
+    gates = x;
+  } else {
+    gates.noalias() = **xs[pos[WX]] * x;
+    gates.colwise() += (**xs[pos[B]]).col(0);
+  }
+  if (has_prev) {
+    gates.noalias() += **xs[pos[WH]] * EMap(xs[pos[H]]->v, hidden, n);
+    gates.topRows(hidden).noalias() += **xs[pos[C2I]] * EMap(xs[pos[C]]->v, hidden, n);
+  }
+
+  auto i_t = gates.topRows(hidden);
+  auto w_t = gates.middleRows(hidden, hidden);
+  i_t = i_t.unaryExpr(scalar_logistic_sigmoid_op<cnn::real>());
+  w_t.array() = w_t.array().tanh();
+  if (has_prev) {
+    EMap c_tm1(xs[pos[C]]->v, hidden, n);
+    c.array() = c_tm1.array() + i_t.array() * (w_t.array() - c_tm1.array());
+  } else {
+    c.array() = i_t.array() * w_t.array();
+  }
+
+  auto o_t = gates.bottomRows(hidden);
+  if (has_prev)
+    o_t.noalias() += **xs[pos[C2O]] * c;
+  o_t = o_t.unaryExpr(scalar_logistic_sigmoid_op<cnn::real>());
+  tanh_c.array() = c.array().tanh();
+  h.array() = o_t.array() * tanh_c.array();
+#endif
+  served_dEdf = nullptr;  // new values, the gate gradients are stale
+  fx.m_device_id = xs[0]->m_device_id;
+}
+
+void LSTMCell::gate_gradients(const vector<const Tensor*>& xs, const Tensor& dEdf) const {
+  const unsigned hidden = dEdf.d.rows();
+  const unsigned n = dEdf.d.cols() / 2;
+  cnn::real* aux = static_cast<cnn::real*>(aux_mem);
+  EMap gates(aux, 3 * hidden, n);
+  EMap tanh_c(aux + 3 * hidden * n, hidden, n);
+  EMap d_gates(aux + 4 * hidden * n, 3 * hidden, n);  // wrt the pre-activations
+  EMap d_c(aux + 7 * hidden * n, hidden, n);
+  EMap dEdc(dEdf.v, hidden, n);
+  EMap dEdh(dEdf.v + hidden * n, hidden, n);
+
+  auto i_t = gates.topRows(hidden).array();
+  auto w_t = gates.middleRows(hidden, hidden).array();
+  auto o_t = gates.bottomRows(hidden).array();
+  auto d_o = d_gates.bottomRows(hidden);
+  d_o.array() = dEdh.array() * tanh_c.array() * o_t * (1 - o_t);
+  d_c.array() = dEdc.array() + dEdh.array() * o_t * (1 - tanh_c.array().square());
+  if (has_prev) {
+    d_c.noalias() += (**xs[pos[C2O]]).transpose() * d_o;
+    EMap c_tm1(xs[pos[C]]->v, hidden, n);
+    d_gates.topRows(hidden).array() = d_c.array() * (w_t - c_tm1.array()) * i_t * (1 - i_t);
+  } else {
+    d_gates.topRows(hidden).array() = d_c.array() * w_t * i_t * (1 - i_t);
+  }
+  d_gates.middleRows(hidden, hidden).array() = d_c.array() * i_t * (1 - w_t.square());
+}
+
+void LSTMCell::backward_impl(const vector<const Tensor*>& xs,
+                             const Tensor& fx,
+                             const Tensor& dEdf,
+                             unsigned i,
+                             Tensor& dEdxi) const {
+#if HAVE_CUDA
+  throw std::runtime_error("LSTMCell not yet implemented for CUDA");
+#else
+  if (new_backward_pass(served, served_dEdf, dEdf, i))
+    gate_gradients(xs, dEdf);
+
+  const unsigned hidden = fx.d.rows();
+  const unsigned n = fx.d.cols() / 2;
+  cnn::real* aux = static_cast<cnn::real*>(aux_mem);
+  EMap gates(aux, 3 * hidden, n);
+  EMap d_gates(aux + 4 * hidden * n, 3 * hidden, n);
+  EMap d_c(aux + 7 * hidden * n, hidden, n);
+  auto d_i = d_gates.topRows(hidden);
+  auto d_o = d_gates.bottomRows(hidden);
+
+  switch (role[i]) {
+  case X:
+    if (projected_input)
+      EMap(dEdxi.v, 3 * hidden, n) += d_gates;
+    else
+      EMap(dEdxi.v, dEdxi.d.rows(), n).noalias() += (**xs[pos[WX]]).transpose() * d_gates;
+    break;
+  case H:
+    EMap(dEdxi.v, hidden, n).noalias() += (**xs[pos[WH]]).transpose() * d_gates;
+    break;
+  case C: {
+    EMap dEdc_tm1(dEdxi.v, hidden, n);
+    dEdc_tm1.array() += d_c.array() * (1 - gates.topRows(hidden).array());
+    dEdc_tm1.noalias() += (**xs[pos[C2I]]).transpose() * d_i;
+    break;
+  }
+  case WX:
+    (*dEdxi).noalias() += d_gates * EMap(xs[pos[X]]->v, xs[pos[X]]->d.rows(), n).transpose();
+    break;
+  case WH:
+    (*dEdxi).noalias() += d_gates * EMap(xs[pos[H]]->v, hidden, n).transpose();
+    break;
+  case B:
+    for (unsigned k = 0; k < n; ++k)
+      (*dEdxi).col(0) += d_gates.col(k);
+    break;
+  case C2I:
+    (*dEdxi).noalias() += d_i * EMap(xs[pos[C]]->v, hidden, n).transpose();
+    break;
+  case C2O:
+    (*dEdxi).noalias() += d_o * EMap(fx.v, hidden, n).transpose();
+    break;
+  }
+#endif
+}
+
+void GRUCell::set_arg_positions() {
+  has_prev = arity() == (projected_input ? 4u : 6u);
+  vector<unsigned> roles;
+  if (projected_input)
+    roles = has_prev ? vector<unsigned>{ X, H, WH, H2H } : vector<unsigned>{ X };
+  else
+    roles = has_prev ? vector<unsigned>{ X, H, WX, WH, H2H, B } : vector<unsigned>{ X, WX, B };
+  if (!assign_positions<NUM_ARGS>(roles, arity(), pos, role))
+    pos[X] = -1;  // reported by dim_forward
+}
+
+string GRUCell::as_string(const vector<string>& arg_names) const {
+  return cell_as_string("gru_cell", arg_names);
+}
+
+Dim GRUCell::dim_forward(const vector<Dim>& xs) const {
+  if (pos[X] < 0) {
+    ostringstream s; s << "Bad number of arguments in GRUCell: " << xs.size();
+    throw std::invalid_argument(s.str());
+  }
+  const Dim& x = xs[pos[X]];
+  const unsigned hidden = (projected_input ? x.rows() : xs[pos[WX]].rows()) / 3;
+  const unsigned n = x.cols();
+  bool ok = x.bd == 1 && hidden > 0;
+  if (projected_input)
+    ok = ok && x.rows() == 3 * hidden;
+  else
+    ok = ok && xs[pos[WX]] == Dim({ 3 * hidden, x.rows() }) && xs[pos[B]].rows() == 3 * hidden && xs[pos[B]].cols() == 1;
+  if (has_prev) {
+    ok = ok && xs[pos[H]].rows() == hidden && xs[pos[H]].cols() == n
+      && xs[pos[WH]] == Dim({ 2 * hidden, hidden }) && xs[pos[H2H]] == Dim({ hidden, hidden });
+  }
+  if (!ok) {
+    ostringstream s; s << "Bad input dimensions in GRUCell: " << xs;
+    throw std::invalid_argument(s.str());
+  }
+  return Dim({ hidden, n });
+}
+
+// gates and r .* h_tm1 from forward, their gradients from backward
+size_t GRUCell::aux_storage_size() const {
+  return 8 * dim.rows() * dim.cols() * sizeof(cnn::real);
+}
+
+void GRUCell::forward_impl(const vector<const Tensor*>& xs, Tensor& fx) const {
+#if HAVE_CUDA
+  throw std::runtime_error("GRUCell not yet implemented for CUDA");
+#else
+  const unsigned hidden = fx.d.rows();
+  const unsigned n = fx.d.cols();
+  cnn::real* aux = static_cast<cnn::real*>(aux_mem);
+  EMap gates(aux, 3 * hidden, n);  // z, r, c after their nonlinearities
+  EMap rh(aux + 3 * hidden * n, hidden, n);
+  EMap h(fx.v, hidden, n);
+  EMap x(xs[pos[X]]->v, xs[pos[X]]->d.rows(), n);
+
+  if (projected_input) {
+    gates = x;
+  } else {
+    gates.noalias() = **xs[pos[WX]] * x;
+    gates.colwise() += (**xs[pos[B]]).col(0);
+  }
+  auto z_t = gates.topRows(hidden);
+  auto c_t = gates.bottomRows(hidden);
+  if (has_prev) {
+    EMap h_tm1(xs[pos[H]]->v, hidden, n);
+    auto zr = gates.topRows(2 * hidden);
+    zr.noalias() += **xs[pos[WH]] * h_tm1;
+    zr = zr.unaryExpr(scalar_logistic_sigmoid_op<cnn::real>());
+    rh.array() = gates.middleRows(hidden, hidden).array() * h_tm1.array();
+    c_t.noalias() += **xs[pos[H2H]] * rh;
+    c_t.array() = c_t.array().tanh();
+    h.array() = h_tm1.array() + z_t.array() * (c_t.array() - h_tm1.array());
+  } else {
+    z_t = z_t.unaryExpr(scalar_logistic_sigmoid_op<cnn::real>());
+    c_t.array() = c_t.array().tanh();
+    h.array() = z_t.array() * c_t.array();
+  }
+#endif
+  served_dEdf = nullptr;  // new values, the gate gradients are stale
+  fx.m_device_id = xs[0]->m_device_id;
+}
+
+void GRUCell::gate_gradients(const vector<const Tensor*>& xs, const Tensor& dEdf) const {
+  const unsigned hidden = dEdf.d.rows();
+  const unsigned n = dEdf.d.cols();
+  cnn::real* aux = static_cast<cnn::real*>(aux_mem);
+  EMap gates(aux, 3 * hidden, n);
+  EMap d_gates(aux + 4 * hidden * n, 3 * hidden, n);  // wrt the pre-activations
+  EMap d_rh(aux + 7 * hidden * n, hidden, n);
+  EMap dEdh(dEdf.v, hidden, n);
+
+  auto z_t = gates.topRows(hidden).array();
+  auto r_t = gates.middleRows(hidden, hidden).array();
+  auto c_t = gates.bottomRows(hidden).array();
+  auto d_c = d_gates.bottomRows(hidden);
+  d_c.array() = dEdh.array() * z_t * (1 - c_t.square());
+  if (has_prev) {
+    EMap h_tm1(xs[pos[H]]->v, hidden, n);
+    d_gates.topRows(hidden).array() = dEdh.array() * (c_t - h_tm1.array()) * z_t * (1 - z_t);
+    d_rh.noalias() = (**xs[pos[H2H]]).transpose() * d_c;
+    d_gates.middleRows(hidden, hidden).array() = d_rh.array() * h_tm1.array() * r_t * (1 - r_t);
+  } else {
+    d_gates.topRows(hidden).array() = dEdh.array() * c_t * z_t * (1 - z_t);
+    d_gates.middleRows(hidden, hidden).setZero();
+  }
+}
+
+void GRUCell::backward_impl(const vector<const Tensor*>& xs,
+                            const Tensor& fx,
+                            const Tensor& dEdf,
+                            unsigned i,
+                            Tensor& dEdxi) const {
+#if HAVE_CUDA
+  throw std::runtime_error("GRUCell not yet implemented for CUDA");
+#else
+  if (new_backward_pass(served, served_dEdf, dEdf, i))
+    gate_gradients(xs, dEdf);
+
+  const unsigned hidden = fx.d.rows();
+  const unsigned n = fx.d.cols();
+  cnn::real* aux = static_cast<cnn::real*>(aux_mem);
+  EMap gates(aux, 3 * hidden, n);
+  EMap rh(aux + 3 * hidden * n, hidden, n);
+  EMap d_gates(aux + 4 * hidden * n, 3 * hidden, n);
+  EMap d_rh(aux + 7 * hidden * n, hidden, n);
+
+  switch (role[i]) {
+  case X:
+    if (projected_input)
+      EMap(dEdxi.v, 3 * hidden, n) += d_gates;
+    else
+      EMap(dEdxi.v, dEdxi.d.rows(), n).noalias() += (**xs[pos[WX]]).transpose() * d_gates;
+    break;
+  case H: {
+    EMap dEdh_tm1(dEdxi.v, hidden, n);
+    dEdh_tm1.array() += EMap(dEdf.v, hidden, n).array() * (1 - gates.topRows(hidden).array())
+      + d_rh.array() * gates.middleRows(hidden, hidden).array();
+    dEdh_tm1.noalias() += (**xs[pos[WH]]).transpose() * d_gates.topRows(2 * hidden);
+    break;
+  }
+  case WX:
+    (*dEdxi).noalias() += d_gates * EMap(xs[pos[X]]->v, xs[pos[X]]->d.rows(), n).transpose();
+    break;
+  case WH:
+    (*dEdxi).noalias() += d_gates.topRows(2 * hidden) * EMap(xs[pos[H]]->v, hidden, n).transpose();
+    break;
+  case H2H:
+    (*dEdxi).noalias() += d_gates.bottomRows(hidden) * rh.transpose();
+    break;
+  case B:
+    for (unsigned k = 0; k < n; ++k)
+      (*dEdxi).col(0) += d_gates.col(k);
+    break;
+  }
+#endif
+}
+
+} // namespace cnn
@@ -0,0 +1,92 @@
+#ifndef CNN_RNN_NODES_H_
+#define CNN_RNN_NODES_H_
+
+#include "cnn/cnn.h"
+
+namespace cnn {
+
+// one step of the LSTM in LSTMBuilder, computed by a single node.
+// with a previous state the arguments are
+//   x, h_tm1, c_tm1, W_x = [x2i; x2c; x2o], W_h = [h2i; h2c; h2o], b = [bi; bc; bo], c2i, c2o
+// and without one they are x, W_x, b. the step is
+//   i = logistic(W_x[i] x + W_h[i] h_tm1 + c2i c_tm1 + bi), f = 1 - i
+//   w = tanh(W_x[c] x + W_h[c] h_tm1 + bc)
+//   c = f .* c_tm1 + i .* w
+//   o = logistic(W_x[o] x + W_h[o] h_tm1 + c2o c + bo)
+//   h = o .* tanh(c)
+// all gates come out of one stacked matrix product followed by a single
+// elementwise pass. x has one column per sequence in parallel; the result
+// is [c h], i.e. columns 0..n-1 hold c and columns n..2n-1 hold h.
+// with projected_input, x already is W_x x + b, e.g. computed for a whole
+// sequence at once, and W_x and b are left out of the arguments.
+struct LSTMCell : public Node {
+  enum { X, H, C, WX, WH, B, C2I, C2O, NUM_ARGS };
+  template <typename T> explicit LSTMCell(const T& a, bool projected_input = false) :
+    Node(a), projected_input(projected_input) { set_arg_positions(); }
+  std::string as_string(const std::vector<std::string>& arg_names) const override;
+  Dim dim_forward(const std::vector<Dim>& xs) const override;
+  size_t aux_storage_size() const override;
+  void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
+  void backward_impl(const std::vector<const Tensor*>& xs,
+                     const Tensor& fx,
+                     const Tensor& dEdf,
+                     unsigned i,
+                     Tensor& dEdxi) const override;
+ private:
+  void set_arg_positions();
+  // fills the gradients of the gate pre-activations and of c in aux_mem.
+  // they depend only on the forward values and on dEdf, so they are computed
+  // by the first backward call of a pass and shared by the other arguments.
+  // served has a bit for each argument backward was called for since then;
+  // an argument is visited once per pass, so seeing it again, a new dEdf or
+  // a new forward starts over. this holds for any order of the arguments.
+  void gate_gradients(const std::vector<const Tensor*>& xs, const Tensor& dEdf) const;
+
+  bool projected_input;
+  bool has_prev;
+  int pos[NUM_ARGS];  // argument index of X .. C2O, -1 if not an argument
+  unsigned role[NUM_ARGS];  // inverse of pos
+  mutable unsigned served = 0;
+  mutable const cnn::real* served_dEdf = nullptr;
+};
+
+// one step of the GRU in GRUBuilder, computed by a single node.
+// with a previous state the arguments are
+//   x, h_tm1, W_x = [x2z; x2r; x2h], W_h = [h2z; h2r], h2h, b = [bz; br; bh]
+// and without one they are x, W_x, b. the step is
+//   z = logistic(W_x[z] x + W_h[z] h_tm1 + bz)
+//   r = logistic(W_x[r] x + W_h[r] h_tm1 + br)
+//   c = tanh(W_x[h] x + h2h (r .* h_tm1) + bh)
+//   h = (1 - z) .* h_tm1 + z .* c
+// the input projection of all gates is one matrix product and the recurrent
+// projection of z and r another; h2h needs r first, so it is a third.
+// projected_input works as in LSTMCell.
+struct GRUCell : public Node {
+  enum { X, H, WX, WH, H2H, B, NUM_ARGS };
+  template <typename T> explicit GRUCell(const T& a, bool projected_input = false) :
+    Node(a), projected_input(projected_input) { set_arg_positions(); }
+  std::string as_string(const std::vector<std::string>& arg_names) const override;
+  Dim dim_forward(const std::vector<Dim>& xs) const override;
+  size_t aux_storage_size() const override;
+  void forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const override;
+  void backward_impl(const std::vector<const Tensor*>& xs,
+                     const Tensor& fx,
+                     const Tensor& dEdf,
+                     unsigned i,
+                     Tensor& dEdxi) const override;
+ private:
+  void set_arg_positions();
+  // same scheme as in LSTMCell
+  void gate_gradients(const std::vector<const Tensor*>& xs, const Tensor& dEdf) const;
+
+  bool projected_input;
+  bool has_prev;
+  int pos[NUM_ARGS];
+  unsigned role[NUM_ARGS];
+  mutable unsigned served = 0;
+  mutable const cnn::real* served_dEdf = nullptr;
+};
+
+} // namespace cnn
+
+#endif
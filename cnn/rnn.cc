@@ -27,6 +27,19 @@ void RNNBuilder::display(ComputationGraph& cg) {
     }
 }
 
+vector<Expression> RNNBuilder::add_sequence_impl(int prev, const vector<Expression>& xs) {
+    const unsigned t0 = (unsigned)head.size() - (unsigned)xs.size();
+    vector<Expression> out;
+    for (unsigned t = 0; t < xs.size(); ++t)
+        out.push_back(add_input_impl(sequence_prev(prev, t0, t), xs[t]));
+    return out;
+}
+
+Expression RNNBuilder::sequence_step(const Expression& projected, unsigned t, unsigned nutt) {
+    unsigned rows = projected.pg->nodes[projected.i]->dim.rows();
+    return columnslices(projected, rows, t * nutt, (t + 1) * nutt);
+}
+
 SimpleRNNBuilder::SimpleRNNBuilder(unsigned ilayers,
                        const vector<unsigned>& dims,
                        Model* model,
@@ -177,6 +190,30 @@ Expression SimpleRNNBuilder::add_input_impl(const vector<Expression>& prev_histo
     return h[t].back();
 }
 
+vector<Expression> SimpleRNNBuilder::add_sequence_impl(int prev, const vector<Expression>& xs) {
+    const unsigned t0 = h.size();
+    const unsigned nutt = num_columns(xs[0]);
+    h.resize(t0 + xs.size(), vector<Expression>(layers));
+
+    vector<Expression> in = xs;
+    for (unsigned i = 0; i < layers; ++i) {
+        const vector<Expression>& vars = param_vars[i];
+        // input projection of all steps at once
+        Expression proj = colwise_add(vars[X2H] * concatenate_cols(in), vars[HB]);
+
+        for (unsigned t = 0; t < xs.size(); ++t) {
+            int p = sequence_prev(prev, t0, t);
+            Expression y = sequence_step(proj, t, nutt);
+            if (p == -1 && h0.size() > 0)
+                y = affine_transform({ y, vars[H2H], h0[i] });
+            else if (p >= 0)
+                y = affine_transform({ y, vars[H2H], h[p][i] });
+            in[t] = h[t0 + t][i] = activation(y);
+        }
+    }
+    return in;
+}
+
 Expression SimpleRNNBuilder::add_auxiliary_input(const Expression &in, const Expression &aux) {
   const unsigned t = h.size();
   h.push_back(vector<Expression>(layers));
@@ -21,7 +21,7 @@ inline void swap(RNNPointer& i1, RNNPointer& i2) {
 
 // interface for constructing an RNN, LSTM, GRU, etc.
 struct RNNBuilder {
-  RNNBuilder() : cur(-1) , dparallel (1) {}
+  RNNBuilder() : cur(-1) , dparallel (1), keep_states(false) {}
 
   virtual ~RNNBuilder();
   /// for parameter sharing 
@@ -33,12 +33,18 @@ struct RNNBuilder {
       layers = (unsigned int) input_dims.size();
       cur = ref.cur; 
       dparallel = ref.dparallel;
+      keep_states = ref.keep_states;
   }
 
   RNNPointer state() const { return cur; }
   int data_in_parallel() const { return dparallel;  }
   void set_data_in_parallel(int n) { dparallel = n; }
 
+  // marks the states of all layers after each step with ComputationGraph::keep_value,
+  // so that with recompute_values backward recomputes one step at a time.
+  // add_sequence marks the states after its last step
+  void set_keep_states(bool k) { keep_states = k; }
+
   // call this to reset the builder when you are working with a newly
   // created ComputationGraph object
   void new_graph(ComputationGraph& cg) {
@@ -64,7 +70,7 @@ struct RNNBuilder {
     head.push_back(cur);
     int rcp = cur;
     cur = (int) head.size() - 1;
-    return add_input_impl(rcp, x);
+    return mark_states(add_input_impl(rcp, x));
   }
 
   // add another timestep by reading in the variable x
@@ -74,7 +80,7 @@ struct RNNBuilder {
       head.push_back(cur);
       int rcp = cur;
       cur = (int) head.size() - 1;
-      return add_input_impl(rcp, x);
+      return mark_states(add_input_impl(rcp, x));
   }
 
   // add another timestep, but define recurrent connection to prev
@@ -84,7 +90,7 @@ struct RNNBuilder {
     sm.transition(RNNOp::add_input);
     head.push_back(prev);
     cur = (int) head.size() - 1;
-    return add_input_impl(prev, x);
+    return mark_states(add_input_impl(prev, x));
   }
 
   // add dependency on an external history
@@ -94,7 +100,25 @@ struct RNNBuilder {
       sm.transition(RNNOp::add_input);
       head.push_back(cur);
       cur = (int) head.size() - 1;
-      return add_input_impl(prv_history, x);
+      return mark_states(add_input_impl(prv_history, x));
+  }
+
+  // add one timestep for each element of xs, equivalent to calling
+  // add_input(x) for each of them in turn. returns the hidden representation
+  // of the deepest layer at every step. builders that override
+  // add_sequence_impl compute the input projections of all steps of a layer
+  // with one matrix product, leaving only the recurrent part per step
+  std::vector<Expression> add_sequence(const std::vector<Expression>& xs) {
+    if (xs.empty()) return std::vector<Expression>();
+    int rcp = cur;
+    for (unsigned t = 0; t < xs.size(); ++t) {
+      sm.transition(RNNOp::add_input);
+      head.push_back(cur);
+      cur = (int) head.size() - 1;
+    }
+    std::vector<Expression> hs = add_sequence_impl(rcp, xs);
+    mark_states(hs.back());
+    return hs;
   }
 
   // rewind the last timestep - this DOES NOT remove the variables
@@ -124,6 +148,20 @@ protected:
   virtual Expression add_input_impl(int prev, const Expression& x) = 0;
   virtual Expression add_input_impl(int prev, const std::vector<Expression>& x) = 0;  /// each layer has its own input
   virtual Expression add_input_impl(const std::vector<Expression>& prev_history, const Expression& x) = 0;
+  /// prev is the state before xs[0]; the default adds the steps one by one
+  virtual std::vector<Expression> add_sequence_impl(int prev, const std::vector<Expression>& xs);
+  /// state before step t of a sequence whose first step has index t0
+  static int sequence_prev(int prev, unsigned t0, unsigned t) { return (t == 0) ? prev : (int)(t0 + t - 1); }
+  /// columns of step t in the projection of a whole sequence with nutt columns per step
+  static Expression sequence_step(const Expression& projected, unsigned t, unsigned nutt);
+  /// number of columns of x
+  static unsigned num_columns(const Expression& x) { return x.pg->nodes[x.i]->dim.cols(); }
+  /// returns h, after marking the current states if keep_states is set
+  Expression mark_states(const Expression& h) {
+    if (keep_states)
+      for (auto& s : final_s()) s.pg->keep_value(s.i);
+    return h;
+  }
 public:
   /// for parameters
   // first index is layer, then ...
@@ -140,6 +178,7 @@ public:
   RNNPointer cur;
   std::vector<RNNPointer> head; // head[i] returns the head position
   int dparallel; /// the number of data points to process in parallel. this is used in the case of loading multiple sentences and process them at the same time
+  bool keep_states;
 };
 
 struct SimpleRNNBuilder : public RNNBuilder {
@@ -163,6 +202,9 @@ struct SimpleRNNBuilder : public RNNBuilder {
   Expression add_input_impl(int prev, const Expression& x) override;
   Expression add_input_impl(int prev, const std::vector<Expression>& x) override;
   Expression add_input_impl(const std::vector<Expression>& prev_history, const Expression& x) override;
+  std::vector<Expression> add_sequence_impl(int prev, const std::vector<Expression>& xs) override;
+  /// nonlinearity of the hidden layer, used by add_sequence_impl
+  virtual Expression activation(const Expression& y) { return tanh(y); }
 
  public:
   Expression add_auxiliary_input(const Expression& x, const Expression &aux);
@@ -205,6 +247,7 @@ protected:
     Expression add_input_impl(int prev, const Expression& x) override;
     Expression add_input_impl(int prev, const std::vector<Expression>& x) override;
     Expression add_input_impl(const std::vector<Expression>& prev_history, const Expression& x) override;
+    Expression activation(const Expression& y) override { return exponential_linear_units(y); }
 
 public:
     Expression add_auxiliary_input(const Expression& x, const Expression &aux);
@@ -4,6 +4,8 @@
 #include "cnn/model.h"
 #include "cnn/cnn.h"
 
+#include <stdexcept>
+
 using namespace std;
 
 namespace cnn {
@@ -13,21 +15,46 @@ ShadowParameters::ShadowParameters(const Parameters& p) : h(p.values) {
   TensorTools::Zero(h);
 }
 
-ShadowLookupParameters::ShadowLookupParameters(const LookupParameters& lp) : h(lp.values) {
+static void allocate_shadow_row(Tensor& t) {
 #ifdef USE_CPU_FOR_LOOKUP_PARAM
-    bool busecpu = true;
+    t.v = (cnn::real*)cnn_mm_malloc(t.d.size() * sizeof(cnn::real), CNN_ALIGN, true);
+    t.m_device_id = CPUDEVICE; /// for cpu
 #else
-    bool busecpu = false;
+    t.v = (cnn::real*)cnn_mm_malloc(t.d.size() * sizeof(cnn::real), CNN_ALIGN, false);
+    t.m_device_id = device_id;
 #endif
-    for (auto& t : h) {
-      t.v = (cnn::real*)cnn_mm_malloc(t.d.size() * sizeof(cnn::real), CNN_ALIGN, busecpu);
-#ifdef USE_CPU_FOR_LOOKUP_PARAM
-      t.m_device_id = CPUDEVICE; /// for cpu
-#else
-      t.m_device_id = device_id;
+    TensorTools::Zero(t);
+}
+
+ShadowLookupParameters::ShadowLookupParameters(const LookupParameters& lp, bool sparse) :
+  sparse(sparse), steps(0), dim(lp.dim) {
+#if HAVE_CUDA
+  // the CUDA updates of the trainers do not catch up the updates a row missed
+  if (sparse)
+    throw std::invalid_argument("sparse lookup updates are not implemented for CUDA");
 #endif
-      TensorTools::Zero(t);
-  }
+  if (sparse) return;
+  h = lp.values;
+  for (auto& t : h)
+    allocate_shadow_row(t);
+}
+
+Tensor& ShadowLookupParameters::row(unsigned i) {
+  if (!sparse) return h[i];
+  auto it = rows.find(i);
+  if (it != rows.end()) return it->second;
+  Tensor& t = rows[i];
+  t.d = dim;
+  allocate_shadow_row(t);
+  return t;
+}
+
+unsigned ShadowLookupParameters::skipped(unsigned i) {
+  auto it = last_step.find(i);
+  // a row that was never touched has missed every update so far
+  unsigned long last = (it == last_step.end()) ? 0 : it->second;
+  last_step[i] = steps;
+  return (steps > last) ? (unsigned)(steps - last - 1) : 0;
 }
 
 vector<ShadowParameters> AllocateShadowParameters(const Model& m) {
@@ -38,11 +65,11 @@ vector<ShadowParameters> AllocateShadowParameters(const Model& m) {
   return v;
 }
 
-vector<ShadowLookupParameters> AllocateShadowLookupParameters(const Model& m) {
+vector<ShadowLookupParameters> AllocateShadowLookupParameters(const Model& m, bool sparse) {
   vector<ShadowLookupParameters> v;
   v.reserve(m.lookup_parameters_list().size());
   for (auto& p : m.lookup_parameters_list())
-    v.emplace_back(*p);
+    v.emplace_back(*p, sparse);
   return v;
 }
 
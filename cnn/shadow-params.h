@@ -2,6 +2,7 @@
 #define CNN_SHADOW_PARAMS_H
 
 #include <vector>
+#include <unordered_map>
 #include "cnn/tensor.h"
 
 // if your learner needs to keep track of an extra set of values (one per
@@ -19,15 +20,30 @@ struct ShadowParameters {
   Tensor h;
 };
 
+// with sparse, the values of a row are only allocated when the row is first
+// used, so the memory and the cost of an update grow with the number of
+// rows that were trained rather than with the size of the table
 struct ShadowLookupParameters {
-  explicit ShadowLookupParameters(const LookupParameters& lp);
-  std::vector<Tensor> h;
+  explicit ShadowLookupParameters(const LookupParameters& lp, bool sparse = false);
+  // values for row i, zero when first used
+  Tensor& row(unsigned i);
+  // number of updates since row i was last touched, not counting the
+  // current one; marks row i as touched in the current update
+  unsigned skipped(unsigned i);
+
+  bool sparse;
+  std::vector<Tensor> h;  // all rows, or nothing if sparse
+  std::unordered_map<unsigned, Tensor> rows;  // the rows in use if sparse
+  // counts updates of the table, the learner increments it once per update
+  unsigned long steps;
+  std::unordered_map<unsigned, unsigned long> last_step;
+  Dim dim;
 };
 
 // one per element in model.parameters_list
 std::vector<ShadowParameters> AllocateShadowParameters(const Model& model);
 // one per element in model.lookup_parameters_list
-std::vector<ShadowLookupParameters> AllocateShadowLookupParameters(const Model& model);
+std::vector<ShadowLookupParameters> AllocateShadowLookupParameters(const Model& model, bool sparse = false);
 
 } // namespace cnn
 
@@ -0,0 +1,62 @@
+#include "cnn/shape-cache.h"
+#include "cnn/cnn.h"
+
+#include <typeinfo>
+
+using namespace std;
+
+namespace cnn {
+
+bool GraphShape::same_node(unsigned i, const Node* node) const {
+  if (types[i] != type_index(typeid(*node))) return false;
+  const unsigned b = arg_begin[i];
+  if (arg_begin[i + 1] - b != node->arity()) return false;
+  for (unsigned k = 0; k < node->arity(); ++k)
+    if (args[b + k] != (unsigned)node->args[k]) return false;
+  return true;
+}
+
+bool GraphShape::replay(unsigned i, Node* node) {
+  if (i >= size() || node->arity() == 0 || node->has_side_info() || !same_node(i, node)) return false;
+  node->dim = dims[i];
+  ++hits;
+  return true;
+}
+
+void GraphShape::record(unsigned i, const Node* node) {
+  if (i < size()) {
+    if (same_node(i, node) && dims[i] == node->dim) return;
+    truncate(i);
+  } else if (i > size()) {
+    // an earlier node was not recorded, so the recording cannot be extended
+    return;
+  }
+  if (arg_begin.empty()) arg_begin.push_back(0);
+  types.push_back(type_index(typeid(*node)));
+  for (VariableIndex a : node->args) args.push_back((unsigned)a);
+  arg_begin.push_back((unsigned)args.size());
+  dims.push_back(node->dim);
+}
+
+void GraphShape::truncate(unsigned i) {
+  types.erase(types.begin() + i, types.end());
+  dims.resize(i);
+  args.resize(arg_begin[i]);
+  arg_begin.resize(i + 1);
+}
+
+GraphShape* GraphShapeCache::find(const Key& key) {
+  auto it = shapes.find(key);
+  if (it != shapes.end()) return &it->second;
+  // a corpus with more distinct shapes than this is not worth caching; start over
+  if (shapes.size() >= max_shapes) shapes.clear();
+  return &shapes[key];
+}
+
+unsigned long GraphShapeCache::replayed_nodes() const {
+  unsigned long n = 0;
+  for (auto& s : shapes) n += s.second.hits;
+  return n;
+}
+
+} // namespace cnn
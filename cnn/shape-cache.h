@@ -0,0 +1,73 @@
+#ifndef CNN_SHAPE_CACHE_H_
+#define CNN_SHAPE_CACHE_H_
+
+#include <map>
+#include <typeindex>
+#include <vector>
+
+#include "cnn/dim.h"
+
+namespace cnn {
+
+struct Node;
+
+// the recorded structure of one graph: type, arguments and dimension of
+// every node in the order the nodes were added
+class GraphShape {
+ public:
+  GraphShape() : num_parameter_nodes(0), hits(0) {}
+
+  unsigned size() const { return (unsigned)dims.size(); }
+
+  // sets node->dim from the recording if node i has the recorded type and
+  // arguments. nodes without arguments and nodes with side information (see
+  // Node::has_side_info) are never replayed, their dimensions come from user
+  // data and are checked by record() instead.
+  bool replay(unsigned i, Node* node);
+  // stores node i after its dimension was computed. a node that differs from
+  // the recording drops the rest of the recording, which is rebuilt from the
+  // nodes that follow.
+  void record(unsigned i, const Node* node);
+
+  unsigned num_parameter_nodes;
+  unsigned long hits;  // number of replayed nodes
+
+ private:
+  bool same_node(unsigned i, const Node* node) const;
+  void truncate(unsigned i);
+
+  std::vector<std::type_index> types;
+  std::vector<unsigned> arg_begin;  // args of node i are args[arg_begin[i]..arg_begin[i+1])
+  std::vector<unsigned> args;
+  std::vector<Dim> dims;
+};
+
+// remembers the shapes of graphs built earlier, keyed by a caller supplied
+// description of the graph, e.g. the number of utterances and the sentence
+// lengths of a minibatch. when a graph with a known key is rebuilt, the node
+// dimensions are replayed instead of calling dim_forward and the node lists
+// are reserved up front. nodes whose type or arguments differ from the
+// recording are recomputed, and so are nodes whose dimensions depend on side
+// information such as ranges and reshape dimensions, so a key that does not
+// determine the graph costs a re-record, never a wrong Dim.
+class GraphShapeCache {
+ public:
+  typedef std::vector<unsigned> Key;
+
+  explicit GraphShapeCache(unsigned max_shapes = 4096) : max_shapes(max_shapes) {}
+
+  // returns the recording for key, creating an empty one if needed
+  GraphShape* find(const Key& key);
+  void clear() { shapes.clear(); }
+
+  unsigned size() const { return (unsigned)shapes.size(); }
+  unsigned long replayed_nodes() const;
+
+ private:
+  unsigned max_shapes;
+  std::map<Key, GraphShape> shapes;
+};
+
+} // namespace cnn
+
+#endif
@@ -0,0 +1,523 @@
+#include "cnn/simd-math.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+namespace cnn {
+namespace simd {
+
+namespace {
+
+// each of the following provides the operations the kernels below are
+// written in, for one packet type. the kernels are instantiated with the
+// widest packet the target supports and with scalar_ops for the remainder,
+// so every element goes through the same polynomial
+
+struct scalar_ops {
+  typedef float V;
+  static const int width = 1;
+  static inline V load(const float* p) { return *p; }
+  static inline void store(float* p, V a) { *p = a; }
+  static inline V set1(float a) { return a; }
+  static inline V add(V a, V b) { return a + b; }
+  static inline V sub(V a, V b) { return a - b; }
+  static inline V mul(V a, V b) { return a * b; }
+  static inline V div(V a, V b) { return a / b; }
+  static inline V sqrt(V a) { return std::sqrt(a); }
+  static inline V fma(V a, V b, V c) { return a * b + c; }
+  static inline V max(V a, V b) { return a > b ? a : b; }
+  static inline V min(V a, V b) { return a < b ? a : b; }
+  static inline V round(V a) { return std::nearbyint(a); }
+  static inline V abs(V a) { return std::fabs(a); }
+  // x - n log(2); in double since without a fused multiply-add the two step
+  // reduction below loses its extra bits
+  static inline V reduce_ln2(V x, V n) { return (V)((double)x - (double)n * 0.693147180559945309); }
+  static inline std::int32_t bits(V a) { std::int32_t i; std::memcpy(&i, &a, sizeof(i)); return i; }
+  static inline V from_bits(std::int32_t i) { V a; std::memcpy(&a, &i, sizeof(a)); return a; }
+  // a 2^n for integral n, added to the exponent bits; the result must be a
+  // normal float, since nothing carries out of the exponent field
+  static inline V ldexp(V a, V n) { return from_bits(bits(a) + (std::int32_t)n * (1 << 23)); }
+  // the sign of s on the magnitude of a
+  static inline V copysign(V a, V s) { return from_bits((bits(a) & 0x7fffffff) | (bits(s) & 0x80000000)); }
+  // mantissa in [0.5, 1) and the matching exponent of positive a
+  static inline V mantissa(V a) { return from_bits((bits(a) & 0x007fffff) | 0x3f000000); }
+  static inline V exponent(V a) { return (V)(((bits(a) >> 23) & 0xff) - 126); }
+  // a 2^149 if a is zero or subnormal, a elsewhere. read from the bits, since
+  // with -Ofast the arithmetic treats subnormal inputs as zero
+  static inline V unsubnormal(V a) {
+    if (bits(a) & 0x7f800000) return a;
+    return copysign((V)(bits(a) & 0x007fffff), a);
+  }
+  // 149 where unsubnormal scaled a, 0 elsewhere
+  static inline V subnormal_shift(V a) { return (bits(a) & 0x7f800000) ? 0.0f : 149.0f; }
+  // a < b ? x : y
+  static inline V select_lt(V a, V b, V x, V y) { return a < b ? x : y; }
+  static inline V select_eq(V a, V b, V x, V y) { return a == b ? x : y; }
+  // a where a is NaN, y elsewhere; on the bits, since -Ofast assumes a == a
+  static inline V keep_nan(V a, V y) {
+    std::int32_t nan = -(std::int32_t)((bits(a) & 0x7fffffff) > 0x7f800000);
+    return from_bits((bits(a) & nan) | (bits(y) & ~nan));
+  }
+  static inline float hsum(V a) { return a; }
+};
+
+#if defined(__AVX512F__)
+struct packet_ops {
+  typedef __m512 V;
+  static const int width = 16;
+  static inline V load(const float* p) { return _mm512_loadu_ps(p); }
+  static inline void store(float* p, V a) { _mm512_storeu_ps(p, a); }
+  static inline V set1(float a) { return _mm512_set1_ps(a); }
+  static inline V add(V a, V b) { return _mm512_add_ps(a, b); }
+  static inline V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+  static inline V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+  static inline V div(V a, V b) { return _mm512_div_ps(a, b); }
+  static inline V sqrt(V a) { return _mm512_sqrt_ps(a); }
+  static inline V fma(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+  static inline V max(V a, V b) { return _mm512_max_ps(a, b); }
+  static inline V min(V a, V b) { return _mm512_min_ps(a, b); }
+  static inline V round(V a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static inline V reduce_ln2(V x, V n) {
+    // log(2) split in two parts, the first exact in a few bits
+    return fma(n, set1(2.12194440e-4f), fma(n, set1(-0.693359375f), x));
+  }
+  static inline V abs(V a) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff))); }
+  static inline V ldexp(V a, V n) {
+    __m512i e = _mm512_slli_epi32(_mm512_cvtps_epi32(n), 23);
+    return _mm512_castsi512_ps(_mm512_add_epi32(_mm512_castps_si512(a), e));
+  }
+  static inline V copysign(V a, V s) {
+    __m512i m = _mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff));
+    __m512i sg = _mm512_and_si512(_mm512_castps_si512(s), _mm512_set1_epi32(0x80000000));
+    return _mm512_castsi512_ps(_mm512_or_si512(m, sg));
+  }
+  static inline V mantissa(V a) {
+    __m512i m = _mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x007fffff));
+    return _mm512_castsi512_ps(_mm512_or_si512(m, _mm512_set1_epi32(0x3f000000)));
+  }
+  static inline V exponent(V a) {
+    __m512i e = _mm512_and_si512(_mm512_srli_epi32(_mm512_castps_si512(a), 23), _mm512_set1_epi32(0xff));
+    return _mm512_cvtepi32_ps(_mm512_sub_epi32(e, _mm512_set1_epi32(126)));
+  }
+  static inline __mmask16 is_subnormal(V a) {
+    return _mm512_testn_epi32_mask(_mm512_castps_si512(a), _mm512_set1_epi32(0x7f800000));
+  }
+  static inline V unsubnormal(V a) {
+    V m = _mm512_cvtepi32_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x007fffff)));
+    return _mm512_mask_blend_ps(is_subnormal(a), a, copysign(m, a));
+  }
+  static inline V subnormal_shift(V a) { return _mm512_maskz_mov_ps(is_subnormal(a), set1(149.0f)); }
+  static inline V select_lt(V a, V b, V x, V y) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_LT_OQ), y, x); }
+  static inline V select_eq(V a, V b, V x, V y) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ), y, x); }
+  static inline V keep_nan(V a, V y) {
+    __m512i m = _mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff));
+    return _mm512_mask_blend_ps(_mm512_cmpgt_epi32_mask(m, _mm512_set1_epi32(0x7f800000)), y, a);
+  }
+  static inline float hsum(V a) { return _mm512_reduce_add_ps(a); }
+};
+#define CNN_SIMD_PACKET 1
+#elif defined(__AVX2__) && defined(__FMA__)
+struct packet_ops {
+  typedef __m256 V;
+  static const int width = 8;
+  static inline V load(const float* p) { return _mm256_loadu_ps(p); }
+  static inline void store(float* p, V a) { _mm256_storeu_ps(p, a); }
+  static inline V set1(float a) { return _mm256_set1_ps(a); }
+  static inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+  static inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  static inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  static inline V div(V a, V b) { return _mm256_div_ps(a, b); }
+  static inline V sqrt(V a) { return _mm256_sqrt_ps(a); }
+  static inline V fma(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+  static inline V max(V a, V b) { return _mm256_max_ps(a, b); }
+  static inline V min(V a, V b) { return _mm256_min_ps(a, b); }
+  static inline V round(V a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static inline V reduce_ln2(V x, V n) {
+    // log(2) split in two parts, the first exact in a few bits
+    return fma(n, set1(2.12194440e-4f), fma(n, set1(-0.693359375f), x));
+  }
+  static inline V abs(V a) { return _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff))); }
+  static inline V ldexp(V a, V n) {
+    __m256i e = _mm256_slli_epi32(_mm256_cvtps_epi32(n), 23);
+    return _mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(a), e));
+  }
+  static inline V copysign(V a, V s) {
+    V sign = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+    return _mm256_or_ps(_mm256_andnot_ps(sign, a), _mm256_and_ps(sign, s));
+  }
+  static inline V mantissa(V a) {
+    __m256i m = _mm256_and_si256(_mm256_castps_si256(a), _mm256_set1_epi32(0x007fffff));
+    return _mm256_castsi256_ps(_mm256_or_si256(m, _mm256_set1_epi32(0x3f000000)));
+  }
+  static inline V exponent(V a) {
+    __m256i e = _mm256_and_si256(_mm256_srli_epi32(_mm256_castps_si256(a), 23), _mm256_set1_epi32(0xff));
+    return _mm256_cvtepi32_ps(_mm256_sub_epi32(e, _mm256_set1_epi32(126)));
+  }
+  static inline V is_subnormal(V a) {
+    __m256i e = _mm256_and_si256(_mm256_castps_si256(a), _mm256_set1_epi32(0x7f800000));
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(e, _mm256_setzero_si256()));
+  }
+  static inline V unsubnormal(V a) {
+    V m = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_castps_si256(a), _mm256_set1_epi32(0x007fffff)));
+    return _mm256_blendv_ps(a, copysign(m, a), is_subnormal(a));
+  }
+  static inline V subnormal_shift(V a) { return _mm256_and_ps(is_subnormal(a), set1(149.0f)); }
+  static inline V select_lt(V a, V b, V x, V y) { return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+  static inline V select_eq(V a, V b, V x, V y) { return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+  static inline V keep_nan(V a, V y) {
+    __m256i m = _mm256_and_si256(_mm256_castps_si256(a), _mm256_set1_epi32(0x7fffffff));
+    return _mm256_blendv_ps(y, a, _mm256_castsi256_ps(_mm256_cmpgt_epi32(m, _mm256_set1_epi32(0x7f800000))));
+  }
+  static inline float hsum(V a) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+  }
+};
+#define CNN_SIMD_PACKET 1
+#endif
+
+// the kernels clamp their argument into the range of the polynomials, which
+// would turn NaN into a finite value; keep_nan passes NaN inputs through so
+// that a diverging model still shows up as NaN
+template <class O>
+inline typename O::V exp_kernel(typename O::V a) {
+  typedef typename O::V V;
+  // the largest float with a finite exp and the smallest with a normal one
+  const V hi = O::set1(88.7228317f), lo = O::set1(-87.3365402f);
+  V x = O::min(O::max(a, lo), hi);
+  // x = n log(2) + r with |r| <= log(2) / 2
+  V n = O::round(O::mul(x, O::set1(1.44269504088896341f)));
+  V r = O::reduce_ln2(x, n);
+  V p = O::set1(1.9875691500e-4f);
+  p = O::fma(p, r, O::set1(1.3981999507e-3f));
+  p = O::fma(p, r, O::set1(8.3334519073e-3f));
+  p = O::fma(p, r, O::set1(4.1665795894e-2f));
+  p = O::fma(p, r, O::set1(1.6666665459e-1f));
+  p = O::fma(p, r, O::set1(5.0000001201e-1f));
+  p = O::fma(p, O::mul(r, r), O::add(r, O::set1(1.0f)));
+  // p 2^n is normal for x in [lo, hi]; outside, exp overflows to inf or
+  // falls below the normal range, where it is flushed to 0 like -Ofast does
+  V y = O::ldexp(p, n);
+  y = O::select_lt(hi, a, O::set1(std::numeric_limits<float>::infinity()), y);
+  y = O::select_lt(a, lo, O::set1(0.0f), y);
+  return O::keep_nan(a, y);
+}
+
+template <class O>
+inline typename O::V log_kernel(typename O::V a) {
+  typedef typename O::V V;
+  // a subnormal a is scaled into the normal range first, log(a) = log(x) - shift log(2)
+  V x = O::unsubnormal(a);
+  V shift = O::subnormal_shift(a);
+  // x = m 2^e with m in [sqrt(1/2), sqrt(2))
+  V e = O::sub(O::exponent(x), shift);
+  V m = O::mantissa(x);
+  V small = O::select_lt(m, O::set1(0.707106781186547524f), O::set1(1.0f), O::set1(0.0f));
+  e = O::sub(e, small);
+  m = O::sub(O::add(m, O::mul(m, small)), O::set1(1.0f));
+  V z = O::mul(m, m);
+  V p = O::set1(7.0376836292e-2f);
+  p = O::fma(p, m, O::set1(-1.1514610310e-1f));
+  p = O::fma(p, m, O::set1(1.1676998740e-1f));
+  p = O::fma(p, m, O::set1(-1.2420140846e-1f));
+  p = O::fma(p, m, O::set1(1.4249322787e-1f));
+  p = O::fma(p, m, O::set1(-1.6668057665e-1f));
+  p = O::fma(p, m, O::set1(2.0000714765e-1f));
+  p = O::fma(p, m, O::set1(-2.4999993993e-1f));
+  p = O::fma(p, m, O::set1(3.3333331174e-1f));
+  V y = O::mul(O::mul(p, m), z);
+  y = O::fma(e, O::set1(-2.12194440e-4f), y);
+  y = O::fma(z, O::set1(-0.5f), y);
+  y = O::fma(e, O::set1(0.693359375f), O::add(m, y));
+  const V zero = O::set1(0.0f);
+  y = O::select_eq(x, O::set1(std::numeric_limits<float>::infinity()), x, y);
+  y = O::select_lt(x, zero, O::set1(std::numeric_limits<float>::quiet_NaN()), y);
+  y = O::select_eq(x, zero, O::set1(-std::numeric_limits<float>::infinity()), y);
+  return O::keep_nan(x, y);
+}
+
+template <class O>
+inline typename O::V tanh_kernel(typename O::V x) {
+  typedef typename O::V V;
+  V ax = O::abs(x);
+  // odd polynomial near zero, where 1 - 2 / (exp(2x) + 1) loses precision
+  V z = O::mul(x, x);
+  V p = O::set1(-5.70498872745e-3f);
+  p = O::fma(p, z, O::set1(2.06390887954e-2f));
+  p = O::fma(p, z, O::set1(-5.37397155531e-2f));
+  p = O::fma(p, z, O::set1(1.33314422036e-1f));
+  p = O::fma(p, z, O::set1(-3.33332819422e-1f));
+  V near = O::fma(O::mul(p, z), x, x);
+  // tanh rounds to 1 from about 9.1 on
+  V e = exp_kernel<O>(O::mul(O::min(ax, O::set1(10.0f)), O::set1(2.0f)));
+  V far = O::sub(O::set1(1.0f), O::div(O::set1(2.0f), O::add(e, O::set1(1.0f))));
+  return O::keep_nan(x, O::select_lt(ax, O::set1(0.625f), near, O::copysign(far, x)));
+}
+
+template <class O>
+inline typename O::V sigmoid_kernel(typename O::V x) {
+  typedef typename O::V V;
+  const V one = O::set1(1.0f);
+  V y = O::div(one, O::add(one, exp_kernel<O>(O::sub(O::set1(0.0f), x))));
+  // -Ofast may divide by a reciprocal estimate, which is off by an ulp at 1
+  // and NaN for an infinite exp, so the saturated ends are set directly
+  y = O::select_lt(O::set1(18.0f), x, one, y);
+  y = O::select_lt(x, O::set1(-87.3365402f), O::set1(0.0f), y);
+  return O::keep_nan(x, y);
+}
+
+#define CNN_SIMD_MAP(name, kernel)                                          \
+  void name(int n, const float* x, float* y) {                              \
+    int i = 0;                                                              \
+    CNN_SIMD_MAP_PACKETS(kernel)                                            \
+    for (; i < n; ++i) y[i] = kernel<scalar_ops>(x[i]);                     \
+  }
+
+#ifdef CNN_SIMD_PACKET
+#define CNN_SIMD_MAP_PACKETS(kernel)                                        \
+    for (; i + packet_ops::width <= n; i += packet_ops::width)              \
+      packet_ops::store(y + i, kernel<packet_ops>(packet_ops::load(x + i)));
+#else
+#define CNN_SIMD_MAP_PACKETS(kernel)
+#endif
+
+} // namespace
+
+CNN_SIMD_MAP(vexp, exp_kernel)
+CNN_SIMD_MAP(vlog, log_kernel)
+CNN_SIMD_MAP(vtanh, tanh_kernel)
+CNN_SIMD_MAP(vsigmoid, sigmoid_kernel)
+
+#undef CNN_SIMD_MAP
+#undef CNN_SIMD_MAP_PACKETS
+
+namespace {
+
+// the double precision counterpart of scalar_ops, as far as the optimizer
+// steps need it
+struct double_ops {
+  typedef double V;
+  static const int width = 1;
+  static inline V load(const double* p) { return *p; }
+  static inline void store(double* p, V a) { *p = a; }
+  static inline V set1(double a) { return a; }
+  static inline V add(V a, V b) { return a + b; }
+  static inline V sub(V a, V b) { return a - b; }
+  static inline V mul(V a, V b) { return a * b; }
+  static inline V div(V a, V b) { return a / b; }
+  static inline V sqrt(V a) { return std::sqrt(a); }
+  static inline V fma(V a, V b, V c) { return a * b + c; }
+};
+
+// runs k.step<O>(i) over [0, n), in packets where the target has them
+template <class K>
+inline void run_step(int n, const K& k, const float*) {
+  int i = 0;
+#ifdef CNN_SIMD_PACKET
+  for (; i + packet_ops::width <= n; i += packet_ops::width)
+    k.template step<packet_ops>(i);
+#endif
+  for (; i < n; ++i)
+    k.template step<scalar_ops>(i);
+}
+
+template <class K>
+inline void run_step(int n, const K& k, const double*) {
+  for (int i = 0; i < n; ++i)
+    k.template step<double_ops>(i);
+}
+
+// each of the following reads x, g and the optimizer state once, writes
+// them back once and leaves g at zero. the weight decay is taken from the
+// value of x before the step
+
+template <class T>
+struct sgd_step_kernel {
+  T c, lambda; T* x; T* g;
+  template <class O> inline void step(int i) const {
+    typedef typename O::V V;
+    V xi = O::load(x + i);
+    V d = O::fma(O::set1(c), O::load(g + i), O::mul(O::set1(lambda), xi));
+    O::store(x + i, O::sub(xi, d));
+    O::store(g + i, O::set1(0));
+  }
+};
+
+template <class T>
+struct momentum_step_kernel {
+  T c, lambda, momentum; T* x; T* g; T* v;
+  template <class O> inline void step(int i) const {
+    typedef typename O::V V;
+    V xi = O::load(x + i);
+    V vi = O::sub(O::mul(O::set1(momentum), O::load(v + i)), O::mul(O::set1(c), O::load(g + i)));
+    O::store(v + i, vi);
+    O::store(x + i, O::sub(O::add(xi, vi), O::mul(O::set1(lambda), xi)));
+    O::store(g + i, O::set1(0));
+  }
+};
+
+template <class T>
+struct adagrad_step_kernel {
+  T c, lambda, epsilon; T* x; T* g; T* h;
+  template <class O> inline void step(int i) const {
+    typedef typename O::V V;
+    V xi = O::load(x + i);
+    V gi = O::load(g + i);
+    V hi = O::fma(gi, gi, O::load(h + i));
+    O::store(h + i, hi);
+    V delta = O::div(O::mul(O::set1(c), gi), O::sqrt(O::add(hi, O::set1(epsilon))));
+    O::store(x + i, O::sub(xi, O::fma(O::set1(lambda), xi, delta)));
+    O::store(g + i, O::set1(0));
+  }
+};
+
+template <class T>
+struct adadelta_step_kernel {
+  T c, lambda, rho, epsilon; T* x; T* g; T* hg; T* hd;
+  template <class O> inline void step(int i) const {
+    typedef typename O::V V;
+    const V r = O::set1(rho), r1 = O::set1(1 - rho), e = O::set1(epsilon);
+    V xi = O::load(x + i);
+    V gi = O::mul(O::set1(c), O::load(g + i));
+    V hgi = O::fma(r1, O::mul(gi, gi), O::mul(r, O::load(hg + i)));
+    O::store(hg + i, hgi);
+    V hdi = O::load(hd + i);
+    V delta = O::div(O::mul(gi, O::sqrt(O::add(hdi, e))), O::sqrt(O::add(hgi, e)));
+    O::store(hd + i, O::fma(r1, O::mul(delta, delta), O::mul(r, hdi)));
+    O::store(x + i, O::sub(xi, O::fma(O::set1(lambda), xi, delta)));
+    O::store(g + i, O::set1(0));
+  }
+};
+
+template <class T>
+struct adam_step_kernel {
+  T c, lambda, beta_1, beta_2, s1, s2, eta, eps; T* x; T* g; T* m; T* v;
+  template <class O> inline void step(int i) const {
+    typedef typename O::V V;
+    V xi = O::load(x + i);
+    V gi = O::mul(O::set1(c), O::load(g + i));
+    V mi = O::fma(O::set1(1 - beta_1), gi, O::mul(O::set1(beta_1), O::load(m + i)));
+    V vi = O::fma(O::set1(1 - beta_2), O::mul(gi, gi), O::mul(O::set1(beta_2), O::load(v + i)));
+    O::store(m + i, mi);
+    O::store(v + i, vi);
+    V den = O::add(O::sqrt(O::div(vi, O::set1(s2))), O::set1(eps));
+    V delta = O::div(O::mul(O::set1(eta / s1), mi), den);
+    O::store(x + i, O::sub(xi, O::fma(O::set1(lambda), xi, delta)));
+    O::store(g + i, O::set1(0));
+  }
+};
+
+} // namespace
+
+#define CNN_SIMD_STEPS(T)                                                                       \
+  void vsgd_step(int n, T c, T lambda, T* x, T* g) {                                            \
+    run_step(n, sgd_step_kernel<T>{ c, lambda, x, g }, x);                                      \
+  }                                                                                             \
+  void vmomentum_step(int n, T c, T lambda, T momentum, T* x, T* g, T* v) {                     \
+    run_step(n, momentum_step_kernel<T>{ c, lambda, momentum, x, g, v }, x);                    \
+  }                                                                                             \
+  void vadagrad_step(int n, T c, T lambda, T epsilon, T* x, T* g, T* h) {                       \
+    run_step(n, adagrad_step_kernel<T>{ c, lambda, epsilon, x, g, h }, x);                      \
+  }                                                                                             \
+  void vadadelta_step(int n, T c, T lambda, T rho, T epsilon, T* x, T* g, T* hg, T* hd) {       \
+    run_step(n, adadelta_step_kernel<T>{ c, lambda, rho, epsilon, x, g, hg, hd }, x);           \
+  }                                                                                             \
+  void vadam_step(int n, T c, T lambda, T beta_1, T beta_2, T s1, T s2, T eta, T eps,           \
+                  T* x, T* g, T* m, T* v) {                                                     \
+    run_step(n, adam_step_kernel<T>{ c, lambda, beta_1, beta_2, s1, s2, eta, eps, x, g, m, v }, x); \
+  }
+
+CNN_SIMD_STEPS(float)
+CNN_SIMD_STEPS(double)
+
+#undef CNN_SIMD_STEPS
+
+float vexp_sum(int n, const float* x, float shift, float* y) {
+  int i = 0;
+  float sum = 0;
+#ifdef CNN_SIMD_PACKET
+  packet_ops::V s = packet_ops::set1(shift);
+  packet_ops::V acc = packet_ops::set1(0.0f);
+  for (; i + packet_ops::width <= n; i += packet_ops::width) {
+    packet_ops::V e = exp_kernel<packet_ops>(packet_ops::sub(packet_ops::load(x + i), s));
+    packet_ops::store(y + i, e);
+    acc = packet_ops::add(acc, e);
+  }
+  sum = packet_ops::hsum(acc);
+#endif
+  for (; i < n; ++i)
+    sum += (y[i] = exp_kernel<scalar_ops>(x[i] - shift));
+  return sum;
+}
+
+float vsum_exp(int n, const float* x, float shift) {
+  int i = 0;
+  float sum = 0;
+#ifdef CNN_SIMD_PACKET
+  packet_ops::V s = packet_ops::set1(shift);
+  packet_ops::V acc = packet_ops::set1(0.0f);
+  for (; i + packet_ops::width <= n; i += packet_ops::width)
+    acc = packet_ops::add(acc, exp_kernel<packet_ops>(packet_ops::sub(packet_ops::load(x + i), s)));
+  sum = packet_ops::hsum(acc);
+#endif
+  for (; i < n; ++i)
+    sum += exp_kernel<scalar_ops>(x[i] - shift);
+  return sum;
+}
+
+void vaxpy_exp(int n, float a, const float* x, float shift, float* y) {
+  int i = 0;
+#ifdef CNN_SIMD_PACKET
+  packet_ops::V s = packet_ops::set1(shift);
+  packet_ops::V pa = packet_ops::set1(a);
+  for (; i + packet_ops::width <= n; i += packet_ops::width) {
+    packet_ops::V e = exp_kernel<packet_ops>(packet_ops::sub(packet_ops::load(x + i), s));
+    packet_ops::store(y + i, packet_ops::fma(pa, e, packet_ops::load(y + i)));
+  }
+#endif
+  for (; i < n; ++i)
+    y[i] += a * exp_kernel<scalar_ops>(x[i] - shift);
+}
+
+void vexp(int n, const double* x, double* y) {
+  for (int i = 0; i < n; ++i) y[i] = std::exp(x[i]);
+}
+
+double vexp_sum(int n, const double* x, double shift, double* y) {
+  double sum = 0;
+  for (int i = 0; i < n; ++i) sum += (y[i] = std::exp(x[i] - shift));
+  return sum;
+}
+
+double vsum_exp(int n, const double* x, double shift) {
+  double sum = 0;
+  for (int i = 0; i < n; ++i) sum += std::exp(x[i] - shift);
+  return sum;
+}
+
+void vaxpy_exp(int n, double a, const double* x, double shift, double* y) {
+  for (int i = 0; i < n; ++i) y[i] += a * std::exp(x[i] - shift);
+}
+
+void vlog(int n, const double* x, double* y) {
+  for (int i = 0; i < n; ++i) y[i] = std::log(x[i]);
+}
+
+void vtanh(int n, const double* x, double* y) {
+  for (int i = 0; i < n; ++i) y[i] = std::tanh(x[i]);
+}
+
+void vsigmoid(int n, const double* x, double* y) {
+  for (int i = 0; i < n; ++i) y[i] = 1.0 / (1.0 + std::exp(-x[i]));
+}
+
+} // namespace simd
+} // namespace cnn
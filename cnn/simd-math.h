@@ -0,0 +1,79 @@
+#ifndef CNN_SIMD_MATH_H
+#define CNN_SIMD_MATH_H
+
+// vectorized transcendental functions over contiguous arrays, used by the CPU
+// softmax, log-softmax and activation nodes.
+//
+// the single precision versions evaluate a polynomial on packets of 16
+// (AVX-512) or 8 (AVX2 + FMA) floats, whichever the compiler targets, and the
+// same polynomial one element at a time for the remainder or on other
+// hardware. they follow the Cephes single precision routines:
+//   vexp      relative error below 1.5e-7 (about 1 ulp). inf above 88.72;
+//             0 where the result would be subnormal, below -87.33, as the
+//             flush to zero of -Ofast would give anyway
+//   vlog      absolute error below 5e-8 on [0.5, 2] and relative error
+//             below 2e-7 elsewhere, subnormal inputs included; log(0) = -inf,
+//             log(inf) = inf, log(x < 0) = NaN
+//   vtanh     absolute error below 1.5e-7; exactly +-1 where tanh rounds there
+//   vsigmoid  relative error below 3e-7; exactly 1 above 18, 0 below -87.33
+// measured against double precision over the whole input range, see
+// tests/test_simd.cc. NaN inputs give NaN in all four, so a diverging model
+// is not masked by the clamps.
+// the double precision versions call the standard library.
+//
+// the v*_step functions below are the optimizer updates of the trainers in
+// training.h, each fused into one pass that reads and writes the parameter x,
+// its gradient g and the optimizer state once. c scales the gradient (learning
+// rate, clipping scale and the normalization by the number of samples, as far
+// as the trainer applies them), lambda is the weight decay, taken from x
+// before the step, and g is left at zero.
+
+namespace cnn {
+namespace simd {
+
+// y = exp(x)
+void vexp(int n, const float* x, float* y);
+void vexp(int n, const double* x, double* y);
+// y = exp(x - shift); returns the sum of y
+float vexp_sum(int n, const float* x, float shift, float* y);
+double vexp_sum(int n, const double* x, double shift, double* y);
+// returns the sum of exp(x - shift) without storing it
+float vsum_exp(int n, const float* x, float shift);
+double vsum_exp(int n, const double* x, double shift);
+// y += a * exp(x - shift)
+void vaxpy_exp(int n, float a, const float* x, float shift, float* y);
+void vaxpy_exp(int n, double a, const double* x, double shift, double* y);
+// y = log(x)
+void vlog(int n, const float* x, float* y);
+void vlog(int n, const double* x, double* y);
+// y = tanh(x)
+void vtanh(int n, const float* x, float* y);
+void vtanh(int n, const double* x, double* y);
+// y = 1 / (1 + exp(-x))
+void vsigmoid(int n, const float* x, float* y);
+void vsigmoid(int n, const double* x, double* y);
+
+// x -= c g + lambda x
+void vsgd_step(int n, float c, float lambda, float* x, float* g);
+void vsgd_step(int n, double c, double lambda, double* x, double* g);
+// v = momentum v - c g; x += v - lambda x
+void vmomentum_step(int n, float c, float lambda, float momentum, float* x, float* g, float* v);
+void vmomentum_step(int n, double c, double lambda, double momentum, double* x, double* g, double* v);
+// h += g^2; x -= c g / sqrt(h + epsilon) + lambda x
+void vadagrad_step(int n, float c, float lambda, float epsilon, float* x, float* g, float* h);
+void vadagrad_step(int n, double c, double lambda, double epsilon, double* x, double* g, double* h);
+// with g' = c g: hg = rho hg + (1 - rho) g'^2; d = g' sqrt(hd + epsilon) / sqrt(hg + epsilon);
+// hd = rho hd + (1 - rho) d^2; x -= d + lambda x
+void vadadelta_step(int n, float c, float lambda, float rho, float epsilon, float* x, float* g, float* hg, float* hd);
+void vadadelta_step(int n, double c, double lambda, double rho, double epsilon, double* x, double* g, double* hg, double* hd);
+// with g' = c g: m = beta_1 m + (1 - beta_1) g'; v = beta_2 v + (1 - beta_2) g'^2;
+// x -= eta (m / s1) / (sqrt(v / s2) + eps) + lambda x, s1 and s2 being the bias corrections
+void vadam_step(int n, float c, float lambda, float beta_1, float beta_2, float s1, float s2, float eta, float eps,
+                float* x, float* g, float* m, float* v);
+void vadam_step(int n, double c, double lambda, double beta_1, double beta_2, double s1, double s2, double eta, double eps,
+                double* x, double* g, double* m, double* v);
+
+} // namespace simd
+} // namespace cnn
+
+#endif
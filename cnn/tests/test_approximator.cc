@@ -0,0 +1,129 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "CNNApproximator"
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "cnn/tests/test_utils.h"
+#include "cnn/approximator.h"
+#include "cnn/cnn.h"
+#include "cnn/expr.h"
+#include "cnn/model.h"
+#include "cnn/random.h"
+
+using namespace std;
+using namespace cnn;
+using namespace cnn::expr;
+
+BOOST_GLOBAL_FIXTURE(TestTensorSetup);
+
+BOOST_AUTO_TEST_CASE(HuffmanRespondMatchesPathLoss) {
+  const unsigned dim = 3;
+  const vector<cnn::real> counts = { 10, 1, 4, 7, 2 };
+  Model m;
+  HuffmanSoftmaxBuilder hs(dim, counts, m, 0.5f);
+  const vector<cnn::real> x = { 0.3f, -0.7f, 0.2f };
+
+  vector<cnn::real> dist;
+  {
+    ComputationGraph cg;
+    hs.new_graph(cg);
+    dist = hs.respond(input(cg, Dim({ dim }), x), cg);
+  }
+  BOOST_REQUIRE_EQUAL(dist.size(), counts.size());
+  double total = 0;
+  for (auto lp : dist) total += exp(lp);
+  BOOST_CHECK_CLOSE(total, 1.0, 1e-3);
+
+  // the loss of each word is the negative of its log probability
+  for (unsigned w = 0; w < counts.size(); ++w) {
+    ComputationGraph cg;
+    hs.new_graph(cg);
+    auto err = hs.add_input(input(cg, Dim({ dim }), x), vector<long>(1, w));
+    BOOST_REQUIRE_EQUAL(err.size(), 1u);
+    BOOST_CHECK_SMALL(as_scalar(cg.get_value(err[0].i)) + dist[w], 1e-4f);
+  }
+
+  auto best = hs.top_k(x, 2);
+  BOOST_REQUIRE_EQUAL(best.size(), 2u);
+  BOOST_CHECK_SMALL(best[0].second - *max_element(dist.begin(), dist.end()), 1e-4f);
+}
+
+BOOST_AUTO_TEST_CASE(HuffmanRejectsUnknownWords) {
+  Model m;
+  HuffmanSoftmaxBuilder hs(2, { 1, 2, 3 }, m, 0.5f);
+  ComputationGraph cg;
+  hs.new_graph(cg);
+  vector<cnn::real> x = { 0.1f, 0.2f };
+  BOOST_CHECK_THROW(hs.add_input(input(cg, Dim({ 2 }), x), vector<long>(1, 3)), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(AliasSamplerMatchesDistribution) {
+  const vector<cnn::real> weights = { 5, 0, 1, 12, 3, 0.5f, 7 };
+  AliasSampler sampler(weights);
+  BOOST_REQUIRE_EQUAL(sampler.size(), weights.size());
+  const double total = 28.5;
+  const unsigned n = 200000;
+  vector<unsigned> counts(weights.size(), 0);
+  mt19937 eng(17);
+  for (unsigned k = 0; k < n; ++k) ++counts[sampler.sample(eng)];
+  for (unsigned i = 0; i < weights.size(); ++i) {
+    const double p = weights[i] / total;
+    BOOST_CHECK_CLOSE(sampler.probability(i), p, 1e-4);
+    // within five standard deviations of the binomial count
+    BOOST_CHECK_SMALL(counts[i] - n * p, 5 * sqrt(n * p * (1 - p)) + 1e-9);
+  }
+  BOOST_CHECK_THROW(AliasSampler(vector<cnn::real>(3, 0)), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(SampledSoftmaxLossMatchesCorrectedScores) {
+  const unsigned dim = 3, nsamples = 6;
+  const vector<cnn::real> counts = { 8, 1, 3, 5 };
+  const cnn::real power = 0.75f;
+  Model m;
+  SampledSoftmaxBuilder ss(dim, counts, nsamples, m, 0.5f, "", power);
+  // three utterances in the columns of x, the second without a target
+  const vector<cnn::real> x = { 0.3f, -0.7f, 0.2f, 1.0f, 1.0f, 1.0f, -0.4f, 0.1f, 0.9f };
+  const vector<long> targets = { 0, -1, 3 };
+
+  // the noise words add_input will draw, from the same sampler and generator state
+  vector<cnn::real> weights;
+  for (auto c : counts) weights.push_back(pow(c, power));
+  AliasSampler noise(weights);
+  rndeng->seed(5);
+  mt19937 eng = *rndeng;
+  vector<unsigned> smp;
+  for (unsigned k = 0; k < nsamples; ++k) smp.push_back(noise.sample(eng));
+
+  ComputationGraph cg;
+  ss.new_graph(cg);
+  ss.set_data_in_parallel(targets.size());
+  auto err = ss.add_input(input(cg, Dim({ dim, 3 }), x), targets);
+  BOOST_REQUIRE_EQUAL(err.size(), 2u);
+
+  const auto& luts = m.lookup_parameters_list();
+  auto score = [&](unsigned w, unsigned u) {
+    auto r = as_vector(luts[0]->values[w]);
+    double s = as_vector(luts[1]->values[w])[0] - log(nsamples * noise.probability(w));
+    for (unsigned i = 0; i < dim; ++i) s += r[i] * x[u * dim + i];
+    return s;
+  };
+  bool masked = false;
+  for (unsigned j = 0; j < 2; ++j) {
+    const unsigned u = j * 2;
+    const unsigned t = targets[u];
+    // the target against the sampled words, without the copies of the target
+    double z = exp(score(t, u));
+    for (auto w : smp) {
+      if (w == t)
+        masked = true;
+      else
+        z += exp(score(w, u));
+    }
+    BOOST_CHECK_CLOSE(as_scalar(cg.get_value(err[j].i)), log(z) - score(t, u), 1e-3);
+  }
+  // the seed draws a target, so the mask is exercised
+  BOOST_CHECK(masked);
+}
@@ -0,0 +1,266 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "CNNExec"
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "cnn/tests/test_utils.h"
+#include "cnn/aligned-mem-pool.h"
+#include "cnn/cnn.h"
+#include "cnn/exec.h"
+#include "cnn/expr.h"
+#include "cnn/init.h"
+#include "cnn/model.h"
+
+using namespace std;
+using namespace cnn;
+using namespace cnn::expr;
+
+BOOST_GLOBAL_FIXTURE(TestTensorSetup);
+
+namespace {
+
+// a graph that is wide enough for several threads: a chain of fused LSTM
+// steps, a dozen independent affine branches on it and an attention over its
+// outputs, all summed into one scalar loss
+struct WideNet {
+  static const unsigned IN = 4, HIDDEN = 5, STEPS = 6, BRANCHES = 12;
+  Model m;
+  Parameters *wx, *wh, *b, *c2i, *c2o, *va;
+  vector<Parameters*> w, bias;
+  vector<vector<cnn::real>> xs;
+
+  WideNet() {
+    wx = m.add_parameters({ 3 * HIDDEN, IN });
+    wh = m.add_parameters({ 3 * HIDDEN, HIDDEN });
+    b = m.add_parameters({ 3 * HIDDEN });
+    c2i = m.add_parameters({ HIDDEN, HIDDEN });
+    c2o = m.add_parameters({ HIDDEN, HIDDEN });
+    va = m.add_parameters({ HIDDEN });
+    for (unsigned k = 0; k < BRANCHES; ++k) {
+      w.push_back(m.add_parameters({ HIDDEN, HIDDEN }));
+      bias.push_back(m.add_parameters({ HIDDEN }));
+    }
+    for (unsigned t = 0; t < STEPS; ++t) {
+      vector<cnn::real> x(IN);
+      for (unsigned i = 0; i < IN; ++i) x[i] = 0.1f * (t + 1) - 0.2f * i;
+      xs.push_back(x);
+    }
+  }
+
+  // with keep_steps, the hidden states are kept for recompute_values
+  void build(ComputationGraph& cg, bool keep_steps = false) {
+    build_loss(cg, build_steps(cg, keep_steps));
+  }
+
+  // the LSTM chain; returns its hidden states
+  vector<Expression> build_steps(ComputationGraph& cg, bool keep_steps = false) {
+    Expression ewx = parameter(cg, wx), ewh = parameter(cg, wh), eb = parameter(cg, b);
+    Expression ec2i = parameter(cg, c2i), ec2o = parameter(cg, c2o);
+    vector<Expression> hs;
+    Expression c, h;
+    for (unsigned t = 0; t < STEPS; ++t) {
+      Expression x = input(cg, Dim({ IN }), xs[t]);
+      Expression ch = (t == 0) ? lstm_cell(x, ewx, eb) : lstm_cell(x, h, c, ewx, ewh, eb, ec2i, ec2o);
+      c = columnslices(ch, HIDDEN, 0, 1);
+      h = columnslices(ch, HIDDEN, 1, 2);
+      if (keep_steps) cg.keep_value(ch);
+      hs.push_back(h);
+    }
+    return hs;
+  }
+
+  // the branches and the attention on the hidden states hs
+  void build_loss(ComputationGraph& cg, const vector<Expression>& hs) {
+    const Expression& h = hs.back();
+    vector<Expression> losses;
+    for (unsigned k = 0; k < BRANCHES; ++k) {
+      Expression y = tanh(affine_transform({ parameter(cg, bias[k]), parameter(cg, w[k]), hs[k % STEPS] }));
+      losses.push_back(dot_product(y, hs[(k + 1) % STEPS]));
+    }
+    Expression keys = concatenate_cols(hs);
+    Expression att = mlp_attention(keys, h, parameter(cg, va), keys, 0, STEPS, 0);
+    losses.push_back(sum_cols(reshape(att, Dim({ 1, HIDDEN + STEPS }))));
+    sum(losses);
+  }
+
+  // a loss on hs with other nodes and parameters than build_loss, some of them kept
+  void build_other_loss(ComputationGraph& cg, const vector<Expression>& hs) {
+    vector<Expression> losses;
+    for (unsigned k = 0; k < BRANCHES; k += 3) {
+      Expression y = logistic(parameter(cg, w[k]) * hs[k % STEPS]);
+      cg.keep_value(y);
+      Expression d = y - parameter(cg, bias[k]);
+      losses.push_back(dot_product(d, d));
+    }
+    sum(losses);
+  }
+
+  // the loss and the gradients of all parameters after one forward and backward;
+  // with incremental, only the nodes not evaluated yet are run forward
+  vector<cnn::real> run(ComputationGraph& cg, bool incremental = false) {
+    m.reset_gradient();
+    vector<cnn::real> out(1, as_scalar(incremental ? cg.incremental_forward() : cg.forward()));
+    cg.backward();
+    for (auto p : m.parameters_list()) {
+      auto g = as_vector(p->g);
+      out.insert(out.end(), g.begin(), g.end());
+    }
+    return out;
+  }
+};
+
+void check_same(const vector<cnn::real>& expected, const vector<cnn::real>& actual) {
+  BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+  for (unsigned k = 0; k < expected.size(); ++k)
+    BOOST_CHECK_SMALL(expected[k] - actual[k], 1e-5f);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(ParallelEngineMatchesSimple) {
+  WideNet net;
+  vector<cnn::real> expected;
+  {
+    ComputationGraph cg;
+    net.build(cg);
+    expected = net.run(cg);
+  }
+  for (unsigned threads : { 2u, 4u }) {
+    ComputationGraph cg;
+    auto ee = new ParallelExecutionEngine(cg, threads);
+    ee->min_parallel_nodes = 0;
+    cg.set_execution_engine(ee);
+    net.build(cg);
+    check_same(expected, net.run(cg));
+    // a second pass on the same graph must not see stale state
+    check_same(expected, net.run(cg));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MemoryReuseMatchesDefault) {
+  WideNet net;
+  vector<cnn::real> expected;
+  {
+    ComputationGraph cg;
+    net.build(cg);
+    expected = net.run(cg);
+  }
+  for (t_memory_reuse mode : { reuse_gradients, recompute_values }) {
+    ComputationGraph cg;
+    cg.set_memory_reuse(mode);
+    net.build(cg);
+    check_same(expected, net.run(cg));
+    check_same(expected, net.run(cg));
+  }
+  {
+    ComputationGraph cg;
+    cg.set_memory_reuse(recompute_values);
+    net.build(cg, true);
+    check_same(expected, net.run(cg));
+  }
+  {
+    // only the loss survives a forward pass here, and nothing is differentiated
+    ComputationGraph cg;
+    cg.set_memory_reuse(reuse_values_and_gradients);
+    net.build(cg);
+    BOOST_CHECK_SMALL(expected[0] - as_scalar(cg.forward()), 1e-5f);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ParallelEngineRejectsMemoryReuse) {
+  ComputationGraph cg;
+  cg.set_execution_engine(new ParallelExecutionEngine(cg, 2));
+  BOOST_CHECK_THROW(cg.set_memory_reuse(recompute_values), std::invalid_argument);
+  cg.set_memory_reuse(no_memory_reuse);
+}
+
+BOOST_AUTO_TEST_CASE(RollbackMatchesFreshGraph) {
+  WideNet net;
+  vector<cnn::real> expected;
+  {
+    ComputationGraph cg;
+    net.build(cg);
+    expected = net.run(cg);
+  }
+  for (unsigned threads : { 1u, 2u }) {
+    for (bool keep_steps : { false, true }) {
+      ComputationGraph cg;
+      if (threads > 1) {
+        auto ee = new ParallelExecutionEngine(cg, threads);
+        ee->min_parallel_nodes = 0;
+        cg.set_execution_engine(ee);
+      }
+      vector<Expression> hs = net.build_steps(cg, keep_steps);
+      cg.incremental_forward();
+      GraphCheckpoint c = cg.checkpoint();
+      // a branch that is evaluated and differentiated, then dropped
+      net.build_other_loss(cg, hs);
+      net.run(cg, true);
+      cg.rollback(c);
+      BOOST_CHECK_EQUAL(cg.nodes.size(), c.num_nodes);
+      net.build_loss(cg, hs);
+      check_same(expected, net.run(cg, true));
+      // one that is dropped without being evaluated, after a full forward
+      cg.rollback(c);
+      net.build_other_loss(cg, hs);
+      cg.rollback(c);
+      net.build_loss(cg, hs);
+      check_same(expected, net.run(cg));
+      // and the same checkpoint once more, after the values were recomputed
+      net.build_other_loss(cg, hs);
+      net.run(cg);
+      cg.rollback(c);
+      net.build_loss(cg, hs);
+      check_same(expected, net.run(cg, true));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PoolTrimsToHighWaterMark) {
+  const unsigned long kb = 1 << 10;
+  AlignedMemoryPool<ALIGN> pool(4 * kb);
+  for (unsigned k = 0; k < 6; ++k) pool.allocate(3 * kb);
+  BOOST_CHECK_EQUAL(pool.high_water_mark(), 18 * kb);
+  BOOST_CHECK_GT(pool.reserved_memory(), 18 * kb);
+  const unsigned long grown = pool.reserved_memory();
+  // the mark stays at the peak after the pool is freed and used less
+  pool.free();
+  pool.allocate(kb);
+  BOOST_CHECK_EQUAL(pool.high_water_mark(), 18 * kb);
+  // in use, only the chunks after the current one go
+  pool.trim();
+  BOOST_CHECK_EQUAL(pool.high_water_mark(), kb);
+  BOOST_CHECK_LE(pool.reserved_memory(), grown);
+  BOOST_CHECK_GE(pool.reserved_memory(), kb);
+  // empty, the pool shrinks to its peak, but not below the initial capacity
+  pool.free();
+  pool.allocate(6 * kb);
+  pool.free();
+  pool.trim();
+  BOOST_CHECK_EQUAL(pool.reserved_memory(), 6 * kb);
+  BOOST_CHECK_EQUAL(pool.high_water_mark(), 0u);
+  pool.allocate(kb);
+  pool.free();
+  pool.trim();
+  BOOST_CHECK_EQUAL(pool.reserved_memory(), 4 * kb);
+}
+
+BOOST_AUTO_TEST_CASE(TrimMemoryPoolsKeepsResults) {
+  WideNet net;
+  vector<cnn::real> expected;
+  {
+    ComputationGraph cg;
+    net.build(cg);
+    expected = net.run(cg);
+  }
+  const unsigned long peak = fxs->high_water_mark() + dEdfs->high_water_mark() + mem_nodes->high_water_mark();
+  BOOST_CHECK_GT(peak, 0u);
+  BOOST_CHECK_EQUAL(TrimMemoryPools(), peak);
+  // the values of the last graph stay until the next forward pass frees them
+  BOOST_CHECK_EQUAL(fxs->high_water_mark(), fxs->used_memory());
+  BOOST_CHECK_EQUAL(dEdfs->high_water_mark(), dEdfs->used_memory());
+  ComputationGraph cg;
+  net.build(cg);
+  check_same(expected, net.run(cg));
+}
@@ -0,0 +1,186 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "CNNNodes"
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "cnn/tests/test_utils.h"
+#include "cnn/cnn.h"
+#include "cnn/expr.h"
+#include "cnn/model.h"
+
+using namespace std;
+using namespace cnn;
+using namespace cnn::expr;
+
+BOOST_GLOBAL_FIXTURE(TestTensorSetup);
+
+// a scalar that depends on every element of y with a different weight, so
+// that a gradient sent to the wrong element shows up in check_grad
+static Expression weighted_sum(const Expression& y) {
+  const Dim& d = y.pg->nodes[y.i]->dim;
+  const unsigned n = d.size();
+  vector<cnn::real> w(n);
+  for (unsigned k = 0; k < n; ++k) w[k] = 0.5f + 0.25f * (k % 5) - 0.1f * k / n;
+  return dot_product(tanh(reshape(y, Dim({ n }))), input(*y.pg, Dim({ n }), w));
+}
+
+BOOST_AUTO_TEST_CASE(LSTMCellGradient) {
+  const unsigned in = 3, hidden = 4, n = 2;
+  Model m;
+  auto px = m.add_parameters({ in, n }), ph = m.add_parameters({ hidden, n }), pc = m.add_parameters({ hidden, n });
+  auto pwx = m.add_parameters({ 3 * hidden, in }), pwh = m.add_parameters({ 3 * hidden, hidden });
+  auto pb = m.add_parameters({ 3 * hidden }), pc2i = m.add_parameters({ hidden, hidden }), pc2o = m.add_parameters({ hidden, hidden });
+  ComputationGraph cg;
+  Expression y = lstm_cell(parameter(cg, px), parameter(cg, ph), parameter(cg, pc), parameter(cg, pwx),
+                           parameter(cg, pwh), parameter(cg, pb), parameter(cg, pc2i), parameter(cg, pc2o));
+  weighted_sum(y);
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+// the gradients of all parameters of m after a backward pass on cg
+static vector<cnn::real> backward_gradients(Model& m, ComputationGraph& cg) {
+  m.reset_gradient();
+  cg.backward();
+  vector<cnn::real> g;
+  for (auto p : m.parameters_list()) {
+    auto v = as_vector(p->g);
+    g.insert(g.end(), v.begin(), v.end());
+  }
+  return g;
+}
+
+BOOST_AUTO_TEST_CASE(LSTMCellRepeatedBackward) {
+  const unsigned in = 3, hidden = 4, n = 2;
+  Model m;
+  auto px = m.add_parameters({ in, n }), ph = m.add_parameters({ hidden, n }), pc = m.add_parameters({ hidden, n });
+  auto pwx = m.add_parameters({ 3 * hidden, in }), pwh = m.add_parameters({ 3 * hidden, hidden });
+  auto pb = m.add_parameters({ 3 * hidden }), pc2i = m.add_parameters({ hidden, hidden }), pc2o = m.add_parameters({ hidden, hidden });
+  ComputationGraph cg;
+  Expression y = lstm_cell(parameter(cg, px), parameter(cg, ph), parameter(cg, pc), parameter(cg, pwx),
+                           parameter(cg, pwh), parameter(cg, pb), parameter(cg, pc2i), parameter(cg, pc2o));
+  weighted_sum(y);
+  cg.forward();
+  // the gate gradients shared by the arguments of one pass are computed
+  // again by the next pass, and by the next forward
+  const auto expected = backward_gradients(m, cg);
+  const auto again = backward_gradients(m, cg);
+  BOOST_REQUIRE_EQUAL(expected.size(), again.size());
+  for (unsigned k = 0; k < expected.size(); ++k) BOOST_CHECK_EQUAL(expected[k], again[k]);
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(LSTMCellFirstStepGradient) {
+  Model m;
+  auto px = m.add_parameters({ 3, 2 }), pwx = m.add_parameters({ 12, 3 }), pb = m.add_parameters({ 12 });
+  ComputationGraph cg;
+  weighted_sum(lstm_cell(parameter(cg, px), parameter(cg, pwx), parameter(cg, pb)));
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(GRUCellGradient) {
+  const unsigned in = 3, hidden = 4, n = 2;
+  Model m;
+  auto px = m.add_parameters({ in, n }), ph = m.add_parameters({ hidden, n });
+  auto pwx = m.add_parameters({ 3 * hidden, in }), pwh = m.add_parameters({ 2 * hidden, hidden });
+  auto ph2h = m.add_parameters({ hidden, hidden }), pb = m.add_parameters({ 3 * hidden });
+  ComputationGraph cg;
+  Expression y = gru_cell(parameter(cg, px), parameter(cg, ph), parameter(cg, pwx), parameter(cg, pwh),
+                          parameter(cg, ph2h), parameter(cg, pb));
+  weighted_sum(y);
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(GRUCellRepeatedBackward) {
+  const unsigned in = 3, hidden = 4, n = 2;
+  Model m;
+  auto px = m.add_parameters({ in, n }), ph = m.add_parameters({ hidden, n });
+  auto pwx = m.add_parameters({ 3 * hidden, in }), pwh = m.add_parameters({ 2 * hidden, hidden });
+  auto ph2h = m.add_parameters({ hidden, hidden }), pb = m.add_parameters({ 3 * hidden });
+  ComputationGraph cg;
+  Expression y = gru_cell(parameter(cg, px), parameter(cg, ph), parameter(cg, pwx), parameter(cg, pwh),
+                          parameter(cg, ph2h), parameter(cg, pb));
+  weighted_sum(y);
+  cg.forward();
+  const auto expected = backward_gradients(m, cg);
+  const auto again = backward_gradients(m, cg);
+  BOOST_REQUIRE_EQUAL(expected.size(), again.size());
+  for (unsigned k = 0; k < expected.size(); ++k) BOOST_CHECK_EQUAL(expected[k], again[k]);
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(GRUCellFirstStepGradient) {
+  Model m;
+  auto px = m.add_parameters({ 3, 2 }), pwx = m.add_parameters({ 12, 3 }), pb = m.add_parameters({ 12 });
+  ComputationGraph cg;
+  weighted_sum(gru_cell(parameter(cg, px), parameter(cg, pwx), parameter(cg, pb)));
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(HierarchicalSoftmaxPathGradient) {
+  const unsigned d = 4;
+  Model m;
+  auto px = m.add_parameters({ d, 2 }), pnodes = m.add_parameters({ d + 1, 5 });
+  ComputationGraph cg;
+  // a path of two steps for the first column and of three for the second
+  weighted_sum(hierarchical_softmax_path(parameter(cg, px), parameter(cg, pnodes), { 0, 2, 5 }, { 1, -1, -1, 1, 1 }));
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(PickNegLogSoftmaxGradient) {
+  Model m;
+  auto px = m.add_parameters({ 4, 3 });
+  ComputationGraph cg;
+  weighted_sum(pickneglogsoftmax(parameter(cg, px), { 2, PickNegLogSoftmax::NO_INDEX, 0 }));
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(PickNegLogSoftmaxRejectsBatches) {
+  ComputationGraph cg;
+  Expression x = input(cg, Dim({ 4, 2 }, 3), vector<cnn::real>(24, 0.5f));
+  BOOST_CHECK_THROW(pickneglogsoftmax(x, { 1, 2 }), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(MLPAttentionGradient) {
+  const unsigned a = 3, d = 2;
+  Model m;
+  auto pkeys = m.add_parameters({ a, 5 }), pqueries = m.add_parameters({ a, 2 });
+  auto pva = m.add_parameters({ a }), pvalues = m.add_parameters({ d, 3 });
+  ComputationGraph cg;
+  weighted_sum(mlp_attention(parameter(cg, pkeys), parameter(cg, pqueries), parameter(cg, pva), parameter(cg, pvalues),
+                             1, 3, 1, 2.0f));
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(SelectRowsGradient) {
+  Model m;
+  auto px = m.add_parameters({ 5, 3 });
+  ComputationGraph cg;
+  // a repeated row must get the sum of both gradients
+  weighted_sum(select_rows(parameter(cg, px), { 3, 0, 3 }));
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(PickRangeGradient) {
+  Model m;
+  auto px = m.add_parameters({ 6 });
+  ComputationGraph cg;
+  weighted_sum(pickrange(parameter(cg, px), 1, 4));
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(ColumnSlicesGradient) {
+  Model m;
+  auto px = m.add_parameters({ 4, 5 });
+  ComputationGraph cg;
+  weighted_sum(columnslices(parameter(cg, px), 4, 1, 3));
+  BOOST_CHECK(check_grad(m, cg));
+}
+
+BOOST_AUTO_TEST_CASE(ReshapeGradient) {
+  Model m;
+  auto px = m.add_parameters({ 3, 4 });
+  ComputationGraph cg;
+  weighted_sum(reshape(tanh(parameter(cg, px)), Dim({ 2, 6 })));
+  BOOST_CHECK(check_grad(m, cg));
+}
@@ -0,0 +1,172 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "CNNRnn"
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "cnn/tests/test_utils.h"
+#include "cnn/cnn.h"
+#include "cnn/dglstm.h"
+#include "cnn/expr.h"
+#include "cnn/gru.h"
+#include "cnn/lstm.h"
+#include "cnn/model.h"
+#include "cnn/rnn.h"
+
+using namespace std;
+using namespace cnn;
+using namespace cnn::expr;
+
+BOOST_GLOBAL_FIXTURE(TestTensorSetup);
+
+namespace {
+
+const unsigned LAYERS = 2, IN = 3, HIDDEN = 4, STEPS = 5;
+
+// nutt sequences in parallel, one column each
+vector<vector<cnn::real>> inputs(unsigned nutt) {
+  vector<vector<cnn::real>> xs;
+  for (unsigned t = 0; t < STEPS; ++t) {
+    vector<cnn::real> x(IN * nutt);
+    for (unsigned i = 0; i < IN * nutt; ++i) x[i] = 0.3f * t - 0.25f * (i % IN) + 0.1f * (i / IN + 1);
+    xs.push_back(x);
+  }
+  return xs;
+}
+
+// how run_rnn feeds the steps: add_input, add_sequence, or add_input with the
+// previous states passed as prev_history
+enum Steps { ADD_INPUT, ADD_SEQUENCE, PREV_HISTORY };
+
+// the loss and the gradients of all parameters of an RNN over a sequence,
+// with the steps added as given by steps, computed by an engine that
+// recycles memory as given by mode, for nutt sequences in parallel
+vector<cnn::real> run_rnn(Model& m, RNNBuilder& rnn, Steps steps, bool initial_state,
+                          t_memory_reuse mode = no_memory_reuse, unsigned nutt = 1) {
+  const auto xs = inputs(nutt);
+  ComputationGraph cg;
+  cg.set_memory_reuse(mode);
+  rnn.set_data_in_parallel(nutt);
+  rnn.new_graph(cg);
+  vector<Expression> h0;
+  if (initial_state) {
+    for (unsigned k = 0; k < rnn.num_h0_components(); ++k) {
+      vector<cnn::real> v(HIDDEN * nutt);
+      for (unsigned i = 0; i < HIDDEN * nutt; ++i) v[i] = 0.2f * k - 0.1f * i;
+      h0.push_back(input(cg, Dim({ HIDDEN, nutt }), v));
+    }
+  }
+  vector<Expression> x, hs;
+  for (unsigned t = 0; t < STEPS; ++t) x.push_back(input(cg, Dim({ IN, nutt }), xs[t]));
+  if (steps == PREV_HISTORY) {
+    // the initial state, or none, is the history of the first step only
+    rnn.start_new_sequence();
+    for (unsigned t = 0; t < STEPS; ++t) hs.push_back(rnn.add_input(t == 0 ? h0 : rnn.final_s(), x[t]));
+  } else {
+    rnn.start_new_sequence(h0);
+    if (steps == ADD_SEQUENCE) {
+      hs = rnn.add_sequence(x);
+    } else {
+      for (unsigned t = 0; t < STEPS; ++t) hs.push_back(rnn.add_input(x[t]));
+    }
+  }
+  vector<Expression> losses;
+  vector<cnn::real> w(HIDDEN * nutt);
+  for (unsigned i = 0; i < HIDDEN * nutt; ++i) w[i] = 1.0f - 0.3f * (i % HIDDEN) + 0.1f * (i / HIDDEN);
+  auto weighted = [&](const Expression& h) {
+    return dot_product(reshape(h, Dim({ HIDDEN * nutt })), input(cg, Dim({ HIDDEN * nutt }), w));
+  };
+  for (unsigned t = 0; t < STEPS; ++t) losses.push_back(weighted(hs[t]));
+  // the final states of all layers take part as well
+  for (auto& s : rnn.final_s()) losses.push_back(weighted(s));
+  sum(losses);
+
+  m.reset_gradient();
+  vector<cnn::real> out(1, as_scalar(cg.forward()));
+  cg.backward();
+  for (auto p : m.parameters_list()) {
+    auto g = as_vector(p->g);
+    out.insert(out.end(), g.begin(), g.end());
+  }
+  return out;
+}
+
+vector<cnn::real> run_lstm(Model& m, LSTMBuilder& lstm, bool fused, Steps steps, bool initial_state,
+                           t_memory_reuse mode = no_memory_reuse) {
+  lstm.fused_cell = fused;
+  return run_rnn(m, lstm, steps, initial_state, mode);
+}
+
+vector<cnn::real> run_gru(Model& m, GRUBuilder& gru, bool fused, Steps steps, bool initial_state) {
+  gru.fused_cell = fused;
+  return run_rnn(m, gru, steps, initial_state);
+}
+
+void check_same(const vector<cnn::real>& expected, const vector<cnn::real>& actual) {
+  BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+  for (unsigned k = 0; k < expected.size(); ++k)
+    BOOST_CHECK_SMALL(expected[k] - actual[k], 1e-4f);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(FusedLSTMMatchesUnfused) {
+  Model m;
+  LSTMBuilder lstm(LAYERS, { IN, HIDDEN }, &m);
+  for (bool initial_state : { false, true }) {
+    const auto expected = run_lstm(m, lstm, false, ADD_INPUT, initial_state);
+    check_same(expected, run_lstm(m, lstm, true, ADD_INPUT, initial_state));
+    check_same(expected, run_lstm(m, lstm, true, ADD_SEQUENCE, initial_state));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PrevHistoryMatchesAddInput) {
+  Model m;
+  LSTMBuilder lstm(LAYERS, { IN, HIDDEN }, &m);
+  for (bool initial_state : { false, true }) {
+    const auto expected = run_lstm(m, lstm, false, ADD_INPUT, initial_state);
+    check_same(expected, run_lstm(m, lstm, false, PREV_HISTORY, initial_state));
+    check_same(expected, run_lstm(m, lstm, true, PREV_HISTORY, initial_state));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(RecomputeValuesMatchesDefault) {
+  Model m;
+  LSTMBuilder lstm(LAYERS, { IN, HIDDEN }, &m);
+  for (bool fused : { false, true }) {
+    const auto expected = run_lstm(m, lstm, fused, ADD_INPUT, true);
+    // without kept values backward evaluates the whole graph again, with the
+    // states kept at every step it evaluates one step at a time
+    for (bool keep : { false, true }) {
+      lstm.set_keep_states(keep);
+      check_same(expected, run_lstm(m, lstm, fused, ADD_INPUT, true, recompute_values));
+      check_same(expected, run_lstm(m, lstm, fused, ADD_SEQUENCE, true, recompute_values));
+    }
+    lstm.set_keep_states(false);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FusedGRUMatchesUnfused) {
+  Model m;
+  GRUBuilder gru(LAYERS, { IN, HIDDEN }, &m);
+  for (bool initial_state : { false, true }) {
+    const auto expected = run_gru(m, gru, false, ADD_INPUT, initial_state);
+    check_same(expected, run_gru(m, gru, true, ADD_INPUT, initial_state));
+    check_same(expected, run_gru(m, gru, true, ADD_SEQUENCE, initial_state));
+  }
+}
+
+// builders with their own add_sequence_impl must match add_input step by step,
+// also with several sequences in parallel, where each step is a column slice
+BOOST_AUTO_TEST_CASE(AddSequenceMatchesAddInput) {
+  Model m;
+  GRUBuilder gru(LAYERS, { IN, HIDDEN }, &m);
+  DGLSTMBuilder dglstm(LAYERS, { IN, HIDDEN }, &m);
+  SimpleRNNBuilder rnn(LAYERS, { IN, HIDDEN }, &m);
+  for (RNNBuilder* b : std::initializer_list<RNNBuilder*>{ &gru, &dglstm, &rnn }) {
+    for (bool initial_state : { false, true })
+      for (unsigned nutt : { 1u, 3u })
+        check_same(run_rnn(m, *b, ADD_INPUT, initial_state, no_memory_reuse, nutt),
+                   run_rnn(m, *b, ADD_SEQUENCE, initial_state, no_memory_reuse, nutt));
+  }
+}
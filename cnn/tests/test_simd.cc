@@ -0,0 +1,137 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "CNNSimd"
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "cnn/simd-math.h"
+
+using namespace std;
+using namespace cnn;
+
+namespace {
+
+// the library is built with -Ofast, which lets the compiler assume that no
+// value is inf or NaN, so these look at the bits
+uint32_t bits(float a) { uint32_t i; memcpy(&i, &a, sizeof(i)); return i; }
+float from_bits(uint32_t i) { float a; memcpy(&a, &i, sizeof(a)); return a; }
+bool is_nan(float a) { return (bits(a) & 0x7fffffff) > 0x7f800000; }
+bool is_inf(float a, bool negative) { return bits(a) == (negative ? 0xff800000u : 0x7f800000u); }
+// the exact value of a in double, also for a subnormal a, which -Ofast reads as zero
+double exact(float a) {
+  if (bits(a) & 0x7f800000) return a;
+  double m = ldexp((double)(bits(a) & 0x007fffff), -149);
+  return (bits(a) & 0x80000000) ? -m : m;
+}
+
+const float inf = numeric_limits<float>::infinity();
+const float nan_value = numeric_limits<float>::quiet_NaN();
+const double smallest_normal = numeric_limits<float>::min();
+
+typedef void (*vfun)(int, const float*, float*);
+
+// f over xs, once in packets and once one element at a time, the way the
+// remainder of a packet loop is computed
+vector<vector<float>> both_paths(vfun f, const vector<float>& xs) {
+  vector<float> packed(xs.size()), single(xs.size());
+  f((int)xs.size(), xs.data(), packed.data());
+  for (unsigned k = 0; k < xs.size(); ++k) f(1, &xs[k], &single[k]);
+  return { packed, single };
+}
+
+// checks f against ref over xs: with a relative error below rel where the
+// reference is a normal float, and an absolute error below abs everywhere.
+// results below the normal range may be flushed to zero
+void check_accuracy(vfun f, double (*ref)(double), const vector<float>& xs, double rel, double abs) {
+  for (const auto& ys : both_paths(f, xs)) {
+    for (unsigned k = 0; k < xs.size(); ++k) {
+      const double r = ref(exact(xs[k]));
+      const double y = exact(ys[k]);
+      if (fabs(r) < smallest_normal) {
+        BOOST_CHECK_MESSAGE(fabs(y - r) <= smallest_normal, "f(" << xs[k] << ") = " << y << ", expected " << r);
+      } else {
+        BOOST_CHECK_MESSAGE(fabs(y - r) <= max(rel * fabs(r), abs), "f(" << xs[k] << ") = " << y << ", expected " << r);
+      }
+    }
+  }
+}
+
+vector<float> linspace(float a, float b, unsigned n) {
+  vector<float> xs(n);
+  for (unsigned k = 0; k < n; ++k) xs[k] = a + (b - a) * k / (n - 1);
+  return xs;
+}
+
+double sigmoid(double x) { return 1 / (1 + exp(-x)); }
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(ExpMatchesLibm) {
+  // up to the largest input with a finite result
+  check_accuracy(simd::vexp, exp, linspace(-103.9f, 88.72f, 20001), 1.5e-7, 0);
+}
+
+BOOST_AUTO_TEST_CASE(ExpOutsideTheFloatRange) {
+  const vector<float> xs = { 88.8f, 100.0f, 1e10f, inf, -104.0f, -1000.0f, -inf };
+  for (const auto& ys : both_paths(simd::vexp, xs)) {
+    for (unsigned k = 0; k < 4; ++k) BOOST_CHECK_MESSAGE(is_inf(ys[k], false), "exp(" << xs[k] << ") = " << ys[k]);
+    for (unsigned k = 4; k < xs.size(); ++k) BOOST_CHECK_EQUAL(bits(ys[k]), 0u);
+  }
+  // below the normal range the result is subnormal, or flushed to zero
+  float x = -100.0f, y;
+  simd::vexp(1, &x, &y);
+  BOOST_CHECK_SMALL(exact(y) - exp(-100.0), smallest_normal);
+}
+
+BOOST_AUTO_TEST_CASE(LogMatchesLibm) {
+  vector<float> xs = linspace(0.01f, 4.0f, 5001);
+  // every binade, at a few mantissas, and subnormals of every magnitude;
+  // from the bits, since -Ofast arithmetic would flush the subnormals
+  for (uint32_t e = 1; e < 255; ++e)
+    for (uint32_t m : { 0x000000u, 0x0ccccdu, 0x3504f3u, 0x400000u, 0x7eb852u })
+      xs.push_back(from_bits(e << 23 | m));
+  for (uint32_t m = 1; m < 0x800000u; m = 3 * m + 1) xs.push_back(from_bits(m));
+  xs.push_back(numeric_limits<float>::max());
+  xs.push_back(numeric_limits<float>::min());
+  xs.push_back(numeric_limits<float>::denorm_min());
+  xs.push_back(1e-40f);
+  check_accuracy(simd::vlog, log, xs, 2e-7, 5e-8);
+}
+
+BOOST_AUTO_TEST_CASE(LogSpecialValues) {
+  const vector<float> xs = { 0.0f, -0.0f, inf, -1.0f, -1e-40f, -inf };
+  for (const auto& ys : both_paths(simd::vlog, xs)) {
+    BOOST_CHECK(is_inf(ys[0], true));
+    BOOST_CHECK(is_inf(ys[1], true));
+    BOOST_CHECK(is_inf(ys[2], false));
+    for (unsigned k = 3; k < xs.size(); ++k) BOOST_CHECK_MESSAGE(is_nan(ys[k]), "log(" << xs[k] << ") = " << ys[k]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TanhMatchesLibm) {
+  check_accuracy(simd::vtanh, tanh, linspace(-20.0f, 20.0f, 20001), 0, 1.5e-7);
+  for (const auto& ys : both_paths(simd::vtanh, { inf, -inf, 1e30f }))
+    BOOST_CHECK(ys[0] == 1.0f && ys[1] == -1.0f && ys[2] == 1.0f);
+}
+
+BOOST_AUTO_TEST_CASE(SigmoidMatchesLibm) {
+  check_accuracy(simd::vsigmoid, sigmoid, linspace(-100.0f, 40.0f, 20001), 3e-7, 0);
+  for (const auto& ys : both_paths(simd::vsigmoid, { inf, -inf, 200.0f, -200.0f })) {
+    BOOST_CHECK_EQUAL(ys[0], 1.0f);
+    BOOST_CHECK_EQUAL(bits(ys[1]), 0u);
+    BOOST_CHECK_EQUAL(ys[2], 1.0f);
+    BOOST_CHECK_EQUAL(bits(ys[3]), 0u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(NaNPropagates) {
+  const vector<float> xs(3, nan_value);
+  for (vfun f : initializer_list<vfun>{ simd::vexp, simd::vlog, simd::vtanh, simd::vsigmoid })
+    for (const auto& ys : both_paths(f, xs))
+      for (float y : ys) BOOST_CHECK(is_nan(y));
+}
@@ -0,0 +1,275 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "CNNTrainer"
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include "cnn/tests/test_utils.h"
+#include "cnn/cnn.h"
+#include "cnn/expr.h"
+#include "cnn/model.h"
+#include "cnn/simd-math.h"
+#include "cnn/training.h"
+
+using namespace std;
+using namespace cnn;
+using namespace cnn::expr;
+
+BOOST_GLOBAL_FIXTURE(TestTensorSetup);
+
+namespace {
+
+const unsigned IN = 3, OUT = 2, VOCAB = 4, MICRO_BATCHES = 3;
+
+// a linear model on an embedded word, with the same initial values every time
+struct Net {
+  Model m;
+  Parameters* w;
+  LookupParameters* emb;
+
+  Net() {
+    w = m.add_parameters({ OUT, IN });
+    emb = m.add_lookup_parameters(VOCAB, { IN });
+    for (unsigned k = 0; k < OUT * IN; ++k) w->values.v[k] = 0.1f * k - 0.2f;
+    for (unsigned j = 0; j < VOCAB; ++j)
+      for (unsigned k = 0; k < IN; ++k) emb->values[j].v[k] = 0.05f * (j + 1) - 0.1f * k;
+  }
+
+  // the loss of micro-batch b, which has b + 1 samples
+  Expression loss(ComputationGraph& cg, unsigned b) {
+    vector<Expression> losses;
+    for (unsigned s = 0; s <= b; ++s) {
+      Expression y = parameter(cg, w) * lookup(cg, emb, (b + s) % VOCAB);
+      vector<cnn::real> target = { 0.5f * s, -0.25f * b };
+      losses.push_back(squared_distance(y, input(cg, Dim({ OUT }), target)));
+    }
+    return sum(losses);
+  }
+
+  // a loss linear in the rows of words, so that the gradient of a row does
+  // not depend on its value, whether or not its missed updates were applied
+  Expression words_loss(ComputationGraph& cg, const vector<unsigned>& words) {
+    vector<Expression> losses;
+    for (unsigned j : words) {
+      vector<cnn::real> c = { 0.3f * j - 0.4f, 0.2f, -0.1f * j };
+      losses.push_back(dot_product(lookup(cg, emb, j), input(cg, Dim({ IN }), c)));
+    }
+    return sum(losses);
+  }
+
+  vector<cnn::real> values() {
+    vector<cnn::real> v = as_vector(w->values);
+    for (unsigned j = 0; j < VOCAB; ++j) {
+      auto e = as_vector(emb->values[j]);
+      v.insert(v.end(), e.begin(), e.end());
+    }
+    return v;
+  }
+};
+
+cnn::real samples(unsigned b) { return b + 1.0f; }
+
+template <class T>
+void check_accumulation() {
+  // one update on the summed loss of all micro-batches
+  Net whole;
+  T whole_sgd(&whole.m);
+  {
+    ComputationGraph cg;
+    vector<Expression> losses;
+    cnn::real nutt = 0;
+    for (unsigned b = 0; b < MICRO_BATCHES; ++b) {
+      losses.push_back(whole.loss(cg, b));
+      nutt += samples(b);
+    }
+    sum(losses);
+    cg.forward();
+    cg.backward();
+    whole_sgd.update(nutt);
+  }
+
+  // the same micro-batches, each on a graph of its own, with step() and flush()
+  Net split;
+  T split_sgd(&split.m);
+  split_sgd.accumulation_steps = MICRO_BATCHES + 1;
+  const vector<cnn::real> before = split.values();
+  for (unsigned b = 0; b < MICRO_BATCHES; ++b) {
+    ComputationGraph cg;
+    split.loss(cg, b);
+    cg.forward();
+    cg.backward();
+    BOOST_CHECK(!split_sgd.step(samples(b)));
+  }
+  BOOST_CHECK_EQUAL(split_sgd.pending_micro_batches(), MICRO_BATCHES);
+  // nothing is applied before the flush
+  const vector<cnn::real> pending = split.values();
+  for (unsigned k = 0; k < before.size(); ++k) BOOST_CHECK_EQUAL(before[k], pending[k]);
+  BOOST_CHECK(split_sgd.flush());
+  BOOST_CHECK_EQUAL(split_sgd.pending_micro_batches(), 0u);
+
+  const vector<cnn::real> expected = whole.values(), actual = split.values();
+  BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+  for (unsigned k = 0; k < expected.size(); ++k) {
+    BOOST_CHECK_SMALL(expected[k] - actual[k], 1e-5f);
+  }
+  // the update did move the parameters
+  BOOST_CHECK_NE(before[0], actual[0]);
+}
+
+// with sparse_lookup_updates a row that has no gradient is left alone, and the
+// updates it missed are caught up in closed form when it has one again. that
+// must give the same values as updating every row at every step, with a zero
+// gradient where there is none. the loss is linear in the rows, so reading a
+// row before it is caught up does not change its gradient
+template <class T, class... Args>
+void check_sparse_catch_up(Args... args) {
+  const unsigned SKIPPED = 5;
+  Net sparse, dense;
+  T sparse_sgd(&sparse.m, args...), dense_sgd(&dense.m, args...);
+  sparse_sgd.sparse_lookup_updates = true;
+  const Tensor zero = dense.emb->values[0];
+  for (unsigned u = 0; u < SKIPPED + 2; ++u) {
+    // row 1 is trained first, then only row 2 for a while, then all rows
+    vector<unsigned> words = { 2 };
+    if (u == 0) words = { 1 };
+    if (u == SKIPPED + 1) words = { 0, 1, 2, 3 };
+    {
+      ComputationGraph cg;
+      sparse.words_loss(cg, words);
+      cg.forward();
+      cg.backward();
+      sparse_sgd.update(1.0);
+    }
+    {
+      ComputationGraph cg;
+      dense.words_loss(cg, words);
+      cg.forward();
+      cg.backward();
+      vector<cnn::real> z(IN, 0);
+      Tensor tz(zero.d, z.data(), zero.m_device_id);
+      for (unsigned j = 0; j < VOCAB; ++j) dense.emb->accumulate_grad(j, tz);
+      dense_sgd.update(1.0);
+    }
+  }
+  const vector<cnn::real> expected = dense.values(), actual = sparse.values();
+  BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+  for (unsigned k = 0; k < expected.size(); ++k)
+    BOOST_CHECK_SMALL(expected[k] - actual[k], 1e-5f);
+}
+
+
+// a parameter, its gradient and two state vectors of optimizer, with a
+// length that leaves a remainder after the packets of the fused kernels
+template <class T>
+struct StepState {
+  static const int N = 37;
+  vector<T> x, g, s1, s2;
+  StepState() {
+    for (int k = 0; k < N; ++k) {
+      x.push_back(T(0.3 * sin(k + 1.0)));
+      g.push_back(T(0.5 * cos(2.0 * k) - 0.1));
+      s1.push_back(T(0.01 * (k % 5)));
+      s2.push_back(T(0.002 * (k % 7) + 0.001));
+    }
+  }
+};
+
+// runs step on a fresh state and checks it against the per-element update
+// ref(x, g, s1, s2) of the trainers before their steps were fused, in double
+template <class T, class Step, class Ref>
+void check_step(const Step& step, const Ref& ref) {
+  StepState<T> st, expected;
+  step(st);
+  for (int k = 0; k < StepState<T>::N; ++k) {
+    double x = expected.x[k], g = expected.g[k], s1 = expected.s1[k], s2 = expected.s2[k];
+    ref(x, g, s1, s2);
+    BOOST_CHECK_CLOSE((double)st.x[k], x, 1e-3);
+    BOOST_CHECK_CLOSE((double)st.s1[k] + 1, s1 + 1, 1e-3);
+    BOOST_CHECK_CLOSE((double)st.s2[k] + 1, s2 + 1, 1e-3);
+    BOOST_CHECK_EQUAL(st.g[k], T(0));
+  }
+}
+
+template <class T>
+void check_fused_steps() {
+  const T c = T(0.07), lambda = T(1e-3), momentum = T(0.9), epsilon = T(1e-6), rho = T(0.95);
+  check_step<T>([&](StepState<T>& st) { simd::vsgd_step(st.N, c, lambda, st.x.data(), st.g.data()); },
+                [&](double& x, double& g, double&, double&) { x -= c * g + x * lambda; });
+  check_step<T>([&](StepState<T>& st) {
+                  simd::vmomentum_step(st.N, c, lambda, momentum, st.x.data(), st.g.data(), st.s1.data());
+                },
+                [&](double& x, double& g, double& v, double&) {
+                  double reg = x * lambda;
+                  v = momentum * v - c * g;
+                  x += v - reg;
+                });
+  check_step<T>([&](StepState<T>& st) {
+                  simd::vadagrad_step(st.N, c, lambda, epsilon, st.x.data(), st.g.data(), st.s1.data());
+                },
+                [&](double& x, double& g, double& h, double&) {
+                  double reg = x * lambda;
+                  h += g * g;
+                  x += -c * g / sqrt(h + epsilon) - reg;
+                });
+  check_step<T>([&](StepState<T>& st) {
+                  simd::vadadelta_step(st.N, c, lambda, rho, epsilon, st.x.data(), st.g.data(), st.s1.data(), st.s2.data());
+                },
+                [&](double& x, double& g, double& hg, double& hd) {
+                  double gs = c * g, reg = x * lambda;
+                  hg = rho * hg + (1.0 - rho) * gs * gs;
+                  double delta = -gs * sqrt(hd + epsilon) / sqrt(hg + epsilon);
+                  hd = rho * hd + (1.0 - rho) * delta * delta;
+                  x += delta - reg;
+                });
+  const T beta_1 = T(0.9), beta_2 = T(0.999), eta = T(0.01), eps = T(1e-8);
+  const T s1 = T(1 - pow(0.9, 3)), s2 = T(1 - pow(0.999, 3));
+  check_step<T>([&](StepState<T>& st) {
+                  simd::vadam_step(st.N, c, lambda, beta_1, beta_2, s1, s2, eta, eps,
+                                   st.x.data(), st.g.data(), st.s1.data(), st.s2.data());
+                },
+                [&](double& x, double& g, double& m, double& v) {
+                  double gs = c * g, reg = x * lambda;
+                  m = beta_1 * m + (1 - beta_1) * gs;
+                  v = beta_2 * v + (1 - beta_2) * gs * gs;
+                  x += -eta * (m / s1) / (sqrt(v / s2) + eps) - reg;
+                });
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(SparseMomentumCatchUpMatchesDense) {
+  check_sparse_catch_up<MomentumSGDTrainer>(0.01f, 0.1f, 0.9f);
+  // momentum == 1 - lambda takes the other branch of the closed form
+  check_sparse_catch_up<MomentumSGDTrainer>(0.1f, 0.1f, 0.9f);
+}
+
+BOOST_AUTO_TEST_CASE(SparseAdagradCatchUpMatchesDense) {
+  check_sparse_catch_up<AdagradTrainer>(0.05f, 0.1f);
+}
+
+BOOST_AUTO_TEST_CASE(AccumulatedSGDMatchesOneBatch) {
+  check_accumulation<SimpleSGDTrainer>();
+}
+
+BOOST_AUTO_TEST_CASE(AccumulatedAdagradMatchesOneBatch) {
+  check_accumulation<AdagradTrainer>();
+}
+
+BOOST_AUTO_TEST_CASE(StepUpdatesEveryAccumulationSteps) {
+  Net net;
+  SimpleSGDTrainer sgd(&net.m);
+  sgd.accumulation_steps = 2;
+  for (unsigned b = 0; b < 4; ++b) {
+    ComputationGraph cg;
+    net.loss(cg, b);
+    cg.forward();
+    cg.backward();
+    BOOST_CHECK_EQUAL(sgd.step(samples(b)), b % 2 == 1);
+  }
+  BOOST_CHECK(!sgd.flush());
+}
+
+BOOST_AUTO_TEST_CASE(FusedStepsMatchReference) {
+  check_fused_steps<float>();
+  check_fused_steps<double>();
+}
@@ -1,6 +1,14 @@
 #ifndef CNN_TEST_UTILS_H_
 #define CNN_TEST_UTILS_H_
 
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "cnn/cnn.h"
+#include "cnn/init.h"
+#include "cnn/model.h"
 #include "cnn/tensor.h"
 
 namespace cnn {
@@ -50,9 +58,11 @@ std::ostream& operator<<(std::ostream& os, const Tensor& T) {
 struct TestTensorSetup {
   TestTensorSetup() {
     int argc = 1;
-    char* p = "foo";
-    char** argv = {&p};
-    cnn::Initialize(argc, argv);
+    char p[] = "foo";
+    char* args[] = { p };
+    char** argv = args;
+    // a fixed seed, and the small memory pools of the demo setting
+    cnn::Initialize(argc, argv, -1, 1234, true);
   }
 };
 
@@ -60,7 +70,7 @@ double t(const Tensor& T, unsigned i, unsigned j) {
 #if WITH_THPP_BACKEND
   return T.at({i,j});
 #else
-  return T(i, j);
+  return (*T)(i, j);
 #endif
 }
 
@@ -68,10 +78,42 @@ double t(const Tensor& T, unsigned i) {
 #if WITH_THPP_BACKEND
   return T.at({i});
 #else
-  return T(i, 0);
+  return (*T)(i, 0);
 #endif
 }
 
+// compares the gradients that backward() leaves in the parameters of m with
+// central differences of the value of the last node of cg, which must be a
+// scalar. in single precision only a loose tolerance is possible, which still
+// catches a wrong derivative. returns false and reports every element that
+// differs
+inline bool check_grad(Model& m, ComputationGraph& cg, cnn::real delta = 1e-2f,
+                       double atol = 2e-3, double rtol = 2e-2) {
+  m.reset_gradient();
+  cg.forward();
+  cg.backward();
+  bool ok = true;
+  for (auto p : m.parameters_list()) {
+    const std::vector<cnn::real> g = as_vector(p->g);
+    for (unsigned k = 0; k < p->values.d.size(); ++k) {
+      const cnn::real old = p->values.v[k];
+      p->values.v[k] = old + delta;
+      const double right = as_scalar(cg.forward());
+      p->values.v[k] = old - delta;
+      const double left = as_scalar(cg.forward());
+      p->values.v[k] = old;
+      const double numeric = (right - left) / (2 * delta);
+      if (!(std::fabs(numeric - g[k]) <= atol + rtol * std::max(std::fabs(numeric), std::fabs((double)g[k])))) {
+        std::cerr << "gradient of " << p->dim << " parameter, element " << k << ": " << g[k]
+                  << ", numeric " << numeric << std::endl;
+        ok = false;
+      }
+    }
+  }
+  cg.forward();
+  return ok;
+}
+
 #endif
 
 } // namespace cnn
@@ -0,0 +1,126 @@
+#include "cnn/thread-pool.h"
+
+using namespace std;
+
+namespace cnn {
+
+WorkStealingThreadPool::WorkStealingThreadPool(unsigned num_threads) :
+  generation(0), stop(false), active_workers(0), job(nullptr), remaining(0), queued(0), idle(0) {
+  if (num_threads == 0) num_threads = 1;
+  for (unsigned i = 0; i < num_threads; ++i)
+    queues.push_back(unique_ptr<TaskQueue>(new TaskQueue()));
+  // worker 0 is the thread that calls run()
+  for (unsigned i = 1; i < num_threads; ++i)
+    threads.push_back(thread(&WorkStealingThreadPool::worker_loop, this, i));
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  {
+    lock_guard<mutex> lk(m);
+    stop = true;
+  }
+  start_cv.notify_all();
+  for (auto& t : threads) t.join();
+}
+
+void WorkStealingThreadPool::run(const vector<unsigned>& ready, unsigned num_tasks,
+                                 const function<void(unsigned, unsigned)>& run_task) {
+  if (num_tasks == 0) return;
+  job = &run_task;
+  remaining = num_tasks;
+  for (unsigned k = 0; k < ready.size(); ++k)
+    push(k % size(), ready[k]);
+  if (threads.size() > 0) {
+    {
+      lock_guard<mutex> lk(m);
+      ++generation;
+    }
+    start_cv.notify_all();
+  }
+  work(0);
+  // do not hand out the next job while a worker may still look at this one
+  unique_lock<mutex> lk(m);
+  done_cv.wait(lk, [&] { return active_workers == 0; });
+}
+
+void WorkStealingThreadPool::push(unsigned worker, unsigned task) {
+  // counted before it is visible, so that queued never underflows; a worker
+  // that sees it a moment early only looks once more
+  ++queued;
+  {
+    TaskQueue& q = *queues[worker];
+    lock_guard<mutex> lk(q.m);
+    q.tasks.push_back(task);
+  }
+  if (idle > 0) {
+    // a worker in wait_for_task either has not checked queued yet or is waiting
+    { lock_guard<mutex> lk(m); }
+    task_cv.notify_one();
+  }
+}
+
+void WorkStealingThreadPool::wait_for_task() {
+  unique_lock<mutex> lk(m);
+  ++idle;
+  task_cv.wait(lk, [&] { return queued > 0 || remaining == 0; });
+  --idle;
+}
+
+void WorkStealingThreadPool::worker_loop(unsigned worker) {
+  unsigned seen = 0;
+  for (;;) {
+    {
+      unique_lock<mutex> lk(m);
+      start_cv.wait(lk, [&] { return stop || generation != seen; });
+      if (stop) return;
+      seen = generation;
+      ++active_workers;
+    }
+    work(worker);
+    lock_guard<mutex> lk(m);
+    if (--active_workers == 0) done_cv.notify_all();
+  }
+}
+
+void WorkStealingThreadPool::work(unsigned worker) {
+  while (remaining > 0) {
+    unsigned task;
+    if (pop(worker, task) || steal(worker, task)) {
+      (*job.load())(task, worker);
+      if (--remaining == 0) {
+        // wake the workers waiting for a task, the job is done
+        { lock_guard<mutex> lk(m); }
+        task_cv.notify_all();
+      }
+    } else {
+      wait_for_task();
+    }
+  }
+}
+
+bool WorkStealingThreadPool::pop(unsigned worker, unsigned& task) {
+  TaskQueue& q = *queues[worker];
+  lock_guard<mutex> lk(q.m);
+  if (q.tasks.empty()) return false;
+  task = q.tasks.back();
+  q.tasks.pop_back();
+  --queued;
+  return true;
+}
+
+bool WorkStealingThreadPool::steal(unsigned worker, unsigned& task) {
+  const unsigned n = size();
+  for (unsigned k = 1; k < n; ++k) {
+    TaskQueue& q = *queues[(worker + k) % n];
+    lock_guard<mutex> lk(q.m);
+    if (!q.tasks.empty()) {
+      task = q.tasks.front();
+      q.tasks.pop_front();
+      --queued;
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace cnn
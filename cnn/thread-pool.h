@@ -0,0 +1,68 @@
+#ifndef CNN_THREAD_POOL_H_
+#define CNN_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cnn {
+
+// runs a set of tasks with dependencies on a fixed number of threads.
+// every worker owns a deque of ready tasks. a task that becomes ready is pushed
+// to the deque of the worker that finished its last dependency, which then pops
+// it from the back (so that it stays in cache), while idle workers steal from
+// the front of the other deques. the thread calling run() is worker 0.
+// workers without a task sleep on a condition variable until a task is pushed
+// or the job ends, both between jobs and while waiting for a dependency.
+class WorkStealingThreadPool {
+ public:
+  explicit WorkStealingThreadPool(unsigned num_threads);
+  ~WorkStealingThreadPool();
+
+  unsigned size() const { return (unsigned)queues.size(); }
+
+  // executes num_tasks tasks and returns when all of them have finished.
+  // ready holds the tasks without dependencies; run_task(task, worker) must
+  // push() every task it makes ready on the given worker.
+  void run(const std::vector<unsigned>& ready, unsigned num_tasks,
+           const std::function<void(unsigned, unsigned)>& run_task);
+  void push(unsigned worker, unsigned task);
+
+ private:
+  struct TaskQueue {
+    std::mutex m;
+    std::deque<unsigned> tasks;
+  };
+
+  void worker_loop(unsigned worker);
+  void work(unsigned worker);
+  bool pop(unsigned worker, unsigned& task);
+  bool steal(unsigned worker, unsigned& task);
+  // blocks until a task is queued or the job has ended
+  void wait_for_task();
+
+  std::vector<std::unique_ptr<TaskQueue>> queues;
+  std::vector<std::thread> threads;
+
+  std::mutex m;                       // guards generation, stop and active_workers
+  std::condition_variable start_cv;   // a job has started, or the pool stops
+  std::condition_variable task_cv;    // a task was queued, or the job has ended
+  std::condition_variable done_cv;    // the last worker has left the job
+  unsigned generation;
+  bool stop;
+  unsigned active_workers;
+
+  std::atomic<const std::function<void(unsigned, unsigned)>*> job;
+  std::atomic<unsigned> remaining;    // tasks of the job not finished yet
+  std::atomic<unsigned> queued;       // tasks in the deques
+  std::atomic<unsigned> idle;         // workers in wait_for_task
+};
+
+} // namespace cnn
+
+#endif
@@ -1,6 +1,11 @@
 #include "cnn/training.h"
 #include "cnn/data-util.h"
 #include "cnn/gpu-ops.h"
+#include "cnn/simd-math.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace cnn {
 
@@ -10,6 +15,42 @@ extern AlignedMemoryPool<ALIGN>* glb_temp_working_mem ;
 extern AlignedMemoryPool<ALIGN>* glb_temp_lookup_gradient_value_mem;
 extern cnn::real* glb_gpu_accessible_host_mem;
 
+/// the parameter arenas of a packed model, and large parameters, are updated in
+/// blocks of this many elements
+static const long kArenaSweepBlock = 1 << 14;
+
+/**
+runs step(i, k, n) for the elements [k, k + n) of each of params[first, ...),
+in chunks of at most kArenaSweepBlock elements. with OpenMP the chunks are
+spread over its threads; otherwise, or with a single thread, they are run in
+order without building the chunk list. the fused update kernels in simd-math.h
+are run this way, so that the step streams once over the values, the
+gradients and the optimizer state
+*/
+template <class F>
+static void for_each_chunk(const std::vector<Parameters*>& params, unsigned first, const F& step) {
+#ifdef _OPENMP
+  if (omp_get_max_threads() > 1) {
+    vector<pair<unsigned, long>> chunks;
+    for (unsigned i = first; i < params.size(); ++i)
+      for (long k = 0; k < (long)params[i]->values.d.size(); k += kArenaSweepBlock)
+        chunks.push_back(make_pair(i, k));
+#pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < (int)chunks.size(); ++c) {
+      unsigned i = chunks[c].first;
+      long k = chunks[c].second;
+      step(i, k, (int)std::min(kArenaSweepBlock, (long)params[i]->values.d.size() - k));
+    }
+    return;
+  }
+#endif
+  for (unsigned i = first; i < params.size(); ++i) {
+    const long n = params[i]->values.d.size();
+    for (long k = 0; k < n; k += kArenaSweepBlock)
+      step(i, k, (int)std::min(kArenaSweepBlock, n - k));
+  }
+}
+
 template <class Derived>
 bool is_valid(const Eigen::MatrixBase<Derived>& x) {
   return ((x - x).array() == (x - x).array()).all();
@@ -18,6 +59,20 @@ bool is_valid(const Eigen::MatrixBase<Derived>& x) {
 Trainer::~Trainer() {
 }
 
+/**
+catch up the updates that a lookup row missed while it had no gradient:
+k steps of x += v' - lambda * x with v' = momentum * v. with a = 1 - lambda
+and b = momentum this gives x = a^k x + c v with c = sum_{s=1..k} a^{k-s} b^s
+and v = b^k v
+*/
+static void momentum_catch_up(Tensor& x, Tensor& v, unsigned k, cnn::real lambda, cnn::real momentum) {
+  double a = 1.0 - lambda, b = momentum;
+  double ak = pow(a, k), bk = pow(b, k);
+  double c = (fabs(a - b) < 1e-6) ? k * b * pow(a, k - 1.0) : b * (ak - bk) / (a - b);
+  *x = (cnn::real)ak * (*x) + (cnn::real)c * (*v);
+  *v *= (cnn::real)bk;
+}
+
 /** 
 @scale : proportional to the number of samples trained in parallel 
 */
@@ -50,6 +105,24 @@ cnn::real Trainer::clip_gradients(cnn::real samples, cnn::real pre_compued_grd_n
     return gscale;
 }
 
+bool Trainer::step(cnn::real nutt, cnn::real scale) {
+    ++accumulated_batches;
+    accumulated_samples += nutt;
+    if (accumulated_batches < accumulation_steps)
+        return false;
+    return flush(scale);
+}
+
+bool Trainer::flush(cnn::real scale) {
+    if (accumulated_batches == 0)
+        return false;
+    cnn::real samples = accumulated_samples;
+    accumulated_batches = 0;
+    accumulated_samples = 0;
+    update(samples, scale);
+    return true;
+}
+
 void SimpleSGDTrainer::update(cnn::real nutt, cnn::real scale) {
     update(model->lookup_parameters_list(), model->parameters_list(), nutt, scale);
 }
@@ -58,15 +131,31 @@ void SimpleSGDTrainer::update(const std::vector<LookupParameters*> &lookup_param
   const cnn::real gscale = clip_gradients(samples);
   cnn::real nutt_scale = 1.0 / samples;
 
-  for (auto p : params) {
-#if HAVE_CUDA
-    gpu::sgd_update(p->values.d.size(), p->g.v, p->values.v, eta * scale * gscale * nutt_scale, lambda);
+  unsigned first = 0;
+#if !HAVE_CUDA
+  // the packed parameters are updated and cleared with one sweep over the arenas
+  if (&params == &model->parameters_list() && model->num_packed_parameters() > 0) {
+    Tensor values = model->packed_values();
+    Tensor g = model->packed_gradients();
+    const cnn::real c = nutt_scale * (eta * scale * gscale);
+    const long n = values.d.size();
+#pragma omp parallel for
+    for (long k = 0; k < n; k += kArenaSweepBlock)
+      simd::vsgd_step((int)std::min(kArenaSweepBlock, n - k), c, lambda, values.v + k, g.v + k);
+    first = model->num_packed_parameters();
+  }
+
+  for_each_chunk(params, first, [&](unsigned i, long k, int n) {
+    Parameters* p = params[i];
+    simd::vsgd_step(n, nutt_scale * (eta * scale * gscale), lambda, p->values.v + k, p->g.v + k);
+  });
 #else
-    auto reg = (*p->values) * lambda;
-    *p->values -= nutt_scale * (eta * scale * gscale) * *p->g + reg;
-#endif
+  for (unsigned i = first; i < params.size(); ++i) {
+    Parameters* p = params[i];
+    gpu::sgd_update(p->values.d.size(), p->g.v, p->values.v, eta * scale * gscale * nutt_scale, lambda);
     p->clear();
   }
+#endif
 
 #ifdef HAVE_CUDA
   vector<cudaStream_t> streams;
@@ -91,8 +180,7 @@ void SimpleSGDTrainer::update(const std::vector<LookupParameters*> &lookup_param
       gpu::sgd_update(p->values[i].d.size(), p->grads[i].v, p->values[i].v, eta * scale * gscale * nutt_scale, lambda);
 #endif
 #else
-      auto reg = (*p->values[i]) * lambda;
-      *p->values[i] -= *p->grads[i] * (eta * scale * gscale * nutt_scale) + reg;
+      simd::vsgd_step(p->values[i].d.size(), eta * scale * gscale * nutt_scale, lambda, p->values[i].v, p->grads[i].v);
 #endif
     }
     p->clear();
@@ -113,45 +201,46 @@ void MomentumSGDTrainer::update(cnn::real nutt, cnn::real scale) {
   // store the velocity
   if (!velocity_allocated) {
     vp = AllocateShadowParameters(*model);
-    vlp = AllocateShadowLookupParameters(*model);
+    vlp = AllocateShadowLookupParameters(*model, sparse_lookup_updates);
     velocity_allocated = true;
   }
 
   const cnn::real gscale = clip_gradients(nutt);
   cnn::real nutt_scale = 1.0 / nutt;
   unsigned pi = 0;
+#if HAVE_CUDA
   for (auto p : model->parameters_list()) {
     Tensor& v = vp[pi++].h;
-#if HAVE_CUDA
     gpu::sgd_momentum_update(p->values.d.size(), p->g.v, p->values.v, v.v, eta * scale * gscale * nutt_scale, lambda, momentum);
-#else
-    auto reg = *p->values * lambda;
-    (*v) = momentum * (*v) - (eta * scale * gscale*nutt_scale) * (*p->g);
-//    if (verbose)
-//    {
-//        cout << "name= " << p->name << " v= " << p->values.v[0] << " g= " << p->g.v[0] << " dv=" << v.v[0] << endl;
-//    }
-    *p->values += *v - reg;
-#endif
     p->clear();
   }
+#else
+  const vector<Parameters*>& params = model->parameters_list();
+  for_each_chunk(params, 0, [&](unsigned i, long k, int n) {
+    Parameters* p = params[i];
+    simd::vmomentum_step(n, eta * scale * gscale * nutt_scale, lambda, momentum, p->values.v + k, p->g.v + k, vp[i].h.v + k);
+  });
+#endif
   pi = 0;
   for (auto p : model->lookup_parameters_list()) {
-    vector<Tensor>& vx = vlp[pi++].h;
+    ShadowLookupParameters& vx = vlp[pi++];
+    ++vx.steps;
     for (auto g : p->grads) {
         unsigned i = g.first;
 #if HAVE_CUDA
 #ifdef USE_CPU_FOR_LOOKUP_PARAM
-        gpu::sgd_momentum_update(p->values_for_non_zero_grads[i].d.size(), p->grads[i].v, p->values_for_non_zero_grads[i].v, vx[i].v, eta * scale * gscale * nutt_scale, lambda, momentum);
+        gpu::sgd_momentum_update(p->values_for_non_zero_grads[i].d.size(), p->grads[i].v, p->values_for_non_zero_grads[i].v, vx.row(i).v, eta * scale * gscale * nutt_scale, lambda, momentum);
         CUDA_CHECK(cudaMemcpy(p->values[i].v, p->values_for_non_zero_grads[i].v, p->values[i].d.size() * sizeof(cnn::real), cudaMemcpyDeviceToHost));
 #else
-        gpu::sgd_momentum_update(p->values[i].d.size(), p->grads[i].v, p->values[i].v, vx[i].v, eta * scale * gscale * nutt_scale, lambda, momentum);
+        gpu::sgd_momentum_update(p->values[i].d.size(), p->grads[i].v, p->values[i].v, vx.row(i).v, eta * scale * gscale * nutt_scale, lambda, momentum);
 #endif
 #else
-      Tensor& v = vx[i];
-      auto reg = (*p->values[i]) * lambda;
-      (*v) = momentum * (*v) - (eta * scale * gscale*nutt_scale) * (*p->grads[i]);
-      *p->values[i] += *v - reg;
+      Tensor& v = vx.row(i);
+      if (vx.sparse) {
+        unsigned k = vx.skipped(i);
+        if (k > 0) momentum_catch_up(p->values[i], v, k, lambda, momentum);
+      }
+      simd::vmomentum_step(v.d.size(), eta * scale * gscale * nutt_scale, lambda, momentum, p->values[i].v, p->grads[i].v, v.v);
 #endif
     }
     p->clear();
@@ -163,33 +252,30 @@ void AdagradTrainer::update(cnn::real nsamples, cnn::real scale) {
   unsigned pi;
   if (!shadow_params_allocated) {
     vp = AllocateShadowParameters(*model);
-    vlp = AllocateShadowLookupParameters(*model);
+    vlp = AllocateShadowLookupParameters(*model, sparse_lookup_updates);
     shadow_params_allocated = true;
   }
 
-  pi = 0;
   const cnn::real gscale = clip_gradients(nsamples);
-  for (auto p : model->parameters_list()) {
-    Tensor& v = vp[pi++].h;
-    auto reg = (*p->values) * lambda;
-    auto g2 = (*p->g).cwiseProduct(*p->g);
-    (*v) += g2;
-    auto delta = -(eta * scale * gscale) * (*p->g).cwiseQuotient(((*v).array() + epsilon).matrix().cwiseSqrt());
-    *p->values += delta - reg;
-    p->clear();
-  }
+  const vector<Parameters*>& params = model->parameters_list();
+  for_each_chunk(params, 0, [&](unsigned i, long k, int n) {
+    Parameters* p = params[i];
+    simd::vadagrad_step(n, eta * scale * gscale, lambda, epsilon, p->values.v + k, p->g.v + k, vp[i].h.v + k);
+  });
 
   pi = 0;
   for (auto p : model->lookup_parameters_list()) {
-    vector<Tensor>& vx = vlp[pi++].h;
+    ShadowLookupParameters& vx = vlp[pi++];
+    ++vx.steps;
     for (auto g : p->grads) {
       unsigned i = g.first;
-      Tensor& v = vx[i];
-      auto reg = (*p->values[i]) * lambda;
-      auto g2 = (*p->grads[i]).cwiseProduct(*p->grads[i]);
-      (*v) += g2;
-      auto delta = -(eta * scale * gscale) * (*p->grads[i]).cwiseQuotient(((*v).array() + epsilon).matrix().cwiseSqrt());
-      *p->values[i] += delta - reg;
+      Tensor& v = vx.row(i);
+      // the accumulated squares do not decay, only the weight decay is missed
+      if (vx.sparse) {
+        unsigned k = vx.skipped(i);
+        if (k > 0) *p->values[i] *= (cnn::real)pow(1.0 - lambda, k);
+      }
+      simd::vadagrad_step(v.d.size(), eta * scale * gscale, lambda, epsilon, p->values[i].v, p->grads[i].v, v.v);
     }
     p->clear();
   }
@@ -228,23 +314,11 @@ void AdadeltaTrainer::update(cnn::real nutt, cnn::real scale) {
 
   const cnn::real gscale = clip_gradients(nutt);
   cnn::real nutt_scale = 1.0 / nutt;
-  pi = 0;
-  for (auto p : model->parameters_list()) {
-    auto& g = (scale * gscale * nutt_scale) * *p->g;
-    Tensor& hgv = hg[pi].h;
-    Tensor& hdv = hd[pi].h;
-    auto reg = (*p->values) * lambda;
-    auto g2 = g.cwiseProduct(g);
-    *hgv = rho * *hgv + (1.0 - rho) * g2;
-    auto num = -g.cwiseProduct(((*hdv).array() + epsilon).matrix().cwiseSqrt());
-    auto den = ((*hgv).array() + epsilon).matrix().cwiseSqrt();
-    auto delta = num.cwiseQuotient(den);
-    auto d2 = delta.cwiseProduct(delta);
-    *hdv = rho * *hdv + (1.0 - rho) * d2;
-    *p->values += delta - reg;
-    p->clear();
-    pi++;
-  }
+  const vector<Parameters*>& params = model->parameters_list();
+  for_each_chunk(params, 0, [&](unsigned i, long k, int n) {
+    Parameters* p = params[i];
+    simd::vadadelta_step(n, scale * gscale * nutt_scale, lambda, rho, epsilon, p->values.v + k, p->g.v + k, hg[i].h.v + k, hd[i].h.v + k);
+  });
 
   pi = 0;
   for (auto p : model->lookup_parameters_list()) {
@@ -254,16 +328,7 @@ void AdadeltaTrainer::update(cnn::real nutt, cnn::real scale) {
       unsigned i = q.first;
       Tensor& hgv = hgvx[i];
       Tensor& hdv = hdvx[i];
-      auto& g = scale * gscale * nutt_scale * *p->grads[i];
-      auto reg = (*p->values[i]) * lambda;
-      auto g2 = g.cwiseProduct(g);
-      *hgv = rho * *hgv + (1.0 - rho) * g2;
-      auto num = -g.cwiseProduct(((*hdv).array() + epsilon).matrix().cwiseSqrt());
-      auto den = ((*hgv).array() + epsilon).matrix().cwiseSqrt();
-      auto delta = num.cwiseQuotient(den);
-      auto d2 = delta.cwiseProduct(delta);
-      *hdv = rho * *hdv + (1.0 - rho) * d2;
-      *p->values[i] += delta - reg;
+      simd::vadadelta_step(hgv.d.size(), scale * gscale * nutt_scale, lambda, rho, epsilon, p->values[i].v, p->grads[i].v, hgv.v, hdv.v);
     }
     p->clear();
     pi++;
@@ -385,19 +450,25 @@ void RmsPropTrainer::update(cnn::real nutt, cnn::real scale)
   const cnn::real gscale = clip_gradients(nutt, gg);
 
   pi = 0;
+#if HAVE_CUDA
   for (auto p : model->parameters_list()) {
     cnn::real& d2 = hg[pi];
-#if HAVE_CUDA
     gpu::rmsprop_update(p->values.d.size(), p->g.v, p->values.v, &d2, eta * scale * gscale, lambda, rho, epsilon, vpgrd_norm[pi]);
-#else
-    auto reg = (*p->values) * lambda;
-    cnn::real g2 = (*p->g).squaredNorm();
-    d2 = rho * d2 + (1.0 - rho) * g2;
-    *p->values -= ((eta * scale * gscale / sqrt(d2 + epsilon)) * *p->g + reg);
-#endif
     pi++;
     p->clear();
   }
+#else
+  // the squared norms of the gradients are already in vpgrd_norm
+  const vector<Parameters*>& params = model->parameters_list();
+  vector<cnn::real> c(params.size());
+  for (pi = 0; pi < params.size(); ++pi) {
+    hg[pi] = rho * hg[pi] + (1.0 - rho) * vpgrd_norm[pi];
+    c[pi] = eta * scale * gscale / sqrt(hg[pi] + epsilon);
+  }
+  for_each_chunk(params, 0, [&](unsigned i, long k, int n) {
+    simd::vsgd_step(n, c[i], lambda, params[i]->values.v + k, params[i]->g.v + k);
+  });
+#endif
 
   pi = 0;
   int li = 0;
@@ -414,10 +485,8 @@ void RmsPropTrainer::update(cnn::real nutt, cnn::real scale)
         gpu::rmsprop_update(p->values[i].d.size(), p->grads[i].v, p->values[i].v, &d2, eta * scale * gscale, lambda, rho, epsilon, vlgrd_norm[li]);
 #endif
 #else
-        auto reg = (*p->values[i]) * lambda;
-        cnn::real g2 = (*p->grads[i]).squaredNorm();
-        d2 = rho * d2 + (1.0 - rho) * g2;
-        *p->values[i] -= ((eta * scale * gscale  / sqrt(d2 + epsilon)) * *p->grads[i] + reg);
+        d2 = rho * d2 + (1.0 - rho) * vlgrd_norm[li];
+        simd::vsgd_step(p->values[i].d.size(), eta * scale * gscale / sqrt(d2 + epsilon), lambda, p->values[i].v, p->grads[i].v);
 #endif
       li++;
     }
@@ -464,23 +533,25 @@ void RmsPropWithMomentumTrainer::update(cnn::real nutt, cnn::real scale) {
     /// during the following rmsprop_momentum_update, g.v will be normalized with the denominator of the gradient norm
     pi = 0;
 
+#if HAVE_CUDA
     for (auto p : model->parameters_list()) {
         cnn::real& d2 = hg[pi];
         Tensor& v = vp[pi].h;
-#if HAVE_CUDA
         gpu::rmsprop_momentum_update(p->values.d.size(), p->g.v, p->values.v, v.v, &d2, eta * scale * gscale, lambda, momentum, rho, epsilon, vpgrd_norm[pi]);
-#else
-        auto reg = (*p->values) * lambda;
-        cnn::real g2 = vpgrd_norm[pi];
-        d2 = rho * d2 + (1.0 - rho) * g2;
-
-        (*v) = momentum * (*v) - (eta * scale * gscale / sqrt(d2 + epsilon)) * *p->g;
-
-        *p->values += *v - reg; 
-#endif
         pi++;
         p->clear();
     }
+#else
+    const vector<Parameters*>& params = model->parameters_list();
+    vector<cnn::real> c(params.size());
+    for (pi = 0; pi < params.size(); ++pi) {
+        hg[pi] = rho * hg[pi] + (1.0 - rho) * vpgrd_norm[pi];
+        c[pi] = eta * scale * gscale / sqrt(hg[pi] + epsilon);
+    }
+    for_each_chunk(params, 0, [&](unsigned i, long k, int n) {
+        simd::vmomentum_step(n, c[i], lambda, momentum, params[i]->values.v + k, params[i]->g.v + k, vp[i].h.v + k);
+    });
+#endif
 
     pi = 0;
     int li = 0; 
@@ -503,11 +574,8 @@ void RmsPropWithMomentumTrainer::update(cnn::real nutt, cnn::real scale) {
             gpu::rmsprop_momentum_update(p->values[i].d.size(), p->grads[i].v, p->values[i].v, v.v, &d2, eta * scale * gscale, lambda, momentum, rho, epsilon, vlgrd_norm[li]);
 #endif
 #else
-            auto reg = (*p->values[i]) * lambda;
-            cnn::real g2 = vlgrd_norm[li];
-            d2 = rho * d2 + (1.0 - rho) * g2;
-            (*v) = momentum * (*v) - (eta * scale * gscale  / sqrt(d2 + epsilon)) * *p->grads[i];
-            *p->values[i] += *v - reg; 
+            d2 = rho * d2 + (1.0 - rho) * vlgrd_norm[li];
+            simd::vmomentum_step(v.d.size(), eta * scale * gscale / sqrt(d2 + epsilon), lambda, momentum, p->values[i].v, p->grads[i].v, v.v);
 #endif
             li++;
         }
@@ -618,9 +686,9 @@ void RmsPropWithMomentumTrainerGPU::update(cnn::real nutt, cnn::real scale) {
     cnn::real nutt_scale = 1.0 / nutt;
     pi = 0;
 
+#ifdef HAVE_CUDA
     for (auto p : model->parameters_list()) {
         Tensor& v = vp[pi].h;
-#ifdef HAVE_CUDA
         gpu::rmsprop_smoothing_den(1, rho, vpgrd_each_norm + pi, hg + pi);
 //        display_value(1, hg+pi, "hg=");
 
@@ -629,19 +697,21 @@ void RmsPropWithMomentumTrainerGPU::update(cnn::real nutt, cnn::real scale) {
             v.v, gscale, lambda, eta * scale, momentum, epsilon);
 //        display_value(1, v.v, "v.v=");
 //        display_value(1, p->values.v, "p->values.v=");
-#else
-        auto reg = (*p->values) * lambda;
-        cnn::real g2 = vpgrd_each_norm[pi];
-        hg[pi] = rho * hg[pi] + (1.0 - rho) * g2;
-
-        (*v) = momentum * (*v) - (eta * scale * gscale / sqrt(hg[pi] + epsilon)) * *p->g;
-
-        *p->values += *v - reg;
-#endif
 
         pi++;
         p->clear();
     }
+#else
+    const vector<Parameters*>& params = model->parameters_list();
+    vector<cnn::real> c(params.size());
+    for (pi = 0; pi < params.size(); ++pi) {
+        hg[pi] = rho * hg[pi] + (1.0 - rho) * vpgrd_each_norm[pi];
+        c[pi] = eta * scale * gscale / sqrt(hg[pi] + epsilon);
+    }
+    for_each_chunk(params, 0, [&](unsigned i, long k, int n) {
+        simd::vmomentum_step(n, c[i], lambda, momentum, params[i]->values.v + k, params[i]->g.v + k, vp[i].h.v + k);
+    });
+#endif
 
     pi = 0;
     int li = 0;
@@ -669,11 +739,8 @@ void RmsPropWithMomentumTrainerGPU::update(cnn::real nutt, cnn::real scale) {
                 gscale, lambda, eta * scale, momentum, epsilon);
 #endif
 #else
-            auto reg = (*p->values[i]) * lambda;
-            cnn::real g2 = vlgrd_each_norm[li];
-            *d2 = rho * (*d2) + (1.0 - rho) * g2;
-            (*v) = momentum * (*v) - (eta * scale * gscale / sqrt(*d2 + epsilon)) * *p->grads[i];
-            *p->values[i] += *v - reg;
+            *d2 = rho * (*d2) + (1.0 - rho) * vlgrd_each_norm[li];
+            simd::vmomentum_step(v.d.size(), eta * scale * gscale / sqrt(*d2 + epsilon), lambda, momentum, p->values[i].v, p->grads[i].v, v.v);
 #endif
 
             li++;
@@ -693,54 +760,51 @@ void AdamTrainer::update(cnn::real nutt, cnn::real scale) {
   unsigned pi;
   if (!shadow_params_allocated) {
     m = AllocateShadowParameters(*model);
-    lm = AllocateShadowLookupParameters(*model);
+    lm = AllocateShadowLookupParameters(*model, sparse_lookup_updates);
     v = AllocateShadowParameters(*model);
-    lv = AllocateShadowLookupParameters(*model);
+    lv = AllocateShadowLookupParameters(*model, sparse_lookup_updates);
     shadow_params_allocated = true;
   }
 
   const cnn::real gscale = clip_gradients();
   cnn::real nutt_scale = 1.0 / nutt;
-  pi = 0;
   static unsigned t = 0;
-  for (auto p : model->parameters_list()) {
+  // t advances once per parameter, so each parameter has bias corrections of its own
+  const vector<Parameters*>& params = model->parameters_list();
+  vector<cnn::real> s1(params.size()), s2(params.size());
+  for (pi = 0; pi < params.size(); ++pi) {
     ++t;
-    auto g_t = (scale * gscale * nutt_scale) * *p->g;
-    auto m_t = *m[pi].h;
-    auto v_t = *v[pi].h;
-    auto reg = (*p->values) * lambda;
-    m_t = beta_1 * m_t + (1 - beta_1) * g_t;
-    auto g2 = g_t.cwiseProduct(g_t);
-    v_t = beta_2 * v_t + (1 - beta_2) * g2;
-    cnn::real s1 = 1 - pow(beta_1, t);
-    cnn::real s2 = 1 - pow(beta_2, t);
-    auto mhat = m_t / s1;
-    auto vhat = v_t / s2;
-    auto delta = (-eta * mhat).cwiseQuotient((vhat.array().sqrt() + eps).matrix());
-    *p->values += delta - reg;
-    p->clear();
-    pi++;
+    s1[pi] = 1 - pow(beta_1, t);
+    s2[pi] = 1 - pow(beta_2, t);
   }
+  for_each_chunk(params, 0, [&](unsigned i, long k, int n) {
+    Parameters* p = params[i];
+    simd::vadam_step(n, scale * gscale * nutt_scale, lambda, beta_1, beta_2, s1[i], s2[i], eta, eps,
+                     p->values.v + k, p->g.v + k, m[i].h.v + k, v[i].h.v + k);
+  });
 
   pi = 0;
   for (auto p : model->lookup_parameters_list()) {
-    vector<Tensor>& vm = lm[pi].h;
-    vector<Tensor>& vv = lv[pi].h;
+    ShadowLookupParameters& vm = lm[pi];
+    ShadowLookupParameters& vv = lv[pi];
+    ++vm.steps;
     for (auto g : p->grads) {
       unsigned i = g.first;
-      auto m_t = *vm[i];
-      auto v_t = *vv[i];
-      auto g_t = scale * gscale * nutt_scale * *p->grads[i];
-      auto g2 = g_t.cwiseProduct(g_t);
-      auto reg = (*p->values[i]) * lambda;
-      m_t = beta_1 * m_t + (1 - beta_1) * g_t;
-      v_t = beta_2 * v_t + (1 - beta_2) * g2;
-      cnn::real s1 = 1 - pow(beta_1, t);
-      cnn::real s2 = 1 - pow(beta_2, t);
-      auto mhat = m_t / s1;
-      auto vhat = v_t / s2;
-      auto delta = (-eta * mhat).cwiseQuotient((vhat.array().sqrt() + eps).matrix());
-      *p->values[i] += delta - reg;
+      Tensor& m_t = vm.row(i);
+      Tensor& v_t = vv.row(i);
+      // decay the moments and the weights by the updates the row missed; as
+      // in lazy Adam the steps the decaying moments would have taken are not
+      // replayed
+      if (vm.sparse) {
+        unsigned k = vm.skipped(i);
+        if (k > 0) {
+          *m_t *= (cnn::real)pow(beta_1, k);
+          *v_t *= (cnn::real)pow(beta_2, k);
+          *p->values[i] *= (cnn::real)pow(1.0 - lambda, k);
+        }
+      }
+      simd::vadam_step(m_t.d.size(), scale * gscale * nutt_scale, lambda, beta_1, beta_2, (cnn::real)(1 - pow(beta_1, t)), (cnn::real)(1 - pow(beta_2, t)), eta, eps,
+                       p->values[i].v, p->grads[i].v, m_t.v, v_t.v);
     }
     p->clear();
     pi++;
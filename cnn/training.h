@@ -2,6 +2,7 @@
 #define CNN_TRAINING_H_
 
 #include <vector>
+#include "cnn/init.h"
 #include "cnn/model.h"
 #include "cnn/shadow-params.h"
 
@@ -10,16 +11,36 @@ namespace cnn {
 typedef enum { simple_clipping = 0, norm_clipping = 1 } t_gradient_clipping;
 struct Trainer {
   explicit Trainer(Model* m, cnn::real lam, cnn::real e0) :
-  eta0(e0), eta(e0), eta_decay(), epoch(), lambda(lam), clipping_enabled(true), clip_threshold(5), clips(), updates(), model(m), clipping_type(norm_clipping) {
+  eta0(e0), eta(e0), eta_decay(), epoch(), lambda(lam), clipping_enabled(true), clip_threshold(5), clips(), updates(), model(m), clipping_type(norm_clipping), sparse_lookup_updates(false),
+  accumulation_steps(1), accumulated_batches(0), accumulated_samples(0) {
   }
   virtual ~Trainer();
 
   virtual void update(cnn::real nutt = 1.0, cnn::real scale = 1.0) = 0;
+  /// also trims the memory pools of the calling thread to the peak of the epoch
   void update_epoch(cnn::real r = 1) {
+    flush();
     epoch += r;
     eta = eta0 / (1 + epoch * eta_decay);
+    TrimMemoryPools();
   }
 
+  /**
+  gradient accumulation over micro-batches. call step(nutt) instead of update(nutt)
+  after the backward pass of each micro-batch, each on a graph of its own. the
+  gradients of the micro-batches are summed in the model, and every
+  accumulation_steps micro-batches they are applied with one update normalized by
+  the samples of all of them, as if they had been one batch. only the memory for
+  the graph of one micro-batch is needed at a time.
+  returns true if the step updated the model
+  */
+  bool step(cnn::real nutt = 1.0, cnn::real scale = 1.0);
+  /// applies the gradients of the micro-batches seen since the last update, if any.
+  /// update_epoch() calls this, so the last micro-batches of an epoch are not lost
+  bool flush(cnn::real scale = 1.0);
+  /// the number of micro-batches whose gradients wait for the next update
+  unsigned pending_micro_batches() const { return accumulated_batches; }
+
   // if clipping is enabled and the gradient is too big, return the amount to
   // scale the gradient by (otherwise 1)
   /**
@@ -44,12 +65,27 @@ struct Trainer {
 
   t_gradient_clipping clipping_type; 
 
+  // keep the learner state of lookup parameters only for the rows that have
+  // been trained; the decay and momentum of the updates that a row missed are
+  // applied when the row is seen again. must be set before the first update.
+  // used by MomentumSGDTrainer, AdagradTrainer and AdamTrainer, on the CPU
+  // only: with HAVE_CUDA the first update throws
+  bool sparse_lookup_updates;
+
+  // the number of micro-batches that step() accumulates per update, 1 to update
+  // after every micro-batch
+  unsigned accumulation_steps;
+
   void status() {
     std::cerr << "[epoch=" << epoch << " eta=" << eta << " clips=" << clips << " updates=" << updates << "] ";
     updates = clips = 0;
   }
 
   Model* model;  // parameters and gradients live here
+
+ private:
+  unsigned accumulated_batches;
+  cnn::real accumulated_samples;
 };
 
 struct SimpleSGDTrainer : public Trainer {
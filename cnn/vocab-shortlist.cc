@@ -0,0 +1,88 @@
+#include "cnn/vocab-shortlist.h"
+
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <stdexcept>
+
+using namespace std;
+
+namespace cnn {
+
+VocabularyShortlist::VocabularyShortlist(unsigned vocab_size, unsigned top_n, unsigned max_cooccurring)
+    : vocab_size(vocab_size), top_n(top_n), max_cooccurring(max_cooccurring)
+{
+    if (vocab_size == 0)
+        throw std::invalid_argument("VocabularyShortlist needs a non-empty vocabulary");
+}
+
+void VocabularyShortlist::set_frequent_words(const vector<cnn::real>& counts)
+{
+    if (counts.size() != vocab_size)
+        throw std::invalid_argument("VocabularyShortlist::set_frequent_words expects one count per word");
+    vector<unsigned> idx(vocab_size);
+    iota(idx.begin(), idx.end(), 0);
+    unsigned n = min(top_n, vocab_size);
+    partial_sort(idx.begin(), idx.begin() + n, idx.end(),
+        [&counts](unsigned i, unsigned j) { return counts[i] > counts[j]; });
+    frequent.assign(idx.begin(), idx.begin() + n);
+    sort(frequent.begin(), frequent.end());
+}
+
+void VocabularyShortlist::add_always(int word)
+{
+    if (word < 0 || (unsigned)word >= vocab_size)
+        throw std::invalid_argument("VocabularyShortlist::add_always: word out of range");
+    always.push_back(word);
+}
+
+void VocabularyShortlist::count_cooccurrence(const vector<int>& source, const vector<int>& target)
+{
+    vector<int> src(source);
+    sort(src.begin(), src.end());
+    src.erase(unique(src.begin(), src.end()), src.end());
+    for (auto s : src)
+    {
+        auto& row = cooccur_count[s];
+        for (auto t : target)
+            if (t >= 0 && (unsigned)t < vocab_size)
+                row[t] += 1;
+    }
+}
+
+void VocabularyShortlist::prune_cooccurrence()
+{
+    for (auto& kv : cooccur_count)
+    {
+        vector<pair<cnn::real, int>> row;
+        for (auto& tc : kv.second)
+            row.push_back(make_pair(tc.second, tc.first));
+        unsigned n = min<unsigned>(max_cooccurring, row.size());
+        partial_sort(row.begin(), row.begin() + n, row.end(), greater<pair<cnn::real, int>>());
+        auto& words = cooccur[kv.first];
+        for (unsigned k = 0; k < n; k++)
+            words.push_back(row[k].second);
+        sort(words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
+    }
+    cooccur_count.clear();
+}
+
+vector<unsigned> VocabularyShortlist::candidates(const vector<int>& source) const
+{
+    vector<unsigned> words(always);
+    words.insert(words.end(), frequent.begin(), frequent.end());
+    for (auto s : source)
+    {
+        if (s >= 0 && (unsigned)s < vocab_size)
+            words.push_back(s);
+        auto it = cooccur.find(s);
+        if (it != cooccur.end())
+            words.insert(words.end(), it->second.begin(), it->second.end());
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+} // namespace cnn
@@ -0,0 +1,70 @@
+#ifndef CNN_VOCAB_SHORTLIST_H_
+#define CNN_VOCAB_SHORTLIST_H_
+
+#include <vector>
+#include <unordered_map>
+#include "cnn/macros.h"
+#include <boost/version.hpp>
+#if BOOST_VERSION >= 105600
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/unordered_map.hpp>
+#endif
+
+namespace cnn {
+
+/**
+the candidate target words of a decoder given its source, so that the output
+layer only needs to score those rows of the projection:
+
+    VocabularyShortlist sl(vocab_size, 2000);
+    sl.set_frequent_words(unigram_counts);
+    for (each training pair) sl.count_cooccurrence(source, target);
+    sl.prune_cooccurrence();
+    vector<unsigned> words = sl.candidates(source);   // sorted word ids
+
+the candidates are the words that are always kept (e.g. eos and unk), the
+top_n most frequent words, the source words themselves and, for every source
+word, the max_cooccurring target words seen most often with it.
+*/
+class VocabularyShortlist {
+public:
+    VocabularyShortlist() : vocab_size(0), top_n(0), max_cooccurring(0) {}
+    VocabularyShortlist(unsigned vocab_size, unsigned top_n, unsigned max_cooccurring = 20);
+
+    /// keeps the top_n words with the highest counts, counts has one entry per word
+    void set_frequent_words(const std::vector<cnn::real>& counts);
+    void add_always(int word);
+
+    /// counts every target word once for every distinct source word of the pair
+    void count_cooccurrence(const std::vector<int>& source, const std::vector<int>& target);
+    /// keeps, for every source word, only its max_cooccurring most frequent targets
+    void prune_cooccurrence();
+
+    /// sorted, without duplicates
+    std::vector<unsigned> candidates(const std::vector<int>& source) const;
+
+    unsigned vocabulary_size() const { return vocab_size; }
+
+private:
+    unsigned vocab_size;
+    unsigned top_n;
+    unsigned max_cooccurring;
+
+    std::vector<unsigned> always;
+    std::vector<unsigned> frequent;
+    /// source word -> target word -> count; only the target words after prune_cooccurrence()
+    std::unordered_map<int, std::unordered_map<int, cnn::real>> cooccur_count;
+    std::unordered_map<int, std::vector<unsigned>> cooccur;
+
+#if BOOST_VERSION >= 105600
+    friend class boost::serialization::access;
+    template<class Archive> void serialize(Archive& ar, const unsigned int) {
+        ar & vocab_size & top_n & max_cooccurring;
+        ar & always & frequent & cooccur;
+    }
+#endif
+};
+
+} // namespace cnn
+
+#endif
@@ -15,7 +15,7 @@
 #include "cnn/data-util.h"
 #include "cnn/dnn.h"
 #include "cnn/math.h"
-//#include "cnn/decode.h"
+#include "cnn/decode.h"
 //#include "rl.h"
 #include "ext/dialogue/dialogue.h"
 #include "cnn/approximator.h"
@@ -37,27 +37,6 @@ namespace cnn {
 #define MEM_SIZE 10
 #define REASONING_STEPS 7
 
-    struct Hypothesis {
-        Hypothesis(RNNPointer state, int tgt, cnn::real cst, int _t)
-        : builder_state(state), target({ tgt }), cost(cst), t(_t) {}
-        Hypothesis(RNNPointer state, int tgt, cnn::real cst, Hypothesis &last)
-            : builder_state(state), target(last.target), cost(cst), t(last.t + 1) {
-            target.push_back(tgt);
-        }
-        RNNPointer builder_state;
-        std::vector<int> target;
-        cnn::real cost;
-        int t;
-    };
-
-    struct CompareHypothesis
-    {
-        bool operator()(const Hypothesis& h1, const Hypothesis& h2)
-        {
-            if (h1.cost < h2.cost) return true;
-            return false;
-        }
-    };
 /**
 use simple models 
 encoder:
@@ -1243,17 +1222,17 @@ public:
             }
             Expression i_y_t = decoder_step(vobs, cg);
             Expression i_r_t = i_R * i_y_t;
-            Expression i_ydist = log_softmax(i_r_t);
-
-            Expression x_r_t = reshape(i_ydist, { vocab_size * nutt });
+            vector<unsigned> vtarget;
+            for (const auto& p : target_response)
+                vtarget.push_back((t < p.size() - 1) ? p[t + 1] : PickNegLogSoftmax::NO_INDEX);
+            Expression i_errs_t = pickneglogsoftmax(i_r_t, vtarget);
 
             for (int i = 0; i < nutt; i++)
             {
-                long offset = i * vocab_size; 
                 if (t < target_response[i].size() - 1)
                 {
                     /// only compute errors on with output labels
-                    this_errs[i].push_back(-pick(x_r_t, target_response[i][t + 1] + offset));
+                    this_errs[i].push_back(pick(i_errs_t, i));
                     tgt_words++;
                 }
             }
@@ -1302,17 +1281,17 @@ public:
             }
             Expression i_y_t = decoder_step(vobs, cg);
             Expression i_r_t = i_R * i_y_t;
-            Expression i_ydist = log_softmax(i_r_t);
-
-            Expression x_r_t = reshape(i_ydist, { vocab_size * nutt });
+            vector<unsigned> vtarget;
+            for (const auto& p : target_response)
+                vtarget.push_back((t < p.size() - 1) ? p[t + 1] : PickNegLogSoftmax::NO_INDEX);
+            Expression i_errs_t = pickneglogsoftmax(i_r_t, vtarget);
 
             for (int i = 0; i < nutt; i++)
             {
-                int offset = i * vocab_size; 
                 if (t < target_response[i].size() - 1)
                 {
                     /// only compute errors on with output labels
-                    this_errs[i].push_back(-pick(x_r_t, target_response[i][t + 1] + offset));
+                    this_errs[i].push_back(pick(i_errs_t, i));
                     tgt_words++;
                 }
             }
@@ -1508,6 +1487,7 @@ class AttMultiSource_LinearEncoder_WithMaxEntropyFeature : public AttMultiSource
 
     using MultiSource_LinearEncoder<Builder, Decoder>::completed;
     using MultiSource_LinearEncoder<Builder, Decoder>::get_beam_decode_complete_list;
+    using DialogueBuilder<Builder, Decoder>::shortlist;
 
 protected:
     cnn::real r_softmax_scale; /// for attention softmax exponential scale
@@ -1516,6 +1496,12 @@ protected:
     vector<Expression> v_max_ent_obs; /// observation from max-ent feature
     Expression        i_max_ent_obs;
 
+    /// candidate words of the current decode and their rows of the output layer,
+    /// empty when the full target vocabulary is scored
+    vector<unsigned> v_shortlist;
+    Expression        i_R_shortlist;
+    Expression        i_b_shortlist;
+
     Parameters * p_emb2enc; /// embedding to encoding
     Parameters * p_emb2enc_b; /// bias 
     Expression   i_emb2enc;
@@ -1787,12 +1773,44 @@ public:
 
         attention_output_for_this_turn.push_back(i_h_attention_t);
 
+        if (v_shortlist.size() > 0)
+            return colwise_add(i_R_shortlist * i_h_attention_t, i_b_shortlist);
+
         Expression i_output = i_R * i_h_attention_t;
         Expression i_comb_max_entropy = i_output + i_max_ent_obs; 
         
         return i_comb_max_entropy + i_bias;
     }
 
+    /// gathers the output layer rows of the shortlist candidates of source, once per
+    /// decode. must follow start_new_single_instance, which sets i_max_ent_obs
+    void start_shortlist(const std::vector<int> &source, int eos_sym)
+    {
+        v_shortlist.clear();
+        if (shortlist == nullptr)
+            return;
+        v_shortlist = shortlist->candidates(source);
+        auto it = lower_bound(v_shortlist.begin(), v_shortlist.end(), (unsigned)eos_sym);
+        if (it == v_shortlist.end() || *it != (unsigned)eos_sym)
+            v_shortlist.insert(it, eos_sym);
+        i_R_shortlist = select_rows(i_R, v_shortlist);
+        i_b_shortlist = select_rows(reshape(i_max_ent_obs + i_bias, { vocab_size_tgt }), v_shortlist);
+    }
+
+    /// the target word of row w of the scores
+    int shortlist_word(unsigned w) const
+    {
+        return v_shortlist.size() > 0 ? (int)v_shortlist[w] : (int)w;
+    }
+
+    /// the row of the scores that holds word w
+    unsigned shortlist_row(int w) const
+    {
+        if (v_shortlist.size() == 0)
+            return w;
+        return lower_bound(v_shortlist.begin(), v_shortlist.end(), (unsigned)w) - v_shortlist.begin();
+    }
+
     vector<Expression> build_graph(const std::vector<std::vector<int>> &current_user_input,
         const std::vector<std::vector<int>>& target_response,
         ComputationGraph &cg)
@@ -1824,17 +1842,17 @@ public:
             }
             Expression i_y_t = decoder_step(vobs, cg);
 
-            Expression i_ydist = log_softmax(i_y_t);
-
-            Expression x_r_t = reshape(i_ydist, { vocab_size * nutt });
+            vector<unsigned> vtarget;
+            for (const auto& p : target_response)
+                vtarget.push_back((t < p.size() - 1) ? p[t + 1] : PickNegLogSoftmax::NO_INDEX);
+            Expression i_errs_t = pickneglogsoftmax(i_y_t, vtarget);
 
             for (int i = 0; i < nutt; i++)
             {
-                long offset = i * vocab_size;
                 if (t < target_response[i].size() - 1)
                 {
                     /// only compute errors on with output labels
-                    this_errs[i].push_back(-pick(x_r_t, target_response[i][t + 1] + offset));
+                    this_errs[i].push_back(pick(i_errs_t, i));
                     tgt_words++;
                 }
             }
@@ -1882,17 +1900,17 @@ public:
                     vobs.push_back(-1);
             }
             Expression i_y_t = decoder_step(vobs, cg);
-            Expression i_ydist = log_softmax(i_y_t);
-
-            Expression x_r_t = reshape(i_ydist, { vocab_size * nutt });
+            vector<unsigned> vtarget;
+            for (const auto& p : target_response)
+                vtarget.push_back((t < p.size() - 1) ? p[t + 1] : PickNegLogSoftmax::NO_INDEX);
+            Expression i_errs_t = pickneglogsoftmax(i_y_t, vtarget);
 
             for (int i = 0; i < nutt; i++)
             {
-                int offset = i * vocab_size;
                 if (t < target_response[i].size() - 1)
                 {
                     /// only compute errors on with output labels
-                    this_errs[i].push_back(-pick(x_r_t, target_response[i][t + 1] + offset));
+                    this_errs[i].push_back(pick(i_errs_t, i));
                     tgt_words++;
                 }
             }
@@ -1978,6 +1996,7 @@ public:
         Sentence prv_response;
 
         start_new_single_instance(prv_response, source, cg);
+        start_shortlist(source, eos_sym);
 
         Expression i_bias = parameter(cg, p_bias);
         Expression i_R = parameter(cg, p_R);
@@ -2002,14 +2021,15 @@ public:
 
             // break potential infinite loop
             if (t > 100) {
-                w = eos_sym;
+                w = shortlist_row(eos_sym);
                 pr_w = dist[w];
             }
 
             //        std::cerr << " " << tdict.Convert(w) << " [p=" << pr_w << "]";
             t += 1;
-            target.push_back(w);
+            target.push_back(shortlist_word(w));
         }
+        v_shortlist.clear();
 
         save_context(cg);
         serialise_context(cg);
@@ -2033,6 +2053,7 @@ public:
         int t = 0;
 
         start_new_single_instance(prv_response, source, cg);
+        start_shortlist(source, eos_sym);
 
         Expression i_bias = parameter(cg, p_bias);
         Expression i_R = parameter(cg, p_R);
@@ -2057,14 +2078,15 @@ public:
 
             // break potential infinite loop
             if (t > 100) {
-                w = eos_sym;
+                w = shortlist_row(eos_sym);
                 pr_w = dist[w];
             }
 
             //        std::cerr << " " << tdict.Convert(w) << " [p=" << pr_w << "]";
             t += 1;
-            target.push_back(w);
+            target.push_back(shortlist_word(w));
         }
+        v_shortlist.clear();
 
         save_context(cg);
         serialise_context(cg);
@@ -2080,107 +2102,8 @@ public:
     
     virtual std::vector<int> beam_decode(const std::vector<int> &source, ComputationGraph& cg, int beam_width, cnn::Dict &tdict)
     {
-
-        //assert(!giza_extensions);
-        const int sos_sym = tdict.Convert("<s>");
-        const int eos_sym = tdict.Convert("</s>");
-
-        size_t tgt_len = 40;//50 * source.size();
         Sentence prv_response;
-
-        start_new_single_instance(prv_response, source, cg);
-
-        completed = priority_queue<Hypothesis, vector<Hypothesis>, CompareHypothesis>();  /// reset the queue
-        priority_queue<Hypothesis, vector<Hypothesis>, CompareHypothesis> chart;
-        chart.push(Hypothesis(decoder.state(), sos_sym, 0.0f, 0));
-
-        boost::integer_range<int> vocab = boost::irange<int>(0, vocab_size_tgt);
-        vector<int> vec_vocab(vocab_size_tgt, 0);
-        for (auto k : vocab)
-        {
-            vec_vocab[k] = k;
-        }
-        vector<int> org_vec_vocab = vec_vocab;
-
-        size_t it = 0;
-        while (it < tgt_len) {
-            priority_queue<Hypothesis, vector<Hypothesis>, CompareHypothesis> new_chart;
-            vec_vocab = org_vec_vocab;
-            real best_score = -numeric_limits<real>::infinity() + 100.;
-
-            while (!chart.empty()) {
-                Hypothesis hprev = chart.top();
-                //Expression i_scores = add_input(hprev.target.back(), hprev.t, cg, &hprev.builder_state);
-                Expression i_scores = decoder_single_instance_step(hprev.target.back(), cg, &hprev.builder_state);
-                Expression ydist = log_softmax(i_scores); // compiler warning, but see below
-
-                // find the top k best next words
-                //auto dist = as_vector(cg.incremental_forward()); // evaluates last expression, i.e., ydist
-                auto dist = get_value(ydist, cg); // evaluates last expression, i.e., ydist
-                real mscore = *max_element(dist.begin(), dist.end()) + hprev.cost;
-                if (mscore < best_score - beam_width)
-                {
-                    chart.pop();
-                    continue;
-                }
-
-                best_score = max(mscore, best_score);
-
-                for (auto vi : vec_vocab)
-                {
-                    real score = hprev.cost + dist[vi];
-                    if (score >= best_score - beam_width)
-                    {
-                        if (vi == eos_sym)
-                        {
-                            Hypothesis hnew(decoder.state(), vi, score / (it + 1), hprev);
-                            completed.push(hnew);
-                        }
-                        else
-                        {
-                            Hypothesis hnew(decoder.state(), vi, score, hprev);
-                            new_chart.push(hnew);
-                        }
-                    }
-                }
-
-                chart.pop();
-            }
-
-            if (new_chart.size() == 0)
-                break;
-
-            while (!new_chart.empty() && chart.size() <= max_number_of_hypothesis)
-            {
-                if (new_chart.top().cost > best_score - beam_width)
-                {
-                    chart.push(new_chart.top());
-                    new_chart.pop();
-                }
-                else
-                    break;
-            }
-            it++;
-        }
-
-        vector<int> best;
-        if (completed.size() == 0)
-        {
-            cerr << "beam search decoding beam width too small, use the best path so far" << flush;
-
-            best = chart.top().target;
-            best.push_back(eos_sym);
-        }
-        else
-        {
-            best = completed.top().target;
-        }
-
-        save_context(cg);
-        serialise_context(cg);
-
-        turnid++;
-        return best;
+        return batched_beam_decode(prv_response, source, cg, beam_width, 40, tdict);
     }
 
     std::vector<int> beam_decode_with_additional_feature(const std::vector<int> &prv_response, const std::vector<int> &source, const vector<cnn::real>&, ComputationGraph& cg, int beam_width, cnn::Dict &tdict)
@@ -2190,123 +2113,106 @@ public:
     
     virtual std::vector<int> beam_decode(const std::vector<int> &prv_response, const std::vector<int> &source, ComputationGraph& cg, int beam_width, cnn::Dict &tdict)
     {
-        //assert(!giza_extensions);
+        return batched_beam_decode(prv_response, source, cg, beam_width, 30, tdict);
+    }
+
+protected:
+    /**
+    beam search that advances all live hypotheses in one decoder step, one
+    column per hypothesis, all attending to the same source. after each
+    step the decoder state and the attention output are reordered by the
+    back-pointers of the surviving hypotheses.
+    as in the unbatched beam_decode, beam_width is a margin on the log
+    probability: extensions more than beam_width below the best one of a
+    step are pruned, and max_number_of_hypothesis caps the live hypotheses
+    */
+    std::vector<int> batched_beam_decode(const std::vector<int> &prv_response, const std::vector<int> &source, ComputationGraph& cg, int beam_width, unsigned max_len, cnn::Dict &tdict)
+    {
         const int sos_sym = tdict.Convert("<s>");
         const int eos_sym = tdict.Convert("</s>");
 
-        size_t tgt_len = 30;//50 * source.size();
-
         start_new_single_instance(prv_response, source, cg);
+        start_shortlist(source, eos_sym);
 
-        completed = priority_queue<Hypothesis, vector<Hypothesis>, CompareHypothesis>();  /// reset the queue
-        priority_queue<Hypothesis, vector<Hypothesis>, CompareHypothesis> chart;
-        chart.push(Hypothesis(decoder.state(), sos_sym, 0.0f, 0));
+        v_decoder_context.clear();
 
-        boost::integer_range<int> vocab = boost::irange<int>(0, vocab_size_tgt);
-        vector<int> vec_vocab(vocab_size_tgt, 0);
-        for (auto k : vocab)
-        {
-            vec_vocab[k] = k;
-        }
-        vector<int> org_vec_vocab = vec_vocab;
+        Expression i_enc_b = parameter(cg, p_emb2enc_b);
+        Expression i_out_R = (v_shortlist.size() > 0) ? i_R_shortlist : i_R;
+        Expression i_out_b = (v_shortlist.size() > 0) ? i_b_shortlist : reshape(i_max_ent_obs + i_bias, { vocab_size_tgt });
 
-        size_t it = 0;
-        while (it < tgt_len) {
-            priority_queue<Hypothesis, vector<Hypothesis>, CompareHypothesis> new_chart;
-            vec_vocab = org_vec_vocab;
-            real best_score = -numeric_limits<real>::infinity() + 100.;
+        /// the source replicated for each beam size
+        vector<Expression> v_src_rep;
+        const unsigned max_hyps = max<int>(max_number_of_hypothesis, 1);
+        vector<Expression> src_rep(max_hyps + 1);
 
-            while (!chart.empty()) {
-                Hypothesis hprev = chart.top();
-                //Expression i_scores = add_input(hprev.target.back(), hprev.t, cg, &hprev.builder_state);
-                Expression i_scores = decoder_single_instance_step(hprev.target.back(), cg, &hprev.builder_state);
-                Expression ydist = log_softmax(i_scores); // compiler warning, but see below
+        Expression i_att_prev = (attention_output_for_this_turn.size() == 0) ? i_zero : attention_output_for_this_turn.back();
+        vector<vector<Expression>> v_state; /// decoder state of each step
+        vector<Expression> v_att;           /// attention output of each step
 
-                // find the top k best next words
-                //auto dist = as_vector(cg.incremental_forward()); // evaluates last expression, i.e., ydist
-                auto dist = get_value(ydist, cg); // evaluates last expression, i.e., ydist
-                real mscore = *max_element(dist.begin(), dist.end()) + hprev.cost;
-                if (mscore < best_score - beam_width)
-                {
-                    chart.pop();
-                    continue;
-                }
+        BatchedBeamSearch beam(max_hyps, sos_sym, eos_sym, max_len, true, (cnn::real)beam_width);
+        while (!beam.done())
+        {
+            unsigned nbeam = beam.size();
+            vector<unsigned> words(beam.words().begin(), beam.words().end());
 
-                best_score = max(mscore, best_score);
+            Expression i_obs = colwise_add(i_emb2enc * lookup_cols(cg, p_cs, words), i_enc_b);
+            Expression i_h_t = decoder.add_input(concatenate({ i_obs, i_att_prev }));
 
-                for (auto vi : vec_vocab)
-                {
-                    real score = hprev.cost + dist[vi];
-                    if (score >= best_score - beam_width)
-                    {
-                        if (vi == eos_sym)
-                        {
-                            Hypothesis hnew(decoder.state(), vi, score / (it + 1), hprev);
-                            completed.push(hnew);
-                        }
-                        else
-                        {
-                            Hypothesis hnew(decoder.state(), vi, score, hprev);
-                            new_chart.push(hnew);
-                        }
-                    }
-                }
+            if (src_rep[nbeam].pg == nullptr)
+                src_rep[nbeam] = concatenate_cols(vector<Expression>(nbeam, src));
+            v_src_rep.assign(nbeam, v_src[0]);
+            vector<Expression> alpha;
+            vector<Expression> v_context_to_source = attention_to_source(v_src_rep, vector<unsigned>(nbeam, src_len[0]), i_va, i_Wa, i_h_t, src_rep[nbeam], hidden_dim[ALIGN_LAYER], nbeam, alpha, r_softmax_scale);
 
-                chart.pop();
-            }
+            Expression concatenated_src = colwise_add(i_emb2enc * concatenate_cols(v_context_to_source), i_enc_b);
+            Expression i_h_attention_t = attention_layer.add_input(concatenate({ i_h_t, concatenated_src }));
+            Expression i_scores = colwise_add(i_out_R * i_h_attention_t, i_out_b);
 
-            if (new_chart.size() == 0)
+            v_state.push_back(decoder.final_s());
+            v_att.push_back(i_h_attention_t);
+
+            auto dist = get_value(log_softmax(i_scores), cg);
+            vector<unsigned> parent = (v_shortlist.size() > 0) ? beam.advance(dist, v_shortlist) : beam.advance(dist, vocab_size_tgt);
+            if (beam.done())
                 break;
 
-            while (!new_chart.empty() && chart.size() <= max_number_of_hypothesis)
-            {
-                if (new_chart.top().cost > best_score - beam_width)
-                {
-                    chart.push(new_chart.top());
-                    new_chart.pop();
-                }
-                else
-                    break;
-            }
-            it++;
+            vector<Expression> v_s;
+            for (auto p : v_state.back())
+                v_s.push_back(select_cols(p, parent));
+            decoder.set_data_in_parallel(parent.size());
+            decoder.start_new_sequence(v_s);
+            attention_layer.set_data_in_parallel(parent.size());
+            i_att_prev = select_cols(i_h_attention_t, parent);
         }
 
-        vector<int> best;
+        v_shortlist.clear();
+        completed = beam.completed_list();
         if (completed.size() == 0)
-        {
             cerr << "beam search decoding beam width too small, use the best path so far" << flush;
 
-            best = chart.top().target;
-            best.push_back(eos_sym);
-        }
-        else
+        /// leave the decoder in the state that produced the last word of the best hypothesis
+        const HypothesisTree::Node& last = beam.tree().nodes[beam.best_node()];
+        if (last.step >= 0)
         {
-            best = completed.top().target;
+            vector<unsigned> col(1, last.column);
+            vector<Expression> v_s;
+            for (auto p : v_state[last.step])
+                v_s.push_back(select_cols(p, col));
+            decoder.set_data_in_parallel(1);
+            decoder.start_new_sequence(v_s);
+            attention_layer.set_data_in_parallel(1);
+            attention_output_for_this_turn.push_back(select_cols(v_att[last.step], col));
+            v_decoder_context.push_back(v_s);
         }
 
-
         save_context(cg);
         serialise_context(cg);
 
-        /// n-best
-        /*
-        int kbest = 0;
-        while (completed.size() != 0)
-        {
-            auto pbest = completed.top().target;
-            cout << "top" << kbest++ << " best : ";
-            for (auto a : pbest)
-                cout << sd.Convert(a) << " ";
-            cout << endl;
-            completed.pop();
-            if (kbest > 3)
-                break;
-        }*/
-
         turnid++;
-        return best;
+        return beam.best();
     }
 
+public:
     /// return [nutt][decoded_results]
     std::vector<Sentence> batch_decode(const std::vector<Sentence>& prv_response, 
         const std::vector<Sentence> &source, ComputationGraph& cg, cnn::Dict  &tdict)
@@ -2643,17 +2549,17 @@ public:
             }
             Expression i_y_t = decoder_step(vobs, cg);
 
-            Expression i_ydist = log_softmax(i_y_t);
-
-            Expression x_r_t = reshape(i_ydist, { vocab_size * nutt });
+            vector<unsigned> vtarget;
+            for (const auto& p : target_response)
+                vtarget.push_back((t < p.size() - 1) ? p[t + 1] : PickNegLogSoftmax::NO_INDEX);
+            Expression i_errs_t = pickneglogsoftmax(i_y_t, vtarget);
 
             for (int i = 0; i < nutt; i++)
             {
-                long offset = i * vocab_size;
                 if (t < target_response[i].size() - 1)
                 {
                     /// only compute errors on with output labels
-                    this_errs[i].push_back(-pick(x_r_t, target_response[i][t + 1] + offset));
+                    this_errs[i].push_back(pick(i_errs_t, i));
                     tgt_words++;
                 }
             }
@@ -2701,17 +2607,17 @@ public:
                     vobs.push_back(-1);
             }
             Expression i_y_t = decoder_step(vobs, cg);
-            Expression i_ydist = log_softmax(i_y_t);
-
-            Expression x_r_t = reshape(i_ydist, { vocab_size * nutt });
+            vector<unsigned> vtarget;
+            for (const auto& p : target_response)
+                vtarget.push_back((t < p.size() - 1) ? p[t + 1] : PickNegLogSoftmax::NO_INDEX);
+            Expression i_errs_t = pickneglogsoftmax(i_y_t, vtarget);
 
             for (int i = 0; i < nutt; i++)
             {
-                int offset = i * vocab_size;
                 if (t < target_response[i].size() - 1)
                 {
                     /// only compute errors on with output labels
-                    this_errs[i].push_back(-pick(x_r_t, target_response[i][t + 1] + offset));
+                    this_errs[i].push_back(pick(i_errs_t, i));
                     tgt_words++;
                 }
             }
@@ -3064,17 +2970,17 @@ public:
             }
             Expression i_y_t = decoder_step(vobs, cg);
 
-            Expression i_ydist = log_softmax(i_y_t);
-
-            Expression x_r_t = reshape(i_ydist, { vocab_size * nutt });
+            vector<unsigned> vtarget;
+            for (const auto& p : target_response)
+                vtarget.push_back((t < p.size() - 1) ? p[t + 1] : PickNegLogSoftmax::NO_INDEX);
+            Expression i_errs_t = pickneglogsoftmax(i_y_t, vtarget);
 
             for (int i = 0; i < nutt; i++)
             {
-                long offset = i * vocab_size;
                 if (t < target_response[i].size() - 1)
                 {
                     /// only compute errors on with output labels
-                    this_errs[i].push_back(-pick(x_r_t, target_response[i][t + 1] + offset));
+                    this_errs[i].push_back(pick(i_errs_t, i));
                     tgt_words++;
                 }
             }
@@ -3122,17 +3028,17 @@ public:
                     vobs.push_back(-1);
             }
             Expression i_y_t = decoder_step(vobs, cg);
-            Expression i_ydist = log_softmax(i_y_t);
-
-            Expression x_r_t = reshape(i_ydist, { vocab_size * nutt });
+            vector<unsigned> vtarget;
+            for (const auto& p : target_response)
+                vtarget.push_back((t < p.size() - 1) ? p[t + 1] : PickNegLogSoftmax::NO_INDEX);
+            Expression i_errs_t = pickneglogsoftmax(i_y_t, vtarget);
 
             for (int i = 0; i < nutt; i++)
             {
-                int offset = i * vocab_size;
                 if (t < target_response[i].size() - 1)
                 {
                     /// only compute errors on with output labels
-                    this_errs[i].push_back(-pick(x_r_t, target_response[i][t + 1] + offset));
+                    this_errs[i].push_back(pick(i_errs_t, i));
                     tgt_words++;
                 }
             }
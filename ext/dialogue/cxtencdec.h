@@ -421,16 +421,17 @@ public:
             }
             Expression i_y_t = decoder_step(vobs, cg);
             Expression i_r_t = i_R * i_y_t;
-            Expression i_ydist = log_softmax(i_r_t);
-            Expression x_r_t = reshape(i_ydist, { vocab_size * nutt });
+            vector<unsigned> vtarget;
+            for (const auto& p : osent)
+                vtarget.push_back((t < p.size() - 1) ? p[t + 1] : PickNegLogSoftmax::NO_INDEX);
+            Expression i_errs_t = pickneglogsoftmax(i_r_t, vtarget);
 
             for (size_t i = 0; i < nutt; i++)
             {
-                int offset = i * vocab_size; 
                 if (t < osent[i].size() - 1)
                 {
                     /// only compute errors on with output labels
-                    this_errs[i].push_back( -pick(x_r_t, osent[i][t + 1] + offset));
+                    this_errs[i].push_back(pick(i_errs_t, i));
                     tgt_words++;
                 }
             }
@@ -2,6 +2,7 @@
 #define DIALOGUE_
 
 #include "cnn/cnn.h"
+#include "cnn/nodes.h"
 #include "cnn/rnn-state-machine.h"
 #include "cnn/expr.h"
 #include "cnn/lstm.h"
@@ -10,6 +11,7 @@
 #include <algorithm>
 #include <stack>
 #include "cnn/data-util.h"
+#include "cnn/vocab-shortlist.h"
 
 #define UNDERSTAND_AWI
 #define UNDERSTAND_AWI_ADD_ATTENTION
@@ -81,6 +83,9 @@ protected:
     unsigned int nutt; // for multiple training utterance per inibatch
     vector<cnn::real> zero;
 
+    /// if set, decoding only scores the candidate words of each source
+    VocabularyShortlist* shortlist;
+
 protected:
     cnn::real * m_pined_memory; /// memory for serialization either on device or on host
 
@@ -91,7 +96,7 @@ public:
     size_t tgt_words;
 
 public:
-    DialogueBuilder() {};
+    DialogueBuilder() : shortlist(nullptr) {};
     DialogueBuilder(cnn::Model& model, unsigned int vocab_size_src, unsigned int vocab_size_tgt, const vector<unsigned int>& layers, const vector<unsigned int>& hidden_dims, int hidden_replicates, int decoder_use_additional_input = 0, int mem_slots = 0, cnn::real iscale = 1.0) :
         layers(layers),
         decoder(layers[DECODER_LAYER], vector<unsigned>{hidden_dims[DECODER_LAYER] + decoder_use_additional_input * hidden_dims[ENCODER_LAYER], hidden_dims[DECODER_LAYER], hidden_dims[DECODER_LAYER] }, &model, iscale),
@@ -100,7 +105,7 @@ public:
         decoder_use_additional_input(decoder_use_additional_input),
         context(layers[INTENTION_LAYER], vector<unsigned>{layers[ENCODER_LAYER] * hidden_replicates * hidden_dims[ENCODER_LAYER], hidden_dims[INTENTION_LAYER], hidden_dims[INTENTION_LAYER]}, &model, iscale),
         vocab_size(vocab_size_src), vocab_size_tgt(vocab_size_tgt),
-        rep_hidden(hidden_replicates)
+        rep_hidden(hidden_replicates), shortlist(nullptr)
     {
         hidden_dim = hidden_dims;
 
@@ -135,6 +140,14 @@ public:
         cnn_mm_free(m_pined_memory);
     };
 
+    /// the shortlist is not owned, nullptr scores the full target vocabulary
+    void set_decoding_shortlist(VocabularyShortlist* sl)
+    {
+        if (sl != nullptr && sl->vocabulary_size() != vocab_size_tgt)
+            throw std::invalid_argument("decoding shortlist does not match the target vocabulary");
+        shortlist = sl;
+    }
+
     int pin_memory_size()
     {
         /// 4 layers, 500 dimension and 20 sentences
@@ -676,16 +689,17 @@ public:
              }
              Expression i_y_t = decoder_step(vobs, cg);
              Expression i_r_t = i_bias_mb + i_R * i_y_t;
-             Expression i_ydist = log_softmax(i_r_t);
-             Expression r_r_t = reshape(i_ydist, {vocab_size * nutt});
+             vector<unsigned> vtarget;
+             for (const auto& p : osent)
+                 vtarget.push_back((t < p.size() - 1) ? p[t + 1] : PickNegLogSoftmax::NO_INDEX);
+             Expression i_errs_t = pickneglogsoftmax(i_r_t, vtarget);
 
              for (size_t i = 0; i < nutt; i++)
              {
-                 int offset = i * vocab_size;
                  if (t < osent[i].size() - 1)
                  {
                      /// only compute errors on with output labels
-                     this_errs[i].push_back( - pick(r_r_t, offset + osent[i][t + 1]));
+                     this_errs[i].push_back(pick(i_errs_t, i));
                  }
                  else if (t == osent[i].size() - 1)
                  {
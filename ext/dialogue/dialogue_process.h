@@ -84,6 +84,11 @@ namespace cnn {
             twords = 0;
             nbr_turns = 0;
         }
+
+        void set_decoding_shortlist(VocabularyShortlist* sl)
+        {
+            s2tmodel.set_decoding_shortlist(sl);
+        }
     
         // return Expression of total loss
         // only has one pair of sentence so far
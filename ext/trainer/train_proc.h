@@ -18,6 +18,7 @@
 #include "ext/ngram/ngram.h"
 #include "cnn/data-util.h"
 #include "cnn/grad-check.h"
+#include "cnn/shape-cache.h"
 #include "cnn/metric-util.h"
 #include "ext/trainer/eval_proc.h"
 
@@ -145,11 +146,20 @@ private:
 
     TFIDFMetric * ptr_tfidfScore;;
 
+    /// shapes of the graphs built in forward_backward calls. minibatches of 
+    /// dialogues with the same sentence lengths build the same graph, so
+    /// its node dimensions are replayed instead of recomputed
+    GraphShapeCache graph_shapes;
+
+public:
+    bool use_shape_cache; /// key graphs by sentence lengths, see GraphShapeCache; off by default
+
 public:
     TrainProcess() {
         training_set_scores = new TrainingScores(MAX_NBR_TRUNS);
         dev_set_scores = new TrainingScores(MAX_NBR_TRUNS);
         ptr_tfidfScore = nullptr;
+        use_shape_cache = false;
     }
     ~TrainProcess()
     {
@@ -239,6 +249,9 @@ public:
         bool update_model = true);
     void REINFORCE_segmental_forward_backward(Proc &am, Proc &am_mirrow, PDialogue &v_v_dialogues, int nutt, Trainer* sgd, Dict& sd, cnn::real reward_baseline, cnn::real threshold_prob_for_sampling, TrainingScores *scores, bool update_model);
 
+    /// appends the number of utterances and the source and target lengths of a turn to a shape key
+    void append_turn_shape(GraphShapeCache::Key& key, const PTurn& turn);
+
 public:
     /// for reranking
     bool MERT_tune(Model &model, Proc &am, Corpus &devel, string out_file, Dict & sd);
@@ -2189,6 +2202,17 @@ void TrainProcess<AM_t>::REINFORCE_segmental_forward_backward(AM_t &am, AM_t &am
 
 }
 
+template <class AM_t>
+void TrainProcess<AM_t>::append_turn_shape(GraphShapeCache::Key& key, const PTurn& turn)
+{
+    key.push_back((unsigned)turn.size());
+    for (auto& p : turn)
+    {
+        key.push_back((unsigned)p.first.size());
+        key.push_back((unsigned)p.second.size());
+    }
+}
+
 template <class AM_t>
 void TrainProcess<AM_t>::nosegmental_forward_backward(Model &model, AM_t &am, PDialogue &v_v_dialogues, int nutt, TrainingScores* scores, bool resetmodel, int init_turn_id, Trainer* sgd)
 {
@@ -2197,6 +2221,14 @@ void TrainProcess<AM_t>::nosegmental_forward_backward(Model &model, AM_t &am, PD
     PTurn prv_turn;
 
     ComputationGraph cg;
+    if (use_shape_cache)
+    {
+        /// the whole dialogue is one graph
+        GraphShapeCache::Key key = { 0, (unsigned)init_turn_id, resetmodel, sgd != nullptr };
+        for (auto& turn : v_v_dialogues)
+            append_turn_shape(key, turn);
+        cg.use_shape_cache(&graph_shapes, key);
+    }
     if (resetmodel)
     {
         am.reset();
@@ -2232,7 +2264,8 @@ void TrainProcess<AM_t>::nosegmental_forward_backward(Model &model, AM_t &am, PD
     if (sgd != nullptr)
     {
         cg.backward();
-        sgd->update(am.twords);
+        /// updates every sgd->accumulation_steps dialogues
+        sgd->step(am.twords);
     }
 }
 
@@ -2249,6 +2282,13 @@ void TrainProcess<AM_t>::segmental_forward_backward(Model &model, AM_t &am, PDia
     for (auto turn : v_v_dialogues)
     {
         ComputationGraph cg;
+        if (use_shape_cache)
+        {
+            GraphShapeCache::Key key = { 1, (unsigned)turn_id, resetmodel, sgd != nullptr };
+            append_turn_shape(key, prv_turn);
+            append_turn_shape(key, turn);
+            cg.use_shape_cache(&graph_shapes, key);
+        }
         if (resetmodel)
         {
             am.reset();
@@ -2283,7 +2323,7 @@ void TrainProcess<AM_t>::segmental_forward_backward(Model &model, AM_t &am, PDia
             cg.backward();
             if (verbose)
                 cout << " done backprop " << endl;
-            sgd->update(am.twords);
+            sgd->step(am.twords);
             if (verbose)
                 cout << " done update" << endl;
         }
@@ -2311,6 +2351,13 @@ void TrainProcess<AM_t>::segmental_forward_backward_with_additional_feature(Mode
     for (auto turn : v_v_dialogues)
     {
         ComputationGraph cg;
+        if (use_shape_cache)
+        {
+            GraphShapeCache::Key key = { 2, (unsigned)turn_id, resetmodel, sgd != nullptr };
+            append_turn_shape(key, prv_turn);
+            append_turn_shape(key, turn);
+            cg.use_shape_cache(&graph_shapes, key);
+        }
         if (resetmodel)
         {
             am.reset();
@@ -2363,7 +2410,7 @@ void TrainProcess<AM_t>::segmental_forward_backward_with_additional_feature(Mode
             cg.backward();
             if (verbose)
                 cout << " done backprop " << endl;
-            sgd->update(am.twords);
+            sgd->step(am.twords);
             if (verbose)
                 cout << " done update" << endl;
         }
@@ -3693,7 +3740,7 @@ overly pre-train models on small subset of the data
 template <class AM_t>
 void TrainProcess<AM_t>::supervised_pretrain(Model &model, AM_t &am, Corpus &training, Corpus &devel,
     Trainer &sgd, string out_file, cnn::real target_ppl, int min_diag_id,
-    bool bcharlevel = false, bool nosplitdialogue = false)
+    bool bcharlevel, bool nosplitdialogue)
 {
     cnn::real best = std::numeric_limits<cnn::real>::max();
     unsigned report_every_i = 50;
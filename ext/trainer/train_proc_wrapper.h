@@ -47,6 +47,15 @@ vector<unsigned> set_dims(variables_map vm)
     return dims;
 }
 
+/// declares --accumulate, which select_trainer reads into Trainer::accumulation_steps.
+/// add it to the options_description of the main program
+inline void add_trainer_options(options_description& opts)
+{
+    opts.add_options()
+        ("accumulate", value<int>()->default_value(1), "apply the gradients of <num> minibatches with one update, see Trainer::step")
+        ;
+}
+
 template<class rnn_t, class TrainProc>
 Trainer* select_trainer(variables_map vm, Model* model)
 {
@@ -74,6 +83,16 @@ Trainer* select_trainer(variables_map vm, Model* model)
     sgd->eta_decay = vm["eta_decay"].as<cnn::real>();
 
     sgd->clipping_type = (t_gradient_clipping)vm["clippingtype"].as<int>();
+    if (vm.count("accumulate") > 0)
+    {
+        int accumulate = vm["accumulate"].as<int>();
+        if (accumulate < 1)
+        {
+            cerr << "--accumulate must be at least 1, got " << accumulate << endl;
+            throw std::invalid_argument("--accumulate must be at least 1");
+        }
+        sgd->accumulation_steps = accumulate;
+    }
 
     return sgd;
 }